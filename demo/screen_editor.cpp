@@ -3,9 +3,8 @@
 
 #include <ftxui/component/event.hpp>
 
-#include "markdown/editor.hpp"
+#include "markdown/live_preview.hpp"
 #include "markdown/parser.hpp"
-#include "markdown/viewer.hpp"
 
 namespace {
 
@@ -45,12 +44,13 @@ ftxui::Component make_editor_screen(
     int& current_screen, int& theme_index,
     std::vector<std::string>& theme_names) {
 
-    auto editor = std::make_shared<markdown::Editor>();
+    auto preview = std::make_shared<markdown::LivePreview>(
+        markdown::make_cmark_parser());
+    auto* editor = &preview->editor();
+    auto* viewer = &preview->viewer();
     editor->set_content(editor_content);
     auto editor_comp = editor->component();
-
-    auto viewer = std::make_shared<markdown::Viewer>(
-        markdown::make_cmark_parser());
+    viewer->set_incremental(true);
 
     auto link_url = std::make_shared<std::string>();
     viewer->on_link_click(
@@ -65,22 +65,10 @@ ftxui::Component make_editor_screen(
         theme_toggle, editor_comp, viewer_comp});
 
     auto screen = ftxui::Renderer(container, [=, &theme_index] {
-        auto const& theme = demo::get_theme(theme_index);
-        editor->set_theme(theme);
-        viewer->set_theme(theme);
-        viewer->set_content(editor->content());
+        preview->set_theme(demo::get_theme(theme_index));
+        preview->sync();
         viewer->show_scrollbar(true);
 
-        if (!viewer->active()) {
-            float scroll_ratio = 0.0f;
-            if (editor->total_lines() > 1) {
-                scroll_ratio =
-                    static_cast<float>(editor->cursor_line() - 1) /
-                    static_cast<float>(editor->total_lines() - 1);
-            }
-            viewer->set_scroll(scroll_ratio);
-        }
-
         auto active_border = ftxui::borderStyled(
             ftxui::BorderStyle::DOUBLE, ftxui::Color::White);
         auto focused_border = ftxui::borderStyled(ftxui::Color::White);
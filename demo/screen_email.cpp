@@ -61,7 +61,7 @@ ftxui::Component make_email_screen(
     std::vector<std::string>& theme_names) {
 
     auto viewer = std::make_shared<markdown::Viewer>(
-        markdown::make_cmark_parser());
+        markdown::make_fast_parser());
     viewer->set_content(email_body);
     viewer->set_embed(true);
 
@@ -70,7 +70,7 @@ ftxui::Component make_newsletter_screen(
 #endif
 
     auto viewer = std::make_shared<markdown::Viewer>(
-        markdown::make_cmark_parser());
+        markdown::make_fast_parser());
     viewer->set_content(snippets->read_current());
     viewer->set_embed(true);
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -27,12 +29,34 @@ enum class NodeType {
 
 struct ASTNode {
     NodeType type = NodeType::Document;
+    // Literal of Text, CodeInline and CodeBlock nodes.  The parsers emit it
+    // emoji-normalized (see normalize_emoji_width() in text_utils.hpp) and
+    // DomBuilder draws it as is; hand-built trees must normalize it too.
     std::string text;
     std::string url;
     std::string info;       // code block language (e.g. "python")
     int level = 0;
     int list_start = 1;
+    // Byte range [source_begin, source_end) in the parsed input.
+    // Filled for block-level nodes; 0/0 for inlines and hand-built trees.
+    size_t source_begin = 0;
+    size_t source_end = 0;
     std::vector<ASTNode> children;
+    // Merkle hash of the subtree (see ast_diff.hpp), set by the parsers as
+    // each node is completed.  0 means not computed, as in hand-built trees.
+    uint64_t hash = 0;
+
+    // Field-wise, hash aside.  Two computed hashes that differ settle it
+    // without walking the subtrees.
+    bool operator==(ASTNode const& other) const {
+        if (hash != 0 && other.hash != 0 && hash != other.hash) return false;
+        return type == other.type && level == other.level &&
+               list_start == other.list_start &&
+               source_begin == other.source_begin &&
+               source_end == other.source_end && text == other.text &&
+               url == other.url && info == other.info &&
+               children == other.children;
+    }
 };
 
 using MarkdownAST = ASTNode;
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "markdown/ast.hpp"
+#include "markdown/parser.hpp"
+
+namespace markdown {
+
+// Fast 64-bit hash of a document, used as the cache key.  Not
+// cryptographic; stable across runs and platforms.
+uint64_t content_hash(std::string_view text);
+
+// Versioned binary encoding of an AST: a short header, then every node in
+// preorder with its fields as LEB128 varints and its strings inline.
+// content_hash and content_size identify the text it was parsed from.
+void serialize_ast(MarkdownAST const& ast, uint64_t content_hash,
+                   uint64_t content_size, std::string& out);
+
+// Decode bytes produced by serialize_ast().  Returns false on a foreign
+// version, a different content_hash or content_size, or damaged data.
+bool deserialize_ast(std::string_view bytes, uint64_t content_hash,
+                     uint64_t content_size, MarkdownAST& out);
+
+struct AstCacheLimits {
+    uint64_t max_bytes = 64u << 20;  // total size of the entry files
+    size_t max_entries = 4096;
+};
+
+// On-disk AST cache: one file per document, named after its content hash,
+// memory-mapped on load.  Recency is kept in memory and in the files'
+// modification times, so least-recently-used eviction survives restarts.
+// Thread-safe; several parsers may share one cache.
+//
+// Several processes may share a directory.  Each indexes it when it opens
+// the cache and on rescan(); a lookup missing from the index also checks
+// for the file, so entries other processes store are found.  The limits
+// apply to the entries this process has indexed, which may lag the
+// directory until the next rescan().
+class AstCache {
+public:
+    explicit AstCache(std::filesystem::path dir, AstCacheLimits limits = {});
+
+    // Fill out from the cached AST for text.  Returns false on a miss.
+    bool load(std::string_view text, MarkdownAST& out);
+    // Record ast as the parse of text, evicting old entries over the limits.
+    // Entries larger than limits.max_bytes are not stored.
+    void store(std::string_view text, MarkdownAST const& ast);
+    // Delete every entry.
+    void clear();
+    // Index the directory again, picking up entries other processes
+    // stored or removed, and evict over the limits.
+    void rescan();
+
+    size_t entries() const;
+    uint64_t bytes() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    struct Entry {
+        uint64_t hash;
+        uint64_t size;
+    };
+    using Lru = std::list<Entry>;  // most recent first
+
+    // Rebuild the index from the directory; _mutex held or unshared.
+    void scan();
+    std::filesystem::path path_for(uint64_t hash) const;
+    void touch(Lru::iterator it);
+    void erase(Lru::iterator it);
+    void evict();
+
+    std::filesystem::path _dir;
+    AstCacheLimits _limits;
+    mutable std::mutex _mutex;
+    Lru _lru;
+    std::unordered_map<uint64_t, Lru::iterator> _index;
+    uint64_t _bytes = 0;
+    uint64_t _hits = 0;
+    uint64_t _misses = 0;
+};
+
+// Wrap parser so that parses are served from cache when the same text was
+// parsed before, and successful parses are stored for next time.
+std::unique_ptr<MarkdownParser> make_caching_parser(
+    std::unique_ptr<MarkdownParser> parser, std::shared_ptr<AstCache> cache);
+
+} // namespace markdown
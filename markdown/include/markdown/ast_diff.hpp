@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "markdown/ast.hpp"
+
+namespace markdown {
+
+// 64-bit Merkle hash of a node: its type, literals, url, info, level and
+// list start, then the hashes of its children in order.  Source ranges are
+// left out, so a block that only moved hashes the same.  Never 0.
+//
+// node_hash() reads the children's stored ASTNode::hash, so children must
+// be sealed first; parsers seal each node as they complete it.
+uint64_t node_hash(ASTNode const& node);
+inline void seal_hash(ASTNode& node) { node.hash = node_hash(node); }
+
+// Recompute the hash of every node under root, e.g. after editing a tree.
+void hash_tree(ASTNode& root);
+
+// The stored hash, or for a tree without one, the same value computed on
+// the fly.
+uint64_t subtree_hash(ASTNode const& node);
+
+// subtree_hash() of each top-level block, in order.
+std::vector<uint64_t> block_hashes(MarkdownAST const& ast);
+
+// Difference between two lists of top-level blocks.  Equal leading and
+// trailing blocks are matched; the old blocks between them were replaced
+// by the new ones between them.  Pairs in that range count as changed,
+// the surplus on either side as inserted or removed.
+struct AstDiff {
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    size_t old_count = 0;
+    size_t new_count = 0;
+    size_t prefix = 0;  // leading blocks equal in both
+    size_t suffix = 0;  // trailing blocks equal in both
+
+    // Old block equal to new block i, or npos if block i must be built.
+    size_t old_block(size_t i) const {
+        if (i < prefix) return i;
+        if (i >= new_count - suffix && i < new_count) {
+            return i - new_count + old_count;
+        }
+        return npos;
+    }
+    size_t changed() const {
+        return std::min(old_count, new_count) - prefix - suffix;
+    }
+    size_t inserted() const {
+        return new_count > old_count ? new_count - old_count : 0;
+    }
+    size_t removed() const {
+        return old_count > new_count ? old_count - new_count : 0;
+    }
+    bool empty() const {
+        return old_count == new_count && prefix == new_count;
+    }
+};
+
+AstDiff diff_blocks(std::span<uint64_t const> before,
+                    std::span<uint64_t const> after);
+
+inline AstDiff diff_blocks(MarkdownAST const& before,
+                           MarkdownAST const& after) {
+    auto a = block_hashes(before);
+    auto b = block_hashes(after);
+    return diff_blocks(a, b);
+}
+
+} // namespace markdown
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "markdown/ast.hpp"
+
+namespace markdown {
+
+struct HeadingEntry {
+    int level = 0;
+    std::string text;         // plain text, markup stripped
+    std::string slug;         // anchor, unique within the document
+    size_t block = 0;         // top-level block holding the heading
+    size_t source_begin = 0;
+};
+
+struct LinkEntry {
+    std::string url;
+    size_t block = 0;         // top-level block holding the link
+};
+
+// GitHub-style anchor for a heading: ASCII letters lowercased, spaces
+// turned into '-', other ASCII punctuation except '-' and '_' dropped.
+// Non-ASCII bytes are kept as they are.
+std::string heading_slug(std::string_view text);
+
+// Headings and links of one document in document order, with lookup
+// tables built alongside so every query is O(1).  Links are numbered as
+// DomBuilder numbers its link targets.
+class DocumentIndex {
+public:
+    void build(MarkdownAST const& ast);
+    void clear();
+
+    std::vector<HeadingEntry> const& headings() const { return _headings; }
+    std::vector<LinkEntry> const& links() const { return _links; }
+    size_t block_count() const { return _first_heading.size() - 1; }
+
+    // Heading with this slug, -1 if there is none.
+    int find_slug(std::string_view slug) const;
+    // Heading an in-document link ("#slug", percent-encoded or not)
+    // points to, -1 for any other url.
+    int resolve_fragment(std::string_view url) const;
+    // First heading in a block after block, -1 if there is none.
+    int heading_after(size_t block) const;
+    // Last heading in a block before block, -1 if there is none.
+    int heading_before(size_t block) const;
+
+private:
+    std::vector<HeadingEntry> _headings;
+    std::vector<LinkEntry> _links;
+    std::unordered_map<std::string, size_t> _slugs;
+    // Per top-level block (plus one past the end): the first heading in
+    // that block or a later one.
+    std::vector<size_t> _first_heading{0};
+};
+
+} // namespace markdown
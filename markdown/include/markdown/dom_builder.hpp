@@ -1,20 +1,29 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/screen/box.hpp>
 
 #include "markdown/ast.hpp"
+#include "markdown/flat_ast.hpp"
+#include "markdown/line_layout.hpp"
+#include "markdown/scroll_frame.hpp"
 #include "markdown/theme.hpp"
+#include "markdown/virtual_list.hpp"
 
 namespace markdown {
 
 struct LinkTarget {
     std::vector<ftxui::Box> boxes;
     std::string url;
+    // Read by the link's elements at layout time; see set_focus().
+    std::shared_ptr<bool> focused;
 };
 
 struct FlatLinkBox {
@@ -22,20 +31,151 @@ struct FlatLinkBox {
     int link_index;
 };
 
+// Top-level blocks built from a MarkdownAST are memoized by content hash
+// (ASTNode::hash), theme name and quote depth.  A build takes every block
+// it finds in the memo, with its link targets, instead of building it
+// again; only link indices are renumbered.  A block repeated in the
+// document gets one entry per occurrence.  Entries unused for kMemoBuilds
+// builds are dropped.  FlatAST builds are not memoized.
+//
+// Elements do not depend on the focused link: each link element holds
+// both looks and picks one at layout time, so set_focus() moves the focus
+// without a rebuild or any allocation.
+//
+// Each top-level block keeps its layout between frames.  When only the
+// scroll offset changed, blocks out of view are neither laid out nor
+// rendered, and blocks in view are laid out again at their new position.
+//
+// With set_line_layout(true), MarkdownAST builds return a single
+// LineLayout element instead of an element tree: it paints only the
+// visible lines and fills the same link targets and source map.  Those
+// builds skip the memo.  FlatAST builds always make an element tree.
+//
+// With set_virtual_blocks(true), a Document's blocks go into a
+// VirtualList and are built only as they come near the viewport.  Every
+// link gets its LinkTarget (url, focus flag) up front; boxes appear once
+// its block is built.  Those builds skip the memo as well, and keep a copy
+// of the AST unless it is passed shared.
+//
+// The nodes the library makes itself (words, link looks, block boxes) are
+// allocated from a pool per build and thread instead of one by one, and
+// the pool is freed with the last of its nodes.  A word of text then costs
+// no allocation at all; ftxui's own containers and decorators still
+// allocate as usual.
 class DomBuilder {
 public:
+    static constexpr uint64_t kMemoBuilds = 2;
+
     ftxui::Element build(MarkdownAST const& ast, int focused_link = -1,
                          Theme const& theme = theme_default());
+    // Same output.  A virtual build shares ast instead of copying it and
+    // reads its blocks as they are built, during layout: it must not
+    // change while the element is in use.
+    ftxui::Element build(std::shared_ptr<MarkdownAST const> ast,
+                         int focused_link = -1,
+                         Theme const& theme = theme_default());
+    // Same output, built from the flat representation.
+    ftxui::Element build(FlatAST const& ast, int focused_link = -1,
+                         Theme const& theme = theme_default());
+    // Focus link (-1 for none) in the element of the last build; the
+    // next render shows it.  build() sets it to its focused_link.
+    void set_focus(int link);
+    int focused_link() const { return _focus; }
+    // Blocks the last build took from the memo.
+    size_t reused_blocks() const { return _reused; }
+    size_t memo_size() const { return _memo.size(); }
     std::vector<LinkTarget> const& link_targets() const { return _link_targets; }
-    std::vector<FlatLinkBox> const& flat_link_boxes() const { return _flat_boxes; }
+    std::vector<FlatLinkBox> const& flat_link_boxes() const;
+
+    // Source map of the last build: one entry per top-level block, in
+    // document order, with the byte range it was built from and the box
+    // it was laid out in.  Boxes are filled during layout and, unlike
+    // reflect(), are not clipped to the visible area.  Empty unless the
+    // root was a Document.
+    size_t block_count() const { return _blocks.size(); }
+    size_t block_source_begin(size_t i) const { return _blocks[i].source_begin; }
+    size_t block_source_end(size_t i) const { return _blocks[i].source_end; }
+    ftxui::Box block_box(size_t i) const;
+    // Last top-level block starting at or before offset, found by binary
+    // search; -1 if offset precedes every block.
+    int block_at_source(size_t offset) const;
+    // Last top-level block whose box starts at or above screen row y in
+    // the last layout; -1 if y is above every block.
+    int block_at_row(int y) const;
 
     void set_max_quote_depth(int d) { _max_quote_depth = d; }
     int max_quote_depth() const { return _max_quote_depth; }
+    // Threads building the blocks missing from the memo, the calling
+    // thread included; 0 means one per hardware thread.  1, the default,
+    // builds on the calling thread, as do builds of few blocks.
+    void set_build_threads(unsigned threads) { _build_threads = threads; }
+    unsigned build_threads() const { return _build_threads; }
+    // Allocate built nodes from build-scoped pools (the default), or one
+    // by one as plain ftxui elements.  The output is the same.
+    void set_node_pool(bool on) { _node_pool = on; }
+    bool node_pool() const { return _node_pool; }
+    void set_line_layout(bool on) { _line_layout = on; }
+    bool line_layout() const { return _line_layout; }
+    void set_virtual_blocks(bool on) { _virtual = on; }
+    bool virtual_blocks() const { return _virtual; }
+    // Where virtual blocks find the viewport; see VirtualList.
+    void set_viewport(ScrollInfo const* viewport);
+    // Top-level blocks of the last build that have elements.
+    size_t built_blocks() const;
 
 private:
+    // Element of one top-level block; its links end at link_end.
+    struct BuiltBlock {
+        ftxui::Element element;
+        size_t link_end;
+        size_t source_begin = 0;
+        size_t source_end = 0;
+        ftxui::Box box;
+        uint64_t memo_key = 0;    // 0 if not memoized
+        // Bumped when the block must be laid out again (see set_focus).
+        uint64_t layout_epoch = 0;
+    };
+
+    // A built block.  Its links live here between builds and in
+    // _link_targets while a build uses it.
+    struct MemoSlot {
+        ftxui::Element element;
+        std::vector<LinkTarget> links;
+        bool in_use = false;
+        uint64_t used = 0;        // last build that used or made it
+    };
+
+    template <class Node>
+    ftxui::Element build_root(Node const& root, int focused_link,
+                              Theme const& theme);
+    ftxui::Element build_lines(MarkdownAST const& ast, int focused_link,
+                               Theme const& theme);
+    ftxui::Element build_virtual(std::shared_ptr<MarkdownAST const> ast,
+                                 int focused_link, Theme const& theme);
+    // Hand the blocks of the last build back to the memo.
+    void release_blocks();
+    void evict_memo();
+    void index_link_boxes();
+    // Lay out the block holding link again at the next render.
+    void relayout_block_of(int link);
+
+    std::vector<BuiltBlock> _blocks;
     std::vector<LinkTarget> _link_targets;
     std::vector<FlatLinkBox> _flat_boxes;
     int _max_quote_depth = 10;
+    unsigned _build_threads = 1;
+    bool _node_pool = true;
+    bool _line_layout = false;
+    bool _virtual = false;
+    // What a virtual build's blocks are built from; shared with the list.
+    struct VirtualSource;
+    std::shared_ptr<VirtualSource> _virtual_source;
+    std::shared_ptr<VirtualList> _virtual_list;
+    ScrollInfo const* _viewport = nullptr;
+    size_t _reused = 0;
+    int _focus = -1;
+    std::unordered_map<uint64_t, MemoSlot> _memo;
+    uint64_t _build_count = 0;
 };
 
 } // namespace markdown
@@ -8,6 +8,7 @@
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/screen/box.hpp>
 
+#include "markdown/text_buffer.hpp"
 #include "markdown/theme.hpp"
 
 namespace markdown {
@@ -26,6 +27,14 @@ public:
 
     std::string const& content() const;
     void set_content(std::string text);
+    /// Snapshot of the content for Viewer::set_content(). Between edits
+    /// every call returns the same buffer (same version), so handing it
+    /// over each frame costs no copy; an edit costs one copy, on the next
+    /// call. The buffer records its edit from the previous one, which the
+    /// Viewer's incremental reparse uses as is.
+    TextBuffer const& buffer();
+    /// Incremented by every edit; cheaper than buffer() for change checks.
+    uint64_t revision() const { return _revision; }
 
     int cursor_line() const { return _cursor_line; }
     int cursor_col() const { return _cursor_col; }
@@ -43,6 +52,9 @@ private:
     std::vector<std::string_view> const& cached_lines();
 
     std::string _content;
+    TextBuffer _buffer;
+    uint64_t _revision = 1;
+    uint64_t _buffer_revision = 0;  // _revision when _buffer was taken
     int _cursor_pos = 0;
     int _cursor_line = 1;
     int _cursor_col = 1;
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "markdown/ast.hpp"
+
+namespace markdown {
+
+// One node of a FlatAST.  Literals are (offset, size) pairs into
+// FlatAST::arena; children follow their parent directly in preorder.
+struct FlatNode {
+    NodeType type = NodeType::Document;
+    int level = 0;
+    int list_start = 1;
+    uint32_t subtree_size = 1;  // this node plus all of its descendants
+    uint32_t text_offset = 0;
+    uint32_t text_size = 0;
+    uint32_t url_offset = 0;
+    uint32_t url_size = 0;
+    uint32_t info_offset = 0;
+    uint32_t info_size = 0;
+    size_t source_begin = 0;
+    size_t source_end = 0;
+
+    bool operator==(FlatNode const&) const = default;
+};
+
+class FlatAST;
+
+// Read-only handle to a node of a FlatAST.  Cheap to copy; valid while
+// the FlatAST is alive and unmodified.
+class FlatNodeRef {
+public:
+    class ChildIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatNodeRef;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = FlatNodeRef;
+
+        ChildIterator() = default;
+        ChildIterator(FlatAST const* ast, uint32_t index)
+            : _ast(ast), _index(index) {}
+
+        FlatNodeRef operator*() const { return {_ast, _index}; }
+        ChildIterator& operator++();
+        ChildIterator operator++(int) { auto it = *this; ++*this; return it; }
+        bool operator==(ChildIterator const& o) const {
+            return _index == o._index;
+        }
+
+    private:
+        FlatAST const* _ast = nullptr;
+        uint32_t _index = 0;
+    };
+
+    struct Children {
+        ChildIterator first;
+        ChildIterator last;
+        ChildIterator begin() const { return first; }
+        ChildIterator end() const { return last; }
+        bool empty() const { return first == last; }
+    };
+
+    FlatNodeRef(FlatAST const* ast, uint32_t index)
+        : _ast(ast), _index(index) {}
+
+    FlatAST const& ast() const { return *_ast; }
+    FlatNode const& node() const;
+    uint32_t index() const { return _index; }
+    NodeType type() const { return node().type; }
+    int level() const { return node().level; }
+    int list_start() const { return node().list_start; }
+    std::string_view text() const;
+    std::string_view url() const;
+    std::string_view info() const;
+    Children children() const;
+
+private:
+    FlatAST const* _ast;
+    uint32_t _index;
+};
+
+// Compact AST: every node in one preorder array, every literal in one
+// string.  A parse fills two buffers instead of allocating per node.
+// nodes[0] is the Document; an empty FlatAST has no root.
+class FlatAST {
+public:
+    std::vector<FlatNode> nodes;
+    std::string arena;
+
+    FlatNodeRef root() const { return {this, 0}; }
+    bool empty() const { return nodes.empty(); }
+    void clear() {
+        nodes.clear();
+        arena.clear();
+    }
+
+    // Building in preorder: open() appends a node and returns its index,
+    // close() records its subtree size once all descendants are appended.
+    uint32_t open(NodeType type) {
+        nodes.push_back(FlatNode{.type = type});
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+    void close(uint32_t index) {
+        nodes[index].subtree_size =
+            static_cast<uint32_t>(nodes.size()) - index;
+    }
+    void set_text(uint32_t index, std::string_view s) {
+        store(s, nodes[index].text_offset, nodes[index].text_size);
+    }
+    void set_url(uint32_t index, std::string_view s) {
+        store(s, nodes[index].url_offset, nodes[index].url_size);
+    }
+    void set_info(uint32_t index, std::string_view s) {
+        store(s, nodes[index].info_offset, nodes[index].info_size);
+    }
+
+    std::string_view slice(uint32_t offset, uint32_t size) const {
+        return std::string_view(arena).substr(offset, size);
+    }
+
+    bool operator==(FlatAST const&) const = default;
+
+private:
+    void store(std::string_view s, uint32_t& offset, uint32_t& size) {
+        if (s.empty()) return;
+        offset = static_cast<uint32_t>(arena.size());
+        size = static_cast<uint32_t>(s.size());
+        arena.append(s);
+    }
+};
+
+// Convert a tree AST into the flat representation (iterative).
+void flatten(ASTNode const& root, FlatAST& out);
+
+inline FlatNode const& FlatNodeRef::node() const {
+    return _ast->nodes[_index];
+}
+inline std::string_view FlatNodeRef::text() const {
+    return _ast->slice(node().text_offset, node().text_size);
+}
+inline std::string_view FlatNodeRef::url() const {
+    return _ast->slice(node().url_offset, node().url_size);
+}
+inline std::string_view FlatNodeRef::info() const {
+    return _ast->slice(node().info_offset, node().info_size);
+}
+inline FlatNodeRef::Children FlatNodeRef::children() const {
+    return {{_ast, _index + 1}, {_ast, _index + node().subtree_size}};
+}
+inline FlatNodeRef::ChildIterator&
+FlatNodeRef::ChildIterator::operator++() {
+    _index += _ast->nodes[_index].subtree_size;
+    return *this;
+}
+
+} // namespace markdown
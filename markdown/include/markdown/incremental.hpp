@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "markdown/ast.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/text_buffer.hpp"
+
+namespace markdown {
+
+// Block-level incremental reparse.  Remembers the text behind the last AST
+// it produced; on update() it finds the edit from it to the new text, maps
+// the dirty byte range onto top-level blocks (via ASTNode::source_begin),
+// reparses
+// only those blocks plus their neighbours, and splices the result into the
+// AST in place.  Edits whose effect can reach past blank-line boundaries
+// (open code fences, HTML blocks, link reference definitions) fall back to
+// a full parse.  The result compares equal (ASTNode::operator==) to
+// parser.parse(text) for a parser that reports block ranges as cmark does:
+// structure, block source ranges and hashes all match.
+class IncrementalReparser {
+public:
+    // ast must be the AST returned by the previous update() (or untouched
+    // since reset()).  Returns the parser's success flag.  Full parses are
+    // bounded by limits; if they expire, ast holds the partial result,
+    // last_partial() is set and the next call parses in full again.
+    // Reparsed slices are not bounded: they span a few blocks.
+    //
+    // A TextBuffer that knows its edit from the previous text (see
+    // TextBuffer::edit_from()) is taken as is: the call then costs the
+    // reparsed blocks plus shifting the source ranges of the blocks after
+    // them, independent of the text's size.  Otherwise the texts are
+    // compared to find the edit.  Plain text is copied into a buffer.
+    bool update(MarkdownParser& parser, TextBuffer const& text,
+                MarkdownAST& ast, ParseLimits const& limits = {});
+    bool update(MarkdownParser& parser, std::string_view text,
+                MarkdownAST& ast, ParseLimits const& limits = {});
+
+    // Streaming variant for text that only grows: text must start with
+    // the text of the previous call.  Blocks are committed once a later
+    // block starts after a safe boundary; only the uncommitted tail is fed
+    // to the parser again, so the cost per call tracks the tail, not the
+    // document.  limits bound full parses as in update().
+    bool append(MarkdownParser& parser, TextBuffer const& text,
+                MarkdownAST& ast, ParseLimits const& limits = {});
+    bool append(MarkdownParser& parser, std::string_view text,
+                MarkdownAST& ast, ParseLimits const& limits = {});
+
+    // Forget the previous text; the next update() parses in full.
+    void reset();
+
+    // The text behind the last AST produced.
+    std::string_view text() const { return _text; }
+    TextBuffer const& buffer() const { return _text; }
+    // True if that AST is a base for the next call: the last parse was
+    // complete and succeeded, and reset() has not been called since.
+    bool valid() const { return _valid; }
+
+    // Bytes handed to the parser by the last call (0 if unchanged).
+    size_t last_reparsed_bytes() const { return _last_reparsed; }
+    bool last_was_full() const { return _last_full; }
+    // The last call's full parse was cut short by its limits.
+    bool last_partial() const { return _last_partial; }
+    // Leading top-level blocks the last call left untouched.
+    size_t unchanged_blocks() const { return _unchanged; }
+
+private:
+    bool full_parse(MarkdownParser& parser, TextBuffer const& text,
+                    MarkdownAST& ast, ParseLimits const& limits);
+
+    TextBuffer _text;
+    bool _valid = false;
+    bool _has_refdefs = false;
+    size_t _last_reparsed = 0;
+    bool _last_full = false;
+    bool _last_partial = false;
+    size_t _unchanged = 0;
+    size_t _tail_block = 0;    // first top-level block not yet committed
+    size_t _tail_begin = 0;    // byte offset where that block's line starts
+};
+
+namespace detail {
+
+// Boundary helpers shared with the parallel splitter.
+bool starts_fresh_block(std::string_view line);
+void shift_source(ASTNode& root, std::ptrdiff_t delta);
+
+} // namespace detail
+
+} // namespace markdown
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/box.hpp>
+#include <ftxui/screen/color.hpp>
+#include <ftxui/screen/screen.hpp>
+
+#include "markdown/ast.hpp"
+#include "markdown/theme.hpp"
+
+namespace markdown {
+
+// The cell attributes a decorator leaves on text, sampled once by
+// rendering it over a single cell.  Themes only use attribute and color
+// decorators, which is what makes them reducible to this.
+struct CellStyle {
+    bool bold = false;
+    bool dim = false;
+    bool italic = false;
+    bool underlined = false;
+    bool inverted = false;
+    bool has_fg = false;
+    bool has_bg = false;
+    ftxui::Color fg;
+    ftxui::Color bg;
+
+    static CellStyle sample(ftxui::Decorator const& decorator);
+    // This style with outer applied on top, as `element | outer` would:
+    // attributes add up, outer colors win.
+    CellStyle then(CellStyle const& outer) const;
+    void apply(ftxui::Pixel& pixel) const;
+    bool operator==(CellStyle const& other) const;
+};
+
+// A document laid out as lines of styled runs, for the line-layout render
+// path.  The AST is reduced once to rows of words; wrapping those rows
+// for a width is cached until the width changes, and the element paints
+// only the lines inside the visible area.  Unlike the element tree, no
+// per-word nodes exist, so a frame costs the visible lines plus one box
+// per top-level block.
+//
+// Links and top-level blocks are numbered as DomBuilder numbers them.
+// Each link keeps one box per word, written while painting the way
+// ftxui::reflect() writes them, clipped to the visible area.  Boxes of
+// links out of view are left empty, except the focused link's.
+class LineLayout {
+public:
+    struct LinkInfo {
+        std::string url;
+        size_t words = 0;
+    };
+    struct BlockInfo {
+        size_t source_begin = 0;
+        size_t source_end = 0;
+        size_t link_end = 0;   // links of this block end here
+    };
+    // Where painting writes its results.  boxes has LinkInfo::words
+    // entries; both stay valid for the element's lifetime.
+    struct LinkOutput {
+        ftxui::Box* boxes = nullptr;
+        std::shared_ptr<bool const> focused;
+    };
+
+    LineLayout(MarkdownAST const& ast, Theme const& theme,
+               int max_quote_depth);
+
+    std::vector<LinkInfo> const& links() const { return _links; }
+    std::vector<BlockInfo> const& blocks() const { return _blocks; }
+    void bind(std::vector<LinkOutput> links,
+              std::vector<ftxui::Box*> block_boxes);
+
+    // Lines at this width, wrapping first if the width changed.
+    int line_count(int width);
+    size_t row_count() const { return _rows.size(); }
+    size_t word_count() const { return _words.size(); }
+
+    // Lay out and paint; used by the element.
+    void set_box(ftxui::Box box);
+    void paint(ftxui::Screen& screen);
+
+private:
+    enum class RowKind : uint8_t { Text, Rule, BoxTop, BoxLine, BoxBottom };
+
+    // Text lives in _text; words and prefix pieces point into it.
+    struct Piece {
+        uint32_t begin = 0;
+        uint32_t size = 0;
+        int width = 0;
+        uint16_t style = 0;
+    };
+    struct Word {
+        uint32_t begin = 0;
+        uint32_t size = 0;
+        int width = 0;
+        uint16_t style = 0;
+        uint16_t focus_style = 0;  // used while its link is focused
+        int32_t link = -1;
+        uint32_t link_word = 0;    // index into that link's boxes
+    };
+    // One logical line: a paragraph between hard breaks, a code line, a
+    // rule or a border.  Text rows wrap; the others are one line each.
+    struct Row {
+        RowKind kind = RowKind::Text;
+        uint16_t style = 0;        // rules, borders and their title
+        uint32_t lead_begin = 0;   // prefix pieces of the first line
+        uint32_t lead_count = 0;
+        uint32_t indent_begin = 0; // prefix pieces of further lines
+        uint32_t indent_count = 0;
+        uint32_t word_begin = 0;   // Text: words; BoxTop/BoxLine: text
+        uint32_t word_end = 0;
+        uint32_t block = 0;        // top-level block, kNoBlock between
+    };
+    struct Line {
+        uint32_t row = 0;
+        uint32_t word_begin = 0;
+        uint32_t word_end = 0;
+        bool first = true;
+    };
+
+    static constexpr uint32_t kNoBlock = UINT32_MAX;
+
+    struct Builder;
+    friend struct Builder;
+
+    void wrap(int width);
+    int prefix_width(uint32_t begin, uint32_t count) const;
+    int paint_text(ftxui::Screen& screen, int x, int y, uint32_t begin,
+                   uint32_t size, CellStyle const& style) const;
+    void paint_line(ftxui::Screen& screen, size_t line, int y);
+    void clear_painted();
+    void place_link(size_t link, ftxui::Box const& stencil);
+
+    std::string _text;
+    std::vector<CellStyle> _styles;
+    std::vector<Piece> _pieces;
+    std::vector<Word> _words;
+    std::vector<Row> _rows;
+    std::vector<LinkInfo> _links;
+    std::vector<BlockInfo> _blocks;
+
+    int _width = -1;
+    std::vector<Line> _lines;
+    // Per block, its lines as [first, end).
+    std::vector<std::pair<size_t, size_t>> _block_lines;
+
+    ftxui::Box _box;
+    std::vector<LinkOutput> _link_out;
+    std::vector<ftxui::Box*> _block_out;
+    // Link word boxes written by the last paint, cleared by the next.
+    std::vector<ftxui::Box*> _painted;
+};
+
+// The element painting layout; it keeps the layout alive.
+ftxui::Element line_layout(std::shared_ptr<LineLayout> layout);
+
+} // namespace markdown
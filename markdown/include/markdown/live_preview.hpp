@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+#include <ftxui/component/component.hpp>
+
+#include "markdown/editor.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/theme.hpp"
+#include "markdown/viewer.hpp"
+
+namespace ftxui {
+class ScreenInteractive;
+}
+
+namespace markdown {
+
+/// An Editor wired to a Viewer that previews its content.
+///
+/// Edits reach the viewer through a debounce whose interval adapts to the
+/// measured cost of recent viewer updates: while an update fits in the
+/// frame budget every keystroke is shown at once; beyond that, keystrokes
+/// are coalesced until typing pauses for about twice the update cost, and
+/// a burst of typing still refreshes the preview every few intervals.
+/// Held edits wake the active screen once, when their interval ends.
+class LivePreview {
+public:
+    using Duration = std::chrono::microseconds;
+
+    explicit LivePreview(std::unique_ptr<MarkdownParser> parser);
+    LivePreview(LivePreview&&) = delete;
+    LivePreview& operator=(LivePreview&&) = delete;
+
+    Editor& editor() { return _editor; }
+    Viewer& viewer() { return _viewer; }
+
+    /// Editor and preview side by side. Created on first call, cached
+    /// thereafter; do not move this object after calling component().
+    ftxui::Component component();
+
+    /// Forward pending edits to the viewer if the debounce allows it and
+    /// keep the preview scrolled to the cursor. component() calls this
+    /// every frame; hosts with their own layout call it from their
+    /// renderer before rendering the viewer.
+    void sync();
+    /// Forward pending edits now, ignoring the debounce.
+    void flush();
+
+    void set_theme(Theme const& theme);
+    /// Time a viewer update may take before keystrokes get coalesced.
+    /// Default: 16ms.
+    void set_frame_budget(Duration budget) { _budget = budget; }
+    Duration frame_budget() const { return _budget; }
+    /// Follow the editor cursor with the preview's scroll position while
+    /// the viewer is not active. Default: on.
+    void set_scroll_sync(bool on) { _scroll_sync = on; }
+
+    /// Smoothed cost of recent viewer updates.
+    Duration measured_cost() const { return _cost; }
+    /// Quiet time required before pending edits are forwarded; zero while
+    /// updates fit in the frame budget.
+    Duration debounce_interval() const;
+    bool pending() const { return _editor.revision() != _pushed_revision; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void push();
+    void sample_cost();
+    void wake_at(Clock::time_point at);
+    void wake_loop(std::stop_token stop);
+
+    Editor _editor;
+    Viewer _viewer;
+    ftxui::Component _component;
+    Duration _budget{16000};
+    Duration _cost{0};
+    bool _scroll_sync = true;
+    uint64_t _pushed_revision = 0;  // editor revision shown in the viewer
+    uint64_t _seen_revision = 0;    // editor revision at the last sync()
+    uint64_t _seen_updates = 0;     // viewer update_count() already sampled
+    Clock::time_point _first_edit;  // oldest edit not yet forwarded
+    Clock::time_point _last_edit;
+
+    // Wake-up for held edits: _waker posts Event::Custom to _wake_screen
+    // at _wake_at (max() when none is due).  Started on first use.
+    std::mutex _wake_mutex;
+    std::condition_variable_any _wake_cv;
+    Clock::time_point _wake_at = Clock::time_point::max();
+    ftxui::ScreenInteractive* _wake_screen = nullptr;
+    std::jthread _waker;  // last: stopped before the state above goes
+};
+
+} // namespace markdown
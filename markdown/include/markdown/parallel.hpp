@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "markdown/ast.hpp"
+#include "markdown/parser.hpp"
+
+namespace markdown {
+
+using ParserFactory = std::function<std::unique_ptr<MarkdownParser>()>;
+
+struct ParseManyOptions {
+    // Worker count, the calling thread included.  0 means one per
+    // hardware thread.  Never more than there are inputs.
+    unsigned threads = 0;
+    // Called once per worker: parsers are not thread-safe, so each worker
+    // parses with its own instance.
+    ParserFactory make_parser = make_cmark_parser;
+};
+
+// Parse inputs[i] into out[i] on a bounded pool of worker threads.
+// Workers take the largest remaining input first, so one long document
+// does not end up last on a single core.  out must be as long as inputs.
+// Returns how many parses succeeded.
+size_t parse_many(std::span<std::string_view const> inputs,
+                  std::span<MarkdownAST> out,
+                  ParseManyOptions const& options = {});
+
+// Convenience overload returning the ASTs.
+std::vector<MarkdownAST> parse_many(std::span<std::string_view const> inputs,
+                                    ParseManyOptions const& options = {});
+
+struct ParallelParseOptions {
+    unsigned threads = 0;
+    ParserFactory make_parser = make_cmark_parser;
+    // Chunks are cut at the first split point past this size (or past
+    // size / 4 per worker, if larger).  Shorter texts, and texts that
+    // yield a single chunk, parse on the calling thread.
+    size_t min_chunk_bytes = 256 * 1024;
+};
+
+// Offsets where a top-level block starts after a blank line and nothing
+// before it is still open: no fenced code or kind 1-5 HTML block, and no
+// list or block quote, since the line is unindented and not a list item.
+// Parsing text[0, p) and text[p, end) separately then gives the blocks a
+// whole parse would, as long as no link reference definitions are
+// involved.  The lines are found with a 16-byte SIMD scan.
+std::vector<size_t> split_points(std::string_view text);
+
+// Parse one large text by cutting it at split points into chunks that are
+// parsed concurrently by parse_many(), then stitched into one AST with
+// source ranges rebased.  The result equals a parse of the whole text:
+// chunks holding "]:" become their own chunks and are parsed in front of
+// every other chunk, so reference definitions reach links anywhere, and
+// each cut is checked to leave no block open.  If a check fails, the text
+// is parsed again in one piece.
+bool parse_parallel(std::string_view text, MarkdownAST& out,
+                    ParallelParseOptions const& options = {});
+
+// A MarkdownParser running parse_parallel(), for a Viewer that opens very
+// large documents.
+std::unique_ptr<MarkdownParser> make_parallel_parser(
+    ParallelParseOptions options = {});
+
+namespace detail {
+
+// A text cut at split points into chunks that parse on their own.  The
+// segments holding "]:" are copied into head, which goes in front of
+// every chunk so reference definitions reach links anywhere; a sentinel
+// paragraph closes it, and follows every chunk but the last.
+struct ChunkPlan {
+    std::string head;
+    std::vector<size_t> cuts{0};  // chunk c is [cuts[c], cuts[c + 1])
+    size_t chunks() const { return cuts.size() - 1; }
+};
+
+// Cut at the first split point past target bytes, and on both sides of
+// every run of defining segments.  One chunk without a head if points is
+// empty or the definitions exceed an eighth of the text.
+ChunkPlan plan_chunks(std::string_view text, std::span<size_t const> points,
+                      size_t target);
+
+// Parser input for the chunks from c up to d, merged into one.
+std::string chunk_input(ChunkPlan const& plan, std::string_view text,
+                        size_t c, size_t d);
+
+// Move the blocks of chunks [c, d) out of part, the parse of
+// chunk_input(plan, text, c, d), onto blocks with source ranges rebased.
+// False if a sentinel is missing, i.e. a cut left a block open.
+bool take_chunk(ChunkPlan const& plan, size_t c, size_t d, MarkdownAST& part,
+                std::vector<ASTNode>& blocks);
+
+} // namespace detail
+
+} // namespace markdown
@@ -1,12 +1,61 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
+#include <stop_token>
+#include <string>
 #include <string_view>
 
 #include "markdown/ast.hpp"
+#include "markdown/flat_ast.hpp"
 
 namespace markdown {
 
+// One document delivered in chunks.  feed() may split the input anywhere,
+// even mid-line; finish() is called once and yields the same AST as
+// parsing the concatenated chunks.
+class ParseStream {
+public:
+    virtual ~ParseStream() = default;
+    virtual void feed(std::string_view chunk) = 0;
+    virtual bool finish(MarkdownAST& out) = 0;
+};
+
+// Bounds on one parse: a deadline and a stop token.  Once either trips,
+// a bounded parse stops and returns what it has.
+struct ParseLimits {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point deadline = Clock::time_point::max();
+    std::stop_token stop;
+
+    static ParseLimits within(Clock::duration budget,
+                              std::stop_token stop = {}) {
+        return {.deadline = Clock::now() + budget, .stop = std::move(stop)};
+    }
+
+    bool bounded() const {
+        return deadline != Clock::time_point::max() || stop.stop_possible();
+    }
+    bool expired() const {
+        return stop.stop_requested() ||
+               (deadline != Clock::time_point::max() &&
+                Clock::now() >= deadline);
+    }
+};
+
+enum class ParseStatus {
+    Complete,  // same AST as parse(input, out)
+    Partial,   // cut short by the limits, see parse(input, out, limits)
+    Failed,    // parse(input, out) would have returned false
+};
+
+namespace detail {
+// The raw-text fallback: a paragraph holding input[from, end) verbatim,
+// appended to doc's blocks.
+void append_raw_text(MarkdownAST& doc, std::string_view input, size_t from);
+} // namespace detail
+
 class MarkdownParser {
 public:
     virtual ~MarkdownParser() = default;
@@ -14,6 +63,35 @@ public:
     // Returns false if parsing failed (out will contain a raw-text fallback).
     virtual bool parse(std::string_view input, MarkdownAST& out) = 0;
 
+    // Bounded parse.  If the limits expire first, returns Partial: out
+    // holds the blocks parsed in time, then the rest of the input as one
+    // raw-text paragraph.  The default can only check the limits before
+    // it starts; the cmark parser checks them while it runs.
+    virtual ParseStatus parse(std::string_view input, MarkdownAST& out,
+                              ParseLimits const& limits) {
+        if (limits.expired()) {
+            out = ASTNode{.type = NodeType::Document,
+                          .source_end = input.size()};
+            detail::append_raw_text(out, input, 0);
+            return ParseStatus::Partial;
+        }
+        return parse(input, out) ? ParseStatus::Complete
+                                 : ParseStatus::Failed;
+    }
+
+    // Flat variant: fills out with preorder nodes and a single text arena.
+    // The default converts the tree AST; parsers may fill it directly.
+    virtual bool parse(std::string_view input, FlatAST& out) {
+        MarkdownAST ast;
+        bool ok = parse(input, ast);
+        flatten(ast, out);
+        return ok;
+    }
+
+    // Start a chunked parse.  The default buffers the chunks and calls
+    // parse() on finish().
+    virtual std::unique_ptr<ParseStream> open_stream();
+
     // Convenience overload — returns AST directly, ignoring success/failure.
     MarkdownAST parse(std::string_view input) {
         MarkdownAST ast;
@@ -22,8 +100,39 @@ public:
     }
 };
 
+namespace detail {
+class BufferedParseStream : public ParseStream {
+public:
+    explicit BufferedParseStream(MarkdownParser& parser) : _parser(parser) {}
+    void feed(std::string_view chunk) override { _buffer.append(chunk); }
+    bool finish(MarkdownAST& out) override {
+        return _parser.parse(_buffer, out);
+    }
+
+private:
+    MarkdownParser& _parser;
+    std::string _buffer;
+};
+} // namespace detail
+
+inline std::unique_ptr<ParseStream> MarkdownParser::open_stream() {
+    return std::make_unique<detail::BufferedParseStream>(*this);
+}
+
 // Factory — creates a parser backed by cmark-gfm.
 // cmark types are fully hidden inside the implementation.
 std::unique_ptr<MarkdownParser> make_cmark_parser();
 
+// Factory — a native parser for the Markdown subset typical of emails and
+// chat replies, producing the same AST as make_cmark_parser().  Documents
+// outside the subset (HTML, entities, reference links, setext headings,
+// indented code, tabs...) are handed to cmark transparently.
+std::unique_ptr<MarkdownParser> make_fast_parser();
+
+namespace detail {
+// The fast path alone: returns false, leaving out unspecified, if input
+// uses anything outside the supported subset.
+bool parse_fast(std::string_view input, MarkdownAST& out);
+} // namespace detail
+
 } // namespace markdown
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+namespace markdown {
+
+// One replacement of bytes: [offset, offset + removed) of the old text
+// became [offset, offset + inserted) of the new one.
+struct TextEdit {
+    size_t offset = 0;
+    size_t removed = 0;
+    size_t inserted = 0;
+};
+
+// The edit between two texts: everything between their common prefix and
+// common suffix.  O(size of the texts).
+TextEdit diff_text(std::string_view old, std::string_view text);
+
+// Shared, immutable, versioned text.  Copies share one allocation, and
+// every distinct text gets a fresh version number, so two buffers with the
+// same version hold the same text: comparing versions is an O(1) stand-in
+// for comparing contents.  Version 0 is the empty default buffer.
+//
+// The bytes a buffer covers never change.  Buffers that share storage
+// differ only in how much of it they cover, which lets append() write
+// past the end of the text without copying it.
+class TextBuffer {
+public:
+    TextBuffer() = default;
+    explicit TextBuffer(std::string_view text);
+    // text as an edit of base, found with diff_text(); edit_from(base)
+    // then returns it in O(1).
+    TextBuffer(std::string_view text, TextBuffer const& base);
+
+    std::string_view view() const { return {_data, _size}; }
+    operator std::string_view() const { return view(); }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    uint64_t version() const { return _version; }
+
+    // Append text under a new version.  The first buffer to append to
+    // shared storage writes into its spare capacity; any other buffer, or
+    // one whose storage is full, copies the text into new storage with
+    // room to grow.  Appending to the most recent buffer is amortized
+    // O(more.size()), and holders of other copies never see a change.
+    void append(std::string_view more);
+
+    // How this text differs from base, if known without comparing them:
+    // base is this buffer, the one it was appended to or edited from, or
+    // shares its storage as a prefix.
+    std::optional<TextEdit> edit_from(TextBuffer const& base) const;
+    // True if base's text is a prefix of this one.  O(1) in the cases
+    // edit_from() knows, a comparison otherwise.
+    bool extends(TextBuffer const& base) const;
+
+private:
+    struct Storage;
+
+    std::shared_ptr<Storage> _storage;
+    char const* _data = nullptr;  // _storage's bytes
+    size_t _size = 0;
+    uint64_t _version = 0;
+    uint64_t _base_version = 0;  // version _edit applies to
+    TextEdit _edit;
+};
+
+} // namespace markdown
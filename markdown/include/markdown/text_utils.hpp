@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -161,37 +162,56 @@ inline std::vector<std::string_view> split_lines(std::string_view text) {
     return lines;
 }
 
+// True if text has no byte >= 0x80.  Tests eight bytes per load (SWAR),
+// four loads per step, and stops at the first step that finds one.
+inline bool is_ascii(std::string_view text) {
+    constexpr uint64_t kHigh = 0x8080808080808080ull;
+    char const* p = text.data();
+    size_t n = text.size();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        uint64_t a, b, c, d;
+        std::memcpy(&a, p + i, 8);
+        std::memcpy(&b, p + i + 8, 8);
+        std::memcpy(&c, p + i + 16, 8);
+        std::memcpy(&d, p + i + 24, 8);
+        if ((a | b | c | d) & kHigh) return false;
+    }
+    uint64_t acc = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        acc |= w;
+    }
+    for (; i < n; ++i) acc |= static_cast<unsigned char>(p[i]);
+    return (acc & kHigh) == 0;
+}
+
 // Sanitize emoji sequences for correct FTXUI width measurement:
 // 1. Strip VS16 (U+FE0F) — emoji presentation selector that desyncs widths.
 // 2. Collapse ZWJ (U+200D) sequences — e.g. 🏃‍♂️ becomes just 🏃.
 // Keeps ZWJ for Arabic/Indic ligatures (next codepoint < 0x2000).
-inline std::string normalize_emoji_width(std::string_view text) {
-    // Quick scan: if no multi-byte UTF-8, no emoji possible.
-    bool needs_sanitize = false;
-    for (char c : text) {
-        if (static_cast<unsigned char>(c) >= 0xC0) {
-            needs_sanitize = true;
-            break;
-        }
-    }
-    if (!needs_sanitize) return std::string(text);
+// Only ever removes bytes, so it works in place: returns the new size of
+// text[0, size).  ASCII text is left untouched after one is_ascii() scan.
+// The parsers apply it to every literal they emit.
+inline size_t normalize_emoji_width_in_place(char* text, size_t size) {
+    if (is_ascii({text, size})) return size;
 
-    std::string result;
-    result.reserve(text.size());
+    size_t out = 0;
     size_t i = 0;
-    while (i < text.size()) {
+    while (i < size) {
         size_t len = utf8_byte_length(text[i]);
-        len = std::min(len, text.size() - i);
-        uint32_t cp = utf8_codepoint(text.data() + i, len);
+        len = std::min(len, size - i);
+        uint32_t cp = utf8_codepoint(text + i, len);
 
         // Strip VS16 (emoji presentation selector)
         if (cp == 0xFE0F) { i += len; continue; }
 
         // Collapse ZWJ sequences in emoji context
-        if (cp == 0x200D && i + len < text.size()) {
+        if (cp == 0x200D && i + len < size) {
             size_t next_len = utf8_byte_length(text[i + len]);
-            next_len = std::min(next_len, text.size() - i - len);
-            uint32_t next_cp = utf8_codepoint(text.data() + i + len, next_len);
+            next_len = std::min(next_len, size - i - len);
+            uint32_t next_cp = utf8_codepoint(text + i + len, next_len);
             if (next_cp >= 0x2000) {
                 // Skip both ZWJ and the following emoji codepoint
                 i += len + next_len;
@@ -199,9 +219,20 @@ inline std::string normalize_emoji_width(std::string_view text) {
             }
         }
 
-        result.append(text.data() + i, len);
+        if (out != i) std::memmove(text + out, text + i, len);
+        out += len;
         i += len;
     }
+    return out;
+}
+
+inline void normalize_emoji_width_in_place(std::string& text) {
+    text.resize(normalize_emoji_width_in_place(text.data(), text.size()));
+}
+
+inline std::string normalize_emoji_width(std::string_view text) {
+    std::string result(text);
+    normalize_emoji_width_in_place(result);
     return result;
 }
 
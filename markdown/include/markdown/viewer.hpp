@@ -1,17 +1,24 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <memory>
+#include <stop_token>
 #include <string>
 #include <string_view>
+#include <thread>
 
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/event.hpp>
 #include <ftxui/dom/elements.hpp>
 
+#include "markdown/doc_index.hpp"
 #include "markdown/dom_builder.hpp"
+#include "markdown/incremental.hpp"
 #include "markdown/parser.hpp"
 #include "markdown/scroll_frame.hpp"
+#include "markdown/text_buffer.hpp"
 
 namespace markdown {
 
@@ -29,10 +36,47 @@ struct ViewerKeys {
 class Viewer {
 public:
     explicit Viewer(std::unique_ptr<MarkdownParser> parser);
+    ~Viewer();
     Viewer(Viewer&&) = delete;
     Viewer& operator=(Viewer&&) = delete;
 
     void set_content(std::string_view markdown_text);
+    /// Share a buffer instead of copying text. A buffer with the version
+    /// already shown is ignored, so passing Editor::buffer() every frame
+    /// only costs a parse when the text was edited.
+    void set_content(TextBuffer content);
+    /// Append to the content, e.g. tokens of a streamed response. While
+    /// only appends happen, closed blocks keep their AST and elements and
+    /// just the trailing open block is reparsed and rebuilt.
+    void append_content(std::string_view markdown_text);
+    /// Reparse only the top-level blocks touched by each set_content()
+    /// instead of the whole document. Off by default.
+    void set_incremental(bool on);
+    bool incremental() const { return _incremental; }
+    /// Parse and build on a background thread. The renderer keeps showing
+    /// the last finished element and posts a redraw when a newer one is
+    /// ready; intermediate versions of fast-changing content are skipped.
+    /// Off by default.
+    void set_async(bool on);
+    bool async() const { return _async; }
+    /// Bound each full parse done while rendering to budget; 0 (the
+    /// default) means unbounded. A parse that runs out of time shows the
+    /// blocks parsed so far and the rest as raw text, and the next change
+    /// parses in full again. In async mode a parse is instead cancelled
+    /// when newer content arrives.
+    void set_parse_budget(std::chrono::microseconds budget) {
+        _parse_budget = budget;
+    }
+    std::chrono::microseconds parse_budget() const { return _parse_budget; }
+    /// True if the shown AST comes from a parse the budget cut short.
+    bool last_parse_partial() const { return _parse_partial; }
+    /// Wall time of the last parse and/or build done while rendering, and
+    /// how many renders did one. Async work is not counted.
+    std::chrono::nanoseconds last_update_cost() const { return _update_cost; }
+    uint64_t update_count() const { return _update_count; }
+    /// Top-level blocks the last build kept from the one before it:
+    /// blocks whose content did not change and that no focus move touched.
+    size_t last_reused_blocks() const { return _builder.reused_blocks(); }
     void set_scroll(float ratio);
     void show_scrollbar(bool show);
     void on_link_click(
@@ -49,6 +93,27 @@ public:
         ++_builder_gen;
     }
     int max_quote_depth() const { return _builder.max_quote_depth(); }
+    /// Render through a LineLayout, painting only the visible lines,
+    /// instead of an element per word (see DomBuilder::set_line_layout).
+    void set_line_layout(bool on) {
+        _builder.set_line_layout(on);
+        ++_builder_gen;
+    }
+    bool line_layout() const { return _builder.line_layout(); }
+    /// Build and lay out only the blocks near the viewport (see
+    /// DomBuilder::set_virtual_blocks).
+    void set_virtual_blocks(bool on) {
+        _builder.set_virtual_blocks(on);
+        ++_builder_gen;
+    }
+    bool virtual_blocks() const { return _builder.virtual_blocks(); }
+    /// Threads building the blocks of a document (see
+    /// DomBuilder::set_build_threads).  The output does not depend on it.
+    void set_build_threads(unsigned threads) {
+        _builder.set_build_threads(threads);
+        ++_builder_gen;
+    }
+    unsigned build_threads() const { return _builder.build_threads(); }
 
     /// Returns the FTXUI component. Created on first call, cached thereafter.
     /// Configure the object (set_content, set_theme, on_link_click, etc.)
@@ -83,22 +148,64 @@ public:
     /// Call during event handling when link boxes are fresh from layout.
     void scroll_to_focus();
 
+    /// Content row showing source byte offset, from the last layout: the
+    /// top-level block holding it is found by binary search, and the row
+    /// is interpolated within the block's height.  -1 before any layout.
+    int source_row(size_t offset) const;
+    /// Scroll so the row showing source offset sits a third of the way
+    /// down the viewport. Returns false (and leaves the scroll alone)
+    /// before any layout.
+    bool scroll_to_source(size_t offset);
+
+    /// Headings and links of the content, indexed when it is parsed. In
+    /// sync mode that is the next render (or enter_focus()); in async
+    /// mode the index arrives with the build.
+    DocumentIndex const& index() const { return _index; }
+    /// Scroll heading i of index() to a third of the way down the
+    /// viewport. False if there is no such heading or no layout yet.
+    bool jump_to_heading(size_t i);
+    /// Jump to the heading after (direction > 0) or before the one at the
+    /// reading position, a third of the way down the viewport.
+    bool next_heading(int direction = +1);
+    /// Links to "#slug" jump to the matching heading when pressed instead
+    /// of being reported to on_link_click. Returns false, doing nothing,
+    /// for any other url.
+    bool follow_fragment(std::string_view url);
+
 private:
+    struct AsyncJob;
+    struct AsyncResult;
+
+    void parse_sync();
+    void render_sync();
+    void render_async();
+    void clamp_focus();
+    void stop_worker();
+    void worker_loop();
+
     std::unique_ptr<MarkdownParser> _parser;
     DomBuilder _builder;
-    std::string _content;
+    TextBuffer _content;
     uint64_t _content_gen = 0;
     uint64_t _parsed_gen = 0;
     uint64_t _built_gen = 0;
     MarkdownAST _cached_ast;
+    DocumentIndex _index;
+    IncrementalReparser _reparser;
+    bool _incremental = false;
+    bool _only_appended = true;   // no set_content() since the last parse
+    std::chrono::microseconds _parse_budget{0};
+    bool _parse_partial = false;
+    std::chrono::nanoseconds _update_cost{0};
+    uint64_t _update_count = 0;
     ftxui::Element _cached_element = ftxui::text("");
     float _scroll_ratio = 0.0f;
+    float _layout_ratio = 0.0f;   // _scroll_ratio at the last render
     ScrollInfo _scroll_info;
     bool _show_scrollbar = true;
     bool _active = false;
     int _focus_index = -1;
     int _focused_link = -1;       // derived from _focus_index for DomBuilder
-    int _last_focused_link = -1;
     Theme _theme{theme_default()};
     uint64_t _theme_gen = 0;
     uint64_t _built_theme_gen = 0;
@@ -110,6 +217,25 @@ private:
     ftxui::Component _component;
     bool _embed = false;
     ScrollInfo* _ext_scroll_info = nullptr;
+    // The last heading jumped to, while the scroll stays where it put it.
+    int _jump_heading = -1;
+    float _jump_ratio = -1.0f;
+
+    // Async mode.  The UI thread publishes the newest request in _job and
+    // takes finished elements from _result; each slot holds at most one
+    // entry, and a newer one replaces (drops) an unclaimed older one.  The
+    // worker owns _parser, _cached_ast and _reparser while it runs.
+    bool _async = false;
+    bool _job_sent = false;        // a request matching the gens below exists
+    uint64_t _sent_content_gen = 0;
+    uint64_t _sent_theme_gen = 0;
+    uint64_t _sent_builder_gen = 0;
+    uint64_t _worker_parsed_gen = 0; // written by the worker only
+    std::stop_source _job_cancel;   // stops the parse of the sent content
+    std::atomic<AsyncJob*> _job{nullptr};
+    std::atomic<AsyncResult*> _result{nullptr};
+    std::atomic<AsyncResult*> _spare{nullptr}; // consumed result, for reuse
+    std::thread _worker;
 };
 
 } // namespace markdown
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/box.hpp>
+#include <ftxui/screen/screen.hpp>
+
+#include "markdown/scroll_frame.hpp"
+
+namespace markdown {
+
+// Heights of a sequence of blocks, with prefix sums and row lookup in
+// O(log n) through a Fenwick tree.
+class HeightIndex {
+public:
+    void assign(std::vector<int> heights);
+    void set(size_t i, int height);
+    size_t size() const { return _heights.size(); }
+    int height(size_t i) const { return _heights[i]; }
+    // Rows above block i.
+    int offset(size_t i) const;
+    int total() const { return offset(_heights.size()); }
+    // Block containing row y, counted from the top; size() past the end.
+    size_t find(int y) const;
+
+private:
+    std::vector<int> _heights;
+    std::vector<int> _tree;  // 1-based Fenwick tree over _heights
+};
+
+// A vbox whose blocks are built, laid out and rendered only when they
+// come near the viewport.  Every block starts with an estimated height;
+// laying it out replaces the estimate with its real height, and a change
+// asks ftxui for another layout pass so scroll extents settle in the same
+// frame.  Blocks are found by binary search over the heights, so a frame
+// costs the visible blocks whatever the length of the list.
+//
+// Elements of blocks more than kRetain rows outside the laid-out range are
+// released, so memory follows the viewport too; they are built again if
+// they come back.
+//
+// The viewport is read from the ScrollInfo a DirectScrollFrame fills just
+// before laying out its child; without one, the list's own box is taken
+// as visible.
+class VirtualList {
+public:
+    using Build = std::function<ftxui::Element(size_t)>;
+    // Called with each block laid out before but not in the latest
+    // layout, whose reflected boxes would otherwise go stale.
+    using Hide = std::function<void(size_t)>;
+    // Rows laid out past each edge of the viewport.
+    static constexpr int kOverscan = 8;
+    // Rows past the laid-out range whose built elements are kept.
+    static constexpr int kRetain = 256;
+
+    // gap empty rows separate consecutive blocks.
+    VirtualList(std::vector<int> estimates, Build build, int gap = 1);
+
+    void set_viewport(ScrollInfo const* viewport) { _viewport = viewport; }
+    void on_hide(Hide hide) { _hide = std::move(hide); }
+    size_t size() const { return _elements.size(); }
+    // Blocks with an element, and blocks laid out by the last layout.
+    size_t built() const { return _live.size(); }
+    size_t laid_out() const { return _last - _first; }
+
+    // Box of block i in the last layout; estimated for blocks not laid
+    // out.  Never clipped to the viewport.
+    ftxui::Box block_box(size_t i) const;
+    // Last block starting at or above screen row y, -1 if none.
+    int block_at_row(int y) const;
+
+    // Used by the element.
+    int total_height() const;
+    // Lays out the blocks near the viewport; true if a height changed.
+    bool layout(ftxui::Box box);
+    void render(ftxui::Screen& screen);
+
+private:
+    ftxui::Element& element(size_t i);
+
+    HeightIndex _heights;  // block rows plus the gap below
+    std::vector<ftxui::Element> _elements;
+    Build _build;
+    Hide _hide;
+    int _gap;
+    std::vector<size_t> _live;  // blocks with an element
+    ScrollInfo const* _viewport = nullptr;
+    ftxui::Box _box;
+    size_t _first = 0;
+    size_t _last = 0;
+};
+
+// The element laying out and rendering the list; it keeps it alive.
+ftxui::Element virtual_vbox(std::shared_ptr<VirtualList> list);
+
+} // namespace markdown
@@ -0,0 +1,597 @@
+#include "markdown/ast_cache.hpp"
+#include "markdown/ast_diff.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace markdown {
+namespace {
+
+namespace fs = std::filesystem;
+
+// ---------------------------------------------------------------------
+// Hash (the XXH64 construction)
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+uint64_t read64(char const* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof v);
+    if constexpr (std::endian::native == std::endian::big) {
+        v = ((v & 0x00000000000000FFULL) << 56) |
+            ((v & 0x000000000000FF00ULL) << 40) |
+            ((v & 0x0000000000FF0000ULL) << 24) |
+            ((v & 0x00000000FF000000ULL) << 8) |
+            ((v & 0x000000FF00000000ULL) >> 8) |
+            ((v & 0x0000FF0000000000ULL) >> 24) |
+            ((v & 0x00FF000000000000ULL) >> 40) |
+            ((v & 0xFF00000000000000ULL) >> 56);
+    }
+    return v;
+}
+
+uint64_t mix_round(uint64_t acc, uint64_t input) {
+    return std::rotl(acc + input * kPrime2, 31) * kPrime1;
+}
+
+uint64_t merge(uint64_t acc, uint64_t lane) {
+    return (acc ^ mix_round(0, lane)) * kPrime1 + kPrime4;
+}
+
+// ---------------------------------------------------------------------
+// Encoding
+
+constexpr char kMagic[4] = {'M', 'D', 'A', 'C'};
+// 2: literals are stored emoji-normalized.
+constexpr uint8_t kVersion = 2;
+constexpr int kMaxNodeType = static_cast<int>(NodeType::Image);
+
+// Which optional fields follow a node's type byte.
+enum Field : uint8_t {
+    kLevel = 1 << 0,
+    kListStart = 1 << 1,
+    kText = 1 << 2,
+    kUrl = 1 << 3,
+    kInfo = 1 << 4,
+    kSource = 1 << 5,
+};
+
+void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+uint64_t zigzag(int v) {
+    return (static_cast<uint64_t>(v) << 1) ^
+           static_cast<uint64_t>(static_cast<int64_t>(v) >> 63);
+}
+
+int unzigzag(uint64_t v) {
+    return static_cast<int>(static_cast<int64_t>(v >> 1) ^
+                            -static_cast<int64_t>(v & 1));
+}
+
+void put_string(std::string& out, std::string const& s) {
+    put_varint(out, s.size());
+    out += s;
+}
+
+void put_node(std::string& out, ASTNode const& n) {
+    uint8_t fields = 0;
+    if (n.level != 0) fields |= kLevel;
+    if (n.list_start != 1) fields |= kListStart;
+    if (!n.text.empty()) fields |= kText;
+    if (!n.url.empty()) fields |= kUrl;
+    if (!n.info.empty()) fields |= kInfo;
+    if (n.source_begin != 0 || n.source_end != 0) fields |= kSource;
+    out += static_cast<char>(n.type);
+    out += static_cast<char>(fields);
+    if (fields & kLevel) put_varint(out, zigzag(n.level));
+    if (fields & kListStart) put_varint(out, zigzag(n.list_start));
+    if (fields & kText) put_string(out, n.text);
+    if (fields & kUrl) put_string(out, n.url);
+    if (fields & kInfo) put_string(out, n.info);
+    if (fields & kSource) {
+        put_varint(out, n.source_begin);
+        put_varint(out, n.source_end);
+    }
+    put_varint(out, n.children.size());
+}
+
+// Bounds-checked cursor; once a read fails, ok stays false and every
+// later read returns zeros.
+struct Reader {
+    std::string_view bytes;
+    size_t pos = 0;
+    bool ok = true;
+
+    uint8_t byte() {
+        if (pos >= bytes.size()) {
+            ok = false;
+            return 0;
+        }
+        return static_cast<uint8_t>(bytes[pos++]);
+    }
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+    uint64_t fixed64() {
+        if (pos > bytes.size() || bytes.size() - pos < 8) {
+            ok = false;
+            return 0;
+        }
+        auto v = read64(bytes.data() + pos);
+        pos += 8;
+        return v;
+    }
+    void string(std::string& out) {
+        uint64_t n = varint();
+        if (!ok || n > bytes.size() - pos) {
+            ok = false;
+            return;
+        }
+        out.assign(bytes.substr(pos, n));
+        pos += n;
+    }
+};
+
+// Read one node's fields into n.  Returns its child count.
+uint64_t get_node(Reader& r, ASTNode& n) {
+    uint8_t type = r.byte();
+    uint8_t fields = r.byte();
+    if (type > kMaxNodeType) r.ok = false;
+    n.type = static_cast<NodeType>(type);
+    if (fields & kLevel) n.level = unzigzag(r.varint());
+    if (fields & kListStart) n.list_start = unzigzag(r.varint());
+    if (fields & kText) r.string(n.text);
+    if (fields & kUrl) r.string(n.url);
+    if (fields & kInfo) r.string(n.info);
+    if (fields & kSource) {
+        n.source_begin = r.varint();
+        n.source_end = r.varint();
+    }
+    return r.varint();
+}
+
+// ---------------------------------------------------------------------
+// Files
+
+// Read-only memory map of a whole file; empty if it cannot be mapped.
+class MappedFile {
+public:
+    explicit MappedFile(fs::path const& path) {
+#ifdef _WIN32
+        // Shared for deletion too, so store() and erase() can still
+        // replace or remove the entry while it is being read.
+        HANDLE file = ::CreateFileW(
+            path.c_str(), GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER size;
+        if (::GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+            HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY,
+                                                  0, 0, nullptr);
+            if (mapping) {
+                _data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (_data) _size = static_cast<size_t>(size.QuadPart);
+                // The view keeps the mapping alive.
+                ::CloseHandle(mapping);
+            }
+        }
+        ::CloseHandle(file);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size),
+                             PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                _data = p;
+                _size = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+#endif
+    }
+    ~MappedFile() {
+        if (!_data) return;
+#ifdef _WIN32
+        ::UnmapViewOfFile(_data);
+#else
+        ::munmap(_data, _size);
+#endif
+    }
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    std::string_view view() const {
+        return {static_cast<char const*>(_data), _size};
+    }
+
+private:
+    void* _data = nullptr;
+    size_t _size = 0;
+};
+
+constexpr std::string_view kExtension = ".mdast";
+
+bool parse_hash(std::string const& stem, uint64_t& hash) {
+    if (stem.size() != 16) return false;
+    hash = 0;
+    for (char c : stem) {
+        int digit = c >= '0' && c <= '9'   ? c - '0'
+                    : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                                           : -1;
+        if (digit < 0) return false;
+        hash = hash << 4 | static_cast<uint64_t>(digit);
+    }
+    return true;
+}
+
+class CachingParser : public MarkdownParser {
+public:
+    CachingParser(std::unique_ptr<MarkdownParser> parser,
+                  std::shared_ptr<AstCache> cache)
+        : _parser(std::move(parser)), _cache(std::move(cache)) {}
+
+    bool parse(std::string_view input, MarkdownAST& out) override {
+        if (_cache->load(input, out)) return true;
+        bool ok = _parser->parse(input, out);
+        if (ok) _cache->store(input, out);
+        return ok;
+    }
+
+    // Partial results are not stored: they are not what parse() returns.
+    ParseStatus parse(std::string_view input, MarkdownAST& out,
+                      ParseLimits const& limits) override {
+        if (_cache->load(input, out)) return ParseStatus::Complete;
+        auto status = _parser->parse(input, out, limits);
+        if (status == ParseStatus::Complete) _cache->store(input, out);
+        return status;
+    }
+
+private:
+    std::unique_ptr<MarkdownParser> _parser;
+    std::shared_ptr<AstCache> _cache;
+};
+
+} // namespace
+
+uint64_t content_hash(std::string_view text) {
+    char const* p = text.data();
+    char const* end = p + text.size();
+    uint64_t h;
+    if (text.size() >= 32) {
+        uint64_t v1 = kPrime1 + kPrime2;
+        uint64_t v2 = kPrime2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - kPrime1;
+        for (; end - p >= 32; p += 32) {
+            v1 = mix_round(v1, read64(p));
+            v2 = mix_round(v2, read64(p + 8));
+            v3 = mix_round(v3, read64(p + 16));
+            v4 = mix_round(v4, read64(p + 24));
+        }
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) +
+            std::rotl(v4, 18);
+        h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+    } else {
+        h = kPrime5;
+    }
+    h += text.size();
+    for (; end - p >= 8; p += 8) {
+        h ^= mix_round(0, read64(p));
+        h = std::rotl(h, 27) * kPrime1 + kPrime4;
+    }
+    for (; p < end; ++p) {
+        h ^= static_cast<uint8_t>(*p) * kPrime5;
+        h = std::rotl(h, 11) * kPrime1;
+    }
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+void serialize_ast(MarkdownAST const& ast, uint64_t content_hash,
+                   uint64_t content_size, std::string& out) {
+    out.clear();
+    out.append(kMagic, sizeof kMagic);
+    out += static_cast<char>(kVersion);
+    for (int i = 0; i < 8; ++i) {
+        out += static_cast<char>(content_hash >> (8 * i));
+    }
+    put_varint(out, content_size);
+
+    // Preorder, with an explicit stack: deep trees must not overflow.
+    std::vector<ASTNode const*> stack{&ast};
+    while (!stack.empty()) {
+        auto const* node = stack.back();
+        stack.pop_back();
+        put_node(out, *node);
+        for (auto it = node->children.rbegin(); it != node->children.rend();
+             ++it) {
+            stack.push_back(&*it);
+        }
+    }
+}
+
+bool deserialize_ast(std::string_view bytes, uint64_t content_hash,
+                     uint64_t content_size, MarkdownAST& out) {
+    if (bytes.size() < sizeof kMagic + 1 ||
+        bytes.substr(0, sizeof kMagic) !=
+            std::string_view(kMagic, sizeof kMagic) ||
+        static_cast<uint8_t>(bytes[sizeof kMagic]) != kVersion) {
+        return false;
+    }
+    Reader r{bytes, sizeof kMagic + 1};
+    if (r.fixed64() != content_hash || r.varint() != content_size || !r.ok) {
+        return false;
+    }
+
+    // Every node takes at least three bytes, which bounds the child
+    // counts a damaged file can claim before any allocation.
+    auto plausible = [&](uint64_t children) {
+        return r.ok && children <= (bytes.size() - r.pos) / 3;
+    };
+    struct Frame {
+        ASTNode* node;
+        uint64_t remaining;
+    };
+    std::vector<Frame> stack;
+    out = ASTNode{};
+    uint64_t count = get_node(r, out);
+    if (!plausible(count)) return false;
+    out.children.reserve(count);
+    stack.push_back(Frame{&out, count});
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.remaining == 0) {
+            seal_hash(*top.node);
+            stack.pop_back();
+            continue;
+        }
+        --top.remaining;
+        // Reserved to the exact count: never reallocates, so the parent
+        // pointers on the stack stay valid.
+        auto& child = top.node->children.emplace_back();
+        count = get_node(r, child);
+        if (!plausible(count)) return false;
+        if (count > 0) {
+            child.children.reserve(count);
+            stack.push_back(Frame{&child, count});
+        } else {
+            seal_hash(child);
+        }
+    }
+    return r.ok && r.pos == bytes.size();
+}
+
+AstCache::AstCache(fs::path dir, AstCacheLimits limits)
+    : _dir(std::move(dir)), _limits(limits) {
+    std::error_code ec;
+    fs::create_directories(_dir, ec);
+    scan();
+}
+
+void AstCache::rescan() {
+    std::lock_guard lock(_mutex);
+    scan();
+}
+
+void AstCache::scan() {
+    _lru.clear();
+    _index.clear();
+    _bytes = 0;
+
+    // Rebuild the LRU order from the entries' modification times.
+    struct Found {
+        fs::file_time_type time;
+        Entry entry;
+    };
+    std::vector<Found> found;
+    std::error_code ec;
+    for (auto it = fs::directory_iterator(_dir, ec);
+         !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        auto const& path = it->path();
+        uint64_t hash = 0;
+        if (path.extension() != kExtension ||
+            !parse_hash(path.stem().string(), hash)) {
+            continue;
+        }
+        std::error_code entry_ec;
+        auto size = it->file_size(entry_ec);
+        auto time = it->last_write_time(entry_ec);
+        if (entry_ec) continue;
+        found.push_back(Found{time, Entry{hash, size}});
+    }
+    std::sort(found.begin(), found.end(),
+              [](Found const& a, Found const& b) { return a.time > b.time; });
+    for (auto const& f : found) {
+        _lru.push_back(f.entry);
+        _index[f.entry.hash] = std::prev(_lru.end());
+        _bytes += f.entry.size;
+    }
+    evict();
+}
+
+fs::path AstCache::path_for(uint64_t hash) const {
+    static constexpr char kHex[] = "0123456789abcdef";
+    std::string name(16, '0');
+    for (int i = 15; i >= 0; --i, hash >>= 4) name[i] = kHex[hash & 0xF];
+    return _dir / (name + std::string(kExtension));
+}
+
+void AstCache::touch(Lru::iterator it) {
+    _lru.splice(_lru.begin(), _lru, it);
+    std::error_code ec;
+    fs::last_write_time(path_for(it->hash), fs::file_time_type::clock::now(),
+                        ec);
+}
+
+void AstCache::erase(Lru::iterator it) {
+    std::error_code ec;
+    fs::remove(path_for(it->hash), ec);
+    _bytes -= it->size;
+    _index.erase(it->hash);
+    _lru.erase(it);
+}
+
+void AstCache::evict() {
+    while (!_lru.empty() && (_lru.size() > _limits.max_entries ||
+                             _bytes > _limits.max_bytes)) {
+        erase(std::prev(_lru.end()));
+    }
+}
+
+bool AstCache::load(std::string_view text, MarkdownAST& out) {
+    uint64_t hash = content_hash(text);
+    fs::path path;
+    {
+        std::lock_guard lock(_mutex);
+        path = path_for(hash);
+        if (!_index.count(hash)) {
+            // Another process may have stored it since the last scan.
+            std::error_code ec;
+            auto size = fs::file_size(path, ec);
+            if (ec) {
+                ++_misses;
+                return false;
+            }
+            _lru.push_front(Entry{hash, size});
+            _index[hash] = _lru.begin();
+            _bytes += size;
+            evict();
+        }
+    }
+
+    // Decode outside the lock; the file is only ever replaced by rename,
+    // so the mapping sees one complete version.
+    MappedFile file(path);
+    bool ok = deserialize_ast(file.view(), hash, text.size(), out);
+
+    std::lock_guard lock(_mutex);
+    auto it = _index.find(hash);
+    if (ok) {
+        ++_hits;
+        if (it != _index.end()) touch(it->second);
+        return true;
+    }
+    // Damaged, or another text with the same hash: drop the entry.
+    ++_misses;
+    if (it != _index.end()) erase(it->second);
+    out = ASTNode{};
+    return false;
+}
+
+void AstCache::store(std::string_view text, MarkdownAST const& ast) {
+    uint64_t hash = content_hash(text);
+    std::string bytes;
+    serialize_ast(ast, hash, text.size(), bytes);
+    if (bytes.size() > _limits.max_bytes) return;
+
+    // Write under a unique name, then rename over the entry, so readers
+    // never map a half-written file.
+    static std::atomic<uint64_t> counter{0};
+    auto path = path_for(hash);
+    auto tmp = path;
+    tmp += ".tmp" + std::to_string(counter.fetch_add(1));
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!f) {
+            std::error_code ec;
+            fs::remove(tmp, ec);
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return;
+    }
+
+    std::lock_guard lock(_mutex);
+    auto it = _index.find(hash);
+    if (it != _index.end()) {
+        _bytes = _bytes - it->second->size + bytes.size();
+        it->second->size = bytes.size();
+        _lru.splice(_lru.begin(), _lru, it->second);
+    } else {
+        _lru.push_front(Entry{hash, bytes.size()});
+        _index[hash] = _lru.begin();
+        _bytes += bytes.size();
+    }
+    evict();
+}
+
+void AstCache::clear() {
+    std::lock_guard lock(_mutex);
+    while (!_lru.empty()) erase(_lru.begin());
+}
+
+size_t AstCache::entries() const {
+    std::lock_guard lock(_mutex);
+    return _lru.size();
+}
+
+uint64_t AstCache::bytes() const {
+    std::lock_guard lock(_mutex);
+    return _bytes;
+}
+
+uint64_t AstCache::hits() const {
+    std::lock_guard lock(_mutex);
+    return _hits;
+}
+
+uint64_t AstCache::misses() const {
+    std::lock_guard lock(_mutex);
+    return _misses;
+}
+
+std::unique_ptr<MarkdownParser> make_caching_parser(
+    std::unique_ptr<MarkdownParser> parser, std::shared_ptr<AstCache> cache) {
+    return std::make_unique<CachingParser>(std::move(parser),
+                                           std::move(cache));
+}
+
+} // namespace markdown
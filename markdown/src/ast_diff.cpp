@@ -0,0 +1,114 @@
+#include "markdown/ast_diff.hpp"
+#include "markdown/ast_cache.hpp"
+
+#include <bit>
+
+namespace markdown {
+namespace {
+
+constexpr uint64_t kMul = 0x9E3779B185EBCA87ULL;
+
+uint64_t mix(uint64_t h, uint64_t v) {
+    return std::rotl((h ^ v) * kMul, 29) + 0x165667B19E3779F9ULL;
+}
+
+uint64_t mix_string(uint64_t h, std::string const& s) {
+    return mix(h, s.empty() ? 0 : content_hash(s));
+}
+
+// The node's own fields.  The child count is mixed in up front, so the
+// child hashes that follow fix the shape.
+uint64_t own_hash(ASTNode const& n) {
+    uint64_t h = mix(0, static_cast<uint64_t>(n.type) |
+                            static_cast<uint64_t>(n.level) << 8 |
+                            static_cast<uint64_t>(n.children.size()) << 16);
+    h = mix(h, static_cast<uint64_t>(static_cast<int64_t>(n.list_start)));
+    h = mix_string(h, n.text);
+    h = mix_string(h, n.url);
+    return mix_string(h, n.info);
+}
+
+// 0 is reserved for "not computed".
+uint64_t finish(uint64_t h) { return h != 0 ? h : 1; }
+
+} // namespace
+
+uint64_t node_hash(ASTNode const& node) {
+    uint64_t h = own_hash(node);
+    for (auto const& child : node.children) h = mix(h, child.hash);
+    return finish(h);
+}
+
+// Postorder with an explicit stack: nesting depth costs heap only.
+void hash_tree(ASTNode& root) {
+    struct Frame {
+        ASTNode* node;
+        size_t next;
+    };
+    std::vector<Frame> stack{{&root, 0}};
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.next < top.node->children.size()) {
+            auto* child = &top.node->children[top.next++];
+            stack.push_back({child, 0});
+            continue;
+        }
+        seal_hash(*top.node);
+        stack.pop_back();
+    }
+}
+
+// Like hash_tree(), but read-only: partial hashes live on the stack, and
+// subtrees that already carry a hash are not entered.
+uint64_t subtree_hash(ASTNode const& node) {
+    if (node.hash != 0) return node.hash;
+    struct Frame {
+        ASTNode const* node;
+        size_t next;
+        uint64_t h;
+    };
+    std::vector<Frame> stack{{&node, 0, own_hash(node)}};
+    for (;;) {
+        auto& top = stack.back();
+        if (top.next < top.node->children.size()) {
+            auto const& child = top.node->children[top.next++];
+            if (child.hash != 0) {
+                top.h = mix(top.h, child.hash);
+            } else {
+                stack.push_back({&child, 0, own_hash(child)});
+            }
+            continue;
+        }
+        uint64_t done = finish(top.h);
+        stack.pop_back();
+        if (stack.empty()) return done;
+        stack.back().h = mix(stack.back().h, done);
+    }
+}
+
+std::vector<uint64_t> block_hashes(MarkdownAST const& ast) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(ast.children.size());
+    for (auto const& block : ast.children) {
+        hashes.push_back(subtree_hash(block));
+    }
+    return hashes;
+}
+
+AstDiff diff_blocks(std::span<uint64_t const> before,
+                    std::span<uint64_t const> after) {
+    AstDiff diff{.old_count = before.size(), .new_count = after.size()};
+    size_t limit = std::min(before.size(), after.size());
+    while (diff.prefix < limit &&
+           before[diff.prefix] == after[diff.prefix]) {
+        ++diff.prefix;
+    }
+    while (diff.suffix < limit - diff.prefix &&
+           before[before.size() - 1 - diff.suffix] ==
+               after[after.size() - 1 - diff.suffix]) {
+        ++diff.suffix;
+    }
+    return diff;
+}
+
+} // namespace markdown
@@ -0,0 +1,150 @@
+#include "markdown/doc_index.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace markdown {
+namespace {
+
+// Heading text as it reads: literals, breaks as spaces.
+std::string plain_text(ASTNode const& heading) {
+    std::string result;
+    std::vector<ASTNode const*> stack{&heading};
+    while (!stack.empty()) {
+        auto* n = stack.back();
+        stack.pop_back();
+        if (n->type == NodeType::SoftBreak || n->type == NodeType::HardBreak) {
+            result += ' ';
+        } else {
+            result += n->text;
+        }
+        for (auto it = n->children.rbegin(); it != n->children.rend(); ++it) {
+            stack.push_back(&*it);
+        }
+    }
+    return result;
+}
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// cmark percent-encodes non-ASCII bytes in urls; slugs keep them raw.
+std::string percent_decode(std::string_view s) {
+    std::string result;
+    result.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '%' && i + 2 < s.size()) {
+            int hi = hex_digit(s[i + 1]);
+            int lo = hex_digit(s[i + 2]);
+            if (hi >= 0 && lo >= 0) {
+                result += static_cast<char>(hi << 4 | lo);
+                i += 2;
+                continue;
+            }
+        }
+        result += s[i];
+    }
+    return result;
+}
+
+} // namespace
+
+std::string heading_slug(std::string_view text) {
+    std::string slug;
+    slug.reserve(text.size());
+    for (char c : text) {
+        auto b = static_cast<unsigned char>(c);
+        if (b >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+            c == '-' || c == '_') {
+            slug += c;
+        } else if (c >= 'A' && c <= 'Z') {
+            slug += static_cast<char>(c - 'A' + 'a');
+        } else if (c == ' ') {
+            slug += '-';
+        }
+    }
+    return slug;
+}
+
+void DocumentIndex::clear() {
+    _headings.clear();
+    _links.clear();
+    _slugs.clear();
+    _first_heading.assign(1, 0);
+}
+
+// One preorder walk per top-level block, which meets links in the order
+// DomBuilder registers them.
+void DocumentIndex::build(MarkdownAST const& ast) {
+    clear();
+    auto const& blocks = ast.children;
+    _first_heading.assign(blocks.size() + 1, 0);
+    std::vector<ASTNode const*> stack;
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        _first_heading[b] = _headings.size();
+        stack.assign(1, &blocks[b]);
+        while (!stack.empty()) {
+            auto* n = stack.back();
+            stack.pop_back();
+            if (n->type == NodeType::Heading) {
+                _headings.push_back(HeadingEntry{
+                    .level = n->level,
+                    .text = plain_text(*n),
+                    .block = b,
+                    .source_begin = n->source_begin,
+                });
+            } else if (n->type == NodeType::Link) {
+                _links.push_back(LinkEntry{.url = n->url, .block = b});
+            }
+            for (auto it = n->children.rbegin(); it != n->children.rend();
+                 ++it) {
+                stack.push_back(&*it);
+            }
+        }
+    }
+    _first_heading[blocks.size()] = _headings.size();
+
+    // Repeated slugs get "-1", "-2", ... in document order, skipping any
+    // that an earlier heading already took.
+    _slugs.reserve(_headings.size());
+    std::unordered_map<std::string, size_t> repeats;
+    for (size_t i = 0; i < _headings.size(); ++i) {
+        auto base = heading_slug(_headings[i].text);
+        auto slug = base;
+        if (_slugs.contains(slug)) {
+            auto& n = repeats[base];
+            do {
+                slug = base + "-" + std::to_string(++n);
+            } while (_slugs.contains(slug));
+        }
+        _slugs.emplace(slug, i);
+        _headings[i].slug = std::move(slug);
+    }
+}
+
+int DocumentIndex::find_slug(std::string_view slug) const {
+    auto it = _slugs.find(std::string(slug));
+    return it == _slugs.end() ? -1 : static_cast<int>(it->second);
+}
+
+int DocumentIndex::resolve_fragment(std::string_view url) const {
+    if (url.size() < 2 || url[0] != '#') return -1;
+    return find_slug(percent_decode(url.substr(1)));
+}
+
+int DocumentIndex::heading_after(size_t block) const {
+    if (block + 1 >= _first_heading.size()) return -1;
+    size_t h = _first_heading[block + 1];
+    return h < _headings.size() ? static_cast<int>(h) : -1;
+}
+
+int DocumentIndex::heading_before(size_t block) const {
+    size_t h = _first_heading[std::min(block, _first_heading.size() - 1)];
+    return static_cast<int>(h) - 1;
+}
+
+} // namespace markdown
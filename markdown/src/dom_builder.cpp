@@ -1,9 +1,24 @@
 #include "markdown/dom_builder.hpp"
-#include "markdown/text_utils.hpp"
+#include "markdown/ast_diff.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <numeric>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <ftxui/dom/flexbox_config.hpp>
+#include <ftxui/dom/node.hpp>
+#include <ftxui/dom/selection.hpp>
+#include <ftxui/screen/string.hpp>
 
 namespace markdown {
 namespace {
@@ -12,79 +27,523 @@ constexpr int kMaxDepth = 40;
 
 using Links = std::vector<LinkTarget>;
 
+// Uniform read access to the tree and flat AST representations, so one
+// set of templated build functions serves both.
+NodeType type_of(ASTNode const& n) { return n.type; }
+NodeType type_of(FlatNodeRef n) { return n.type(); }
+std::string_view text_of(ASTNode const& n) { return n.text; }
+std::string_view text_of(FlatNodeRef n) { return n.text(); }
+std::string_view url_of(ASTNode const& n) { return n.url; }
+std::string_view url_of(FlatNodeRef n) { return n.url(); }
+std::string_view info_of(ASTNode const& n) { return n.info; }
+std::string_view info_of(FlatNodeRef n) { return n.info(); }
+int level_of(ASTNode const& n) { return n.level; }
+int level_of(FlatNodeRef n) { return n.level(); }
+int list_start_of(ASTNode const& n) { return n.list_start; }
+int list_start_of(FlatNodeRef n) { return n.list_start(); }
+std::vector<ASTNode> const& children_of(ASTNode const& n) {
+    return n.children;
+}
+FlatNodeRef::Children children_of(FlatNodeRef n) { return n.children(); }
+size_t source_begin_of(ASTNode const& n) { return n.source_begin; }
+size_t source_begin_of(FlatNodeRef n) { return n.node().source_begin; }
+size_t source_end_of(ASTNode const& n) { return n.source_end; }
+size_t source_end_of(FlatNodeRef n) { return n.node().source_end; }
+
+// Build-scoped node memory.  Nodes are bump-allocated from a monotonic
+// pool; each node's control block holds the pool, so its chunks are freed
+// in one go with the last node, whichever build or memo slot that node
+// ended up in.
+using NodePool = std::pmr::monotonic_buffer_resource;
+
+// First chunk size: nodes take about this much per source byte.
+constexpr size_t kPoolBytesPerSource = 32;
+constexpr size_t kPoolMinChunk = size_t{4} << 10;
+constexpr size_t kPoolMaxChunk = size_t{1} << 20;
+
+std::shared_ptr<NodePool> make_pool(size_t source_bytes) {
+    return std::make_shared<NodePool>(std::clamp(
+        source_bytes * kPoolBytesPerSource, kPoolMinChunk, kPoolMaxChunk));
+}
+
+template <class T>
+struct PoolAllocator {
+    using value_type = T;
+
+    explicit PoolAllocator(std::shared_ptr<NodePool> p) : pool(std::move(p)) {}
+    template <class U>
+    PoolAllocator(PoolAllocator<U> const& other) : pool(other.pool) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(pool->allocate(n * sizeof(T), alignof(T)));
+    }
+    // A no-op for a monotonic pool, so any thread may free nodes.
+    void deallocate(T* p, size_t n) {
+        pool->deallocate(p, n * sizeof(T), alignof(T));
+    }
+    template <class U>
+    bool operator==(PoolAllocator<U> const& other) const {
+        return pool == other.pool;
+    }
+
+    std::shared_ptr<NodePool> pool;
+};
+
+// The pool of the build running on this thread; null outside a build or
+// with pooling off.  Worker threads of a parallel build have their own.
+thread_local std::shared_ptr<NodePool> const* t_pool = nullptr;
+
+class PoolScope {
+public:
+    explicit PoolScope(std::shared_ptr<NodePool> pool)
+        : _pool(std::move(pool)), _outer(t_pool) {
+        t_pool = _pool ? &_pool : nullptr;
+    }
+    ~PoolScope() { t_pool = _outer; }
+    PoolScope(PoolScope const&) = delete;
+    PoolScope& operator=(PoolScope const&) = delete;
+
+private:
+    std::shared_ptr<NodePool> _pool;
+    std::shared_ptr<NodePool> const* _outer;
+};
+
+template <class T, class... Args>
+std::shared_ptr<T> make_node(Args&&... args) {
+    if (!t_pool) return std::make_shared<T>(std::forward<Args>(args)...);
+    return std::allocate_shared<T>(PoolAllocator<T>(*t_pool),
+                                   std::forward<Args>(args)...);
+}
+
+std::string_view pool_copy(std::string_view text) {
+    auto* out = static_cast<char*>((*t_pool)->allocate(text.size(), 1));
+    std::copy(text.begin(), text.end(), out);
+    return {out, text.size()};
+}
+
+struct WordStyle {
+    bool bold = false;
+    bool italic = false;
+};
+
+// ftxui::text(), optionally with ftxui::bold and ftxui::italic around it,
+// as one node whose text sits in the pool next to it.  Draws, measures
+// and selects exactly as those nodes do.
+class Word : public ftxui::Node {
+public:
+    Word(std::string_view text, WordStyle style)
+        : _text(text), _style(style) {}
+
+    void ComputeRequirement() override {
+        measure();
+        requirement_.min_x = _width;
+        requirement_.min_y = 1;
+        _selected = false;
+    }
+
+    void Select(ftxui::Selection& selection) override {
+        if (ftxui::Box::Intersection(selection.GetBox(), box_).IsEmpty()) {
+            return;
+        }
+        auto saturated = selection.SaturateHorizontal(box_);
+        _selected = true;
+        _selection_begin = saturated.GetBox().x_min;
+        _selection_end = saturated.GetBox().x_max;
+        measure();
+        std::string part;
+        int x = box_.x_min;
+        for (size_t i = 0; i < glyph_count(); ++i) {
+            auto cell = glyph(i);
+            if (cell == "\n") continue;
+            if (_selection_begin <= x && x <= _selection_end) part += cell;
+            ++x;
+        }
+        selection.AddPart(part, box_.y_min, _selection_begin, _selection_end);
+    }
+
+    void Render(ftxui::Screen& screen) override {
+        if (_style.bold || _style.italic) {
+            auto area = ftxui::Box::Intersection(box_, screen.stencil);
+            for (int y = area.y_min; y <= area.y_max; ++y) {
+                for (int x = area.x_min; x <= area.x_max; ++x) {
+                    auto& pixel = screen.PixelAt(x, y);
+                    if (_style.bold) pixel.bold = true;
+                    if (_style.italic) pixel.italic = true;
+                }
+            }
+        }
+        measure();
+        int x = box_.x_min;
+        int y = box_.y_min;
+        if (y > box_.y_max) return;
+        for (size_t i = 0; i < glyph_count(); ++i) {
+            if (x > box_.x_max) return;
+            auto cell = glyph(i);
+            if (cell == "\n") continue;
+            auto& pixel = screen.PixelAt(x, y);
+            pixel.character = cell;
+            if (_selected && _selection_begin <= x && x <= _selection_end) {
+                screen.GetSelectionStyle()(pixel);
+            }
+            ++x;
+        }
+    }
+
+private:
+    // Printable ASCII is one glyph per byte, read straight from _text.
+    // Other text is split into glyphs by ftxui once, on first use.
+    void measure() {
+        if (_width >= 0) return;
+        _ascii = std::all_of(_text.begin(), _text.end(),
+                             [](char c) { return c >= 0x20 && c < 0x7f; });
+        if (_ascii) {
+            _width = static_cast<int>(_text.size());
+            return;
+        }
+        std::string text(_text);
+        _glyphs = ftxui::Utf8ToGlyphs(text);
+        _width = ftxui::string_width(text);
+    }
+    size_t glyph_count() const {
+        return _ascii ? _text.size() : _glyphs.size();
+    }
+    std::string_view glyph(size_t i) const {
+        return _ascii ? _text.substr(i, 1) : std::string_view(_glyphs[i]);
+    }
+
+    std::string_view _text;  // in the node's pool
+    WordStyle _style;
+    int _width = -1;
+    bool _ascii = false;
+    std::vector<std::string> _glyphs;  // unless _ascii
+    bool _selected = false;
+    int _selection_begin = 0;
+    int _selection_end = 0;
+};
+
+// A leaf of text: a Word inside a pool, ftxui's own nodes outside one.
+ftxui::Element word(std::string_view text, WordStyle style = {}) {
+    if (!t_pool) {
+        auto element = ftxui::text(std::string(text));
+        if (style.bold) element = element | ftxui::bold;
+        if (style.italic) element = element | ftxui::italic;
+        return element;
+    }
+    return make_node<Word>(pool_copy(text), style);
+}
+
+ftxui::Element styled(ftxui::Element element, WordStyle style) {
+    if (style.bold) element = element | ftxui::bold;
+    if (style.italic) element = element | ftxui::italic;
+    return element;
+}
+
+// ftxui::paragraph(): a flexbox row per line, of the pieces between
+// spaces laid out a column apart.  Pieces are Words inside a pool.
+ftxui::Element make_paragraph(std::string_view text) {
+    if (!t_pool) return ftxui::paragraph(std::string(text));
+    static const auto config = ftxui::FlexboxConfig().SetGap(1, 0);
+    ftxui::Elements lines;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        auto line = text.substr(begin, text.find('\n', begin) - begin);
+        ftxui::Elements words;
+        words.reserve(std::count(line.begin(), line.end(), ' ') + 1);
+        size_t pos = 0;
+        while (pos < line.size()) {
+            size_t end = std::min(line.find(' ', pos), line.size());
+            words.push_back(make_node<Word>(
+                pool_copy(line.substr(pos, end - pos)), WordStyle{}));
+            pos = end + 1;
+        }
+        lines.push_back(ftxui::flexbox(std::move(words), config));
+        begin += line.size() + 1;
+    }
+    return ftxui::vbox(std::move(lines));
+}
+
+// Records the box its child is laid out in.  ftxui::reflect() clips that
+// box to the visible area when rendering, which loses the position of
+// blocks scrolled out of view.
+//
+// It also keeps the child's layout from frame to frame.  Once a layout
+// pass settles at some width, the child's requirement is reused until the
+// width or the block's layout epoch changes.  A block that only moved,
+// as when scrolling, is laid out again only if it gets rendered; one out
+// of view is skipped, and its link boxes are moved by the offset and
+// clipped as reflect() would clip them.
+class BlockBox : public ftxui::Node {
+public:
+    BlockBox(ftxui::Element child, ftxui::Box* box, LinkTarget* links,
+             size_t link_count, uint64_t const* epoch)
+        : Node({std::move(child)}), _box(box), _links(links),
+          _link_count(link_count), _epoch(epoch) {}
+
+    void ComputeRequirement() override {
+        if (settled()) {
+            requirement_ = _settled;
+            return;
+        }
+        children_[0]->ComputeRequirement();
+        requirement_ = children_[0]->requirement();
+    }
+
+    void SetBox(ftxui::Box box) override {
+        Node::SetBox(box);
+        *_box = box;
+        _moved = settled() && same_size(box, _laid);
+        if (!_moved) lay_out();
+    }
+
+    void Check(Status* status) override {
+        if (_moved) return;
+        Status own = *status;
+        own.need_iteration = false;
+        children_[0]->Check(&own);
+        if (own.need_iteration) {
+            status->need_iteration = true;
+            _width = -1;
+        } else {
+            // The requirement this pass used holds at this width.
+            _settled = requirement_;
+            _width = _laid.x_max - _laid.x_min;
+            _seen = *_epoch;
+        }
+    }
+
+    void Render(ftxui::Screen& screen) override {
+        auto visible = ftxui::Box::Intersection(box_, screen.stencil);
+        if (_moved && visible.y_max < visible.y_min) {
+            int dy = box_.y_min - _laid.y_min;
+            for (size_t i = 0; i < _link_count; ++i) {
+                auto& boxes = _links[i].boxes;
+                for (size_t k = 0; k < boxes.size(); ++k) {
+                    auto moved = _laid_links[i][k];
+                    moved.y_min += dy;
+                    moved.y_max += dy;
+                    boxes[k] = ftxui::Box::Intersection(moved, screen.stencil);
+                }
+            }
+            return;
+        }
+        if (_moved) {
+            lay_out();
+            _moved = false;
+        }
+        children_[0]->Render(screen);
+    }
+
+private:
+    static bool same_size(ftxui::Box a, ftxui::Box b) {
+        return a.x_max - a.x_min == b.x_max - b.x_min &&
+               a.y_max - a.y_min == b.y_max - b.y_min;
+    }
+
+    bool settled() const {
+        return _width >= 0 && *_epoch == _seen &&
+               _width == box_.x_max - box_.x_min;
+    }
+
+    void lay_out() {
+        children_[0]->SetBox(box_);
+        _laid = box_;
+        // reflect() has just written the unclipped boxes.
+        _laid_links.resize(_link_count);
+        for (size_t i = 0; i < _link_count; ++i) {
+            _laid_links[i] = _links[i].boxes;
+        }
+    }
+
+    ftxui::Box* _box;
+    LinkTarget* _links;
+    size_t _link_count;
+    uint64_t const* _epoch;
+    uint64_t _seen = 0;
+    int _width = -1;             // x extent of the settled layout, -1 if none
+    ftxui::Requirement _settled;
+    ftxui::Box _laid;            // where the child was last laid out
+    std::vector<std::vector<ftxui::Box>> _laid_links;
+    bool _moved = false;         // box_ differs from _laid by an offset
+};
+
+// A run of sibling nodes, e.g. the children between two HardBreaks.
+template <class It>
+struct Span {
+    It first;
+    It last;
+    It begin() const { return first; }
+    It end() const { return last; }
+};
+
+void append_node_text(std::string& out, NodeType type, std::string_view text) {
+    out += text;
+    if (type == NodeType::SoftBreak) out += ' ';
+    if (type == NodeType::HardBreak) out += '\n';
+}
+
 // Iteratively collect all text from a subtree (no recursion — safe at any
 // depth).  Used as the plain-text fallback when nesting exceeds kMaxDepth.
-std::string collect_text(ASTNode const& root) {
+std::string collect_raw_text(ASTNode const& root) {
     std::string result;
     std::vector<ASTNode const*> stack{&root};
     while (!stack.empty()) {
         auto* n = stack.back();
         stack.pop_back();
-        if (!n->text.empty()) result += n->text;
-        if (n->type == NodeType::SoftBreak) result += ' ';
-        if (n->type == NodeType::HardBreak) result += '\n';
+        append_node_text(result, n->type, n->text);
         // Push children in reverse so leftmost is processed first.
         for (auto it = n->children.rbegin(); it != n->children.rend(); ++it) {
             stack.push_back(&*it);
         }
     }
-    return normalize_emoji_width(result);
+    return result;
+}
+
+// Flat subtrees are one contiguous preorder run: no stack needed.
+std::string collect_raw_text(FlatNodeRef root) {
+    std::string result;
+    uint32_t end = root.index() + root.node().subtree_size;
+    for (uint32_t i = root.index(); i < end; ++i) {
+        FlatNodeRef n{&root.ast(), i};
+        append_node_text(result, n.type(), n.text());
+    }
+    return result;
 }
 
-// Returns true if the next link to be inserted matches focused_link.
-bool is_next_link_focused(Links const& links, int focused_link) {
-    return static_cast<int>(links.size()) == focused_link;
+template <class Range>
+std::string collect_text_of_range(Range const& nodes) {
+    std::string result;
+    for (auto const& n : nodes) result += collect_raw_text(n);
+    return result;
 }
 
-// Compute the decorator for a link based on whether it is focused.
-ftxui::Decorator link_style(bool is_focused, ftxui::Decorator base,
-                            Theme const& theme) {
-    if (is_focused) return base | ftxui::underlined | ftxui::inverted;
-    return base | ftxui::underlined | theme.link;
+// Links in a subtree shown as plain text keep a target without boxes, so
+// link numbers stay those of collect_links() and DocumentIndex.
+void register_plain_links(ASTNode const& root, Links& links) {
+    std::vector<ASTNode const*> stack{&root};
+    while (!stack.empty()) {
+        auto* n = stack.back();
+        stack.pop_back();
+        if (n->type == NodeType::Link) {
+            links.push_back(LinkTarget{
+                .url = n->url,
+                .focused = make_node<bool>(false),
+            });
+        }
+        for (auto it = n->children.rbegin(); it != n->children.rend(); ++it) {
+            stack.push_back(&*it);
+        }
+    }
 }
 
-// Register a link: create a LinkTarget, wrap each element in elems[from..]
-// with reflect for click detection, and apply focus to the first element.
+void register_plain_links(FlatNodeRef root, Links& links) {
+    uint32_t end = root.index() + root.node().subtree_size;
+    for (uint32_t i = root.index(); i < end; ++i) {
+        FlatNodeRef n{&root.ast(), i};
+        if (n.type() != NodeType::Link) continue;
+        links.push_back(LinkTarget{
+            .url = std::string(n.url()),
+            .focused = make_node<bool>(false),
+        });
+    }
+}
+
+// Lays out one of two prebuilt looks of a link element, chosen by the
+// link's focus flag each time the tree is laid out.  Moving the focus
+// flips two flags instead of rebuilding the tree.
+//
+// It also does what ftxui::underlined, ftxui::inverted and ftxui::reflect()
+// would do around the looks: underlines the link, inverts it while
+// focused, and writes its box for click detection.
+class LinkFocus : public ftxui::Node {
+public:
+    LinkFocus(ftxui::Element plain, ftxui::Element focused,
+              std::shared_ptr<bool const> is_focused, ftxui::Box* box)
+        : Node({std::move(plain), std::move(focused)}),
+          _is_focused(std::move(is_focused)), _box(box) {}
+
+    void ComputeRequirement() override {
+        active()->ComputeRequirement();
+        requirement_ = active()->requirement();
+    }
+
+    void SetBox(ftxui::Box box) override {
+        Node::SetBox(box);
+        *_box = box;
+        active()->SetBox(box);
+    }
+
+    void Select(ftxui::Selection& selection) override {
+        active()->Select(selection);
+    }
+
+    void Check(Status* status) override { active()->Check(status); }
+
+    void Render(ftxui::Screen& screen) override {
+        *_box = ftxui::Box::Intersection(box_, screen.stencil);
+        bool focused = *_is_focused;
+        for (int y = _box->y_min; y <= _box->y_max; ++y) {
+            for (int x = _box->x_min; x <= _box->x_max; ++x) {
+                auto& pixel = screen.PixelAt(x, y);
+                pixel.underlined = true;
+                if (focused) pixel.inverted = true;
+            }
+        }
+        active()->Render(screen);
+    }
+
+private:
+    ftxui::Element const& active() const {
+        return children_[*_is_focused ? 1 : 0];
+    }
+
+    std::shared_ptr<bool const> _is_focused;
+    ftxui::Box* _box;
+};
+
+// Register a link: create a LinkTarget and give each element in
+// elems[from..] its unfocused and focused look.  Only the first element
+// takes ftxui::focus.
 void register_link(Links& links, ftxui::Elements& elems, size_t from,
-                   std::string const& url, bool is_focused) {
-    links.emplace_back(LinkTarget{.url = url});
+                   std::string_view url, Theme const& theme) {
+    links.emplace_back(LinkTarget{
+        .url = std::string(url),
+        .focused = make_node<bool>(false),
+    });
     auto& target = links.back();
-    size_t count = elems.size() - from;
-    target.boxes.resize(count);
+    target.boxes.resize(elems.size() - from);
     for (size_t i = from; i < elems.size(); ++i) {
-        elems[i] = elems[i] | ftxui::reflect(target.boxes[i - from]);
-    }
-    if (is_focused && count > 0) {
-        elems[from] = elems[from] | ftxui::focus;
+        auto focused = i == from ? elems[i] | ftxui::focus : elems[i];
+        elems[i] = make_node<LinkFocus>(elems[i] | theme.link,
+                                        std::move(focused), target.focused,
+                                        &target.boxes[i - from]);
     }
 }
 
-ftxui::Element build_node(ASTNode const& node, int depth, int qd, int mqd,
-                          Links& links, int focused_link,
-                          Theme const& theme);
+template <class Node>
+ftxui::Element build_node(Node const& node, int depth, int qd, int mqd,
+                          Links& links, Theme const& theme);
 
-ftxui::Elements build_children(ASTNode const& node, int depth, int qd,
-                               int mqd, Links& links, int focused_link,
-                               Theme const& theme) {
+template <class Node>
+ftxui::Elements build_children(Node const& node, int depth, int qd,
+                               int mqd, Links& links, Theme const& theme) {
     ftxui::Elements result;
-    for (auto const& child : node.children) {
-        result.push_back(build_node(child, depth, qd, mqd, links,
-                                    focused_link, theme));
+    for (auto const& child : children_of(node)) {
+        result.push_back(build_node(child, depth, qd, mqd, links, theme));
     }
     return result;
 }
 
 // Collect inline children into a single hbox (for paragraphs, etc.)
-ftxui::Element build_inline_container(ASTNode const& node, int depth, int qd,
-                                      int mqd, Links& links, int focused_link,
+template <class Node>
+ftxui::Element build_inline_container(Node const& node, int depth, int qd,
+                                      int mqd, Links& links,
                                       Theme const& theme) {
     ftxui::Elements parts;
-    for (auto const& child : node.children) {
-        parts.push_back(build_node(child, depth, qd, mqd, links,
-                                   focused_link, theme));
+    for (auto const& child : children_of(node)) {
+        parts.push_back(build_node(child, depth, qd, mqd, links, theme));
     }
     if (parts.empty()) {
-        return ftxui::text("");
+        return word("");
     }
     if (parts.size() == 1) {
         return std::move(parts[0]);
@@ -92,23 +551,24 @@ ftxui::Element build_inline_container(ASTNode const& node, int depth, int qd,
     return ftxui::hbox(std::move(parts));
 }
 
-// Recursively collect words from inline AST nodes, preserving decorators.
-// Each word becomes a separate flexbox item so wrapping works at word
-// boundaries even inside bold/italic/link runs.
-void collect_inline_words(ASTNode const& node, int depth, int qd, int mqd,
-                          ftxui::Elements& words,
-                          ftxui::Decorator style,
-                          Links& links, int focused_link,
-                          Theme const& theme) {
+// Recursively collect words from a run of inline AST nodes, preserving
+// decorators.  Each word becomes a separate flexbox item so wrapping works
+// at word boundaries even inside bold/italic/link runs.
+template <class Range>
+void collect_inline_words(Range const& nodes, int depth, int qd, int mqd,
+                          ftxui::Elements& words, WordStyle style,
+                          Links& links, Theme const& theme) {
     if (depth > kMaxDepth) {
-        auto text = collect_text(node);
-        if (!text.empty()) words.push_back(ftxui::text(text) | style);
+        auto text = collect_text_of_range(nodes);
+        if (!text.empty()) words.push_back(word(text, style));
+        for (auto const& n : nodes) register_plain_links(n, links);
         return;
     }
-    for (auto const& child : node.children) {
-        switch (child.type) {
+    for (auto const& child : nodes) {
+        switch (type_of(child)) {
         case NodeType::Text: {
-            auto t = normalize_emoji_width(child.text);
+            // Literals are emoji-normalized (ASTNode::text contract).
+            auto t = text_of(child);
             size_t pos = 0;
             while (pos < t.size()) {
                 size_t space_start = pos;
@@ -116,62 +576,88 @@ void collect_inline_words(ASTNode const& node, int depth, int qd, int mqd,
                 if (pos >= t.size()) {
                     // Trailing spaces: emit separator for next sibling.
                     if (space_start < pos && !words.empty()) {
-                        words.push_back(ftxui::text(" ") | style);
+                        words.push_back(word(" ", style));
                     }
                     break;
                 }
                 auto end = t.find(' ', pos);
-                if (end == std::string::npos) end = t.size();
-                std::string word;
-                bool needs_space = (space_start < pos);
-                word.reserve((end - pos) + (needs_space ? 1 : 0));
-                if (needs_space) word += ' ';
-                word.append(t.data() + pos, end - pos);
-                words.push_back(ftxui::text(std::move(word)) | style);
+                if (end == std::string_view::npos) end = t.size();
+                // Keep one of the spaces before the word.
+                if (space_start < pos) --pos;
+                words.push_back(word(t.substr(pos, end - pos), style));
                 pos = end;
             }
             break;
         }
         case NodeType::SoftBreak:
-            words.push_back(ftxui::text(" ") | style);
+            words.push_back(word(" ", style));
             break;
         case NodeType::HardBreak:
             break; // handled by build_wrapping_container
-        case NodeType::Strong:
-            collect_inline_words(child, depth + 1, qd, mqd, words,
-                                 style | ftxui::bold, links, focused_link,
-                                 theme);
+        case NodeType::Strong: {
+            auto bold = style;
+            bold.bold = true;
+            collect_inline_words(children_of(child), depth + 1, qd, mqd, words,
+                                 bold, links, theme);
             break;
-        case NodeType::Emphasis:
-            collect_inline_words(child, depth + 1, qd, mqd, words,
-                                 style | ftxui::italic, links, focused_link,
-                                 theme);
+        }
+        case NodeType::Emphasis: {
+            auto italic = style;
+            italic.italic = true;
+            collect_inline_words(children_of(child), depth + 1, qd, mqd, words,
+                                 italic, links, theme);
             break;
+        }
         case NodeType::Link: {
-            bool is_focused = is_next_link_focused(links, focused_link);
-            auto ls = link_style(is_focused, style, theme);
             size_t before = words.size();
-            collect_inline_words(child, depth + 1, qd, mqd, words,
-                                 ls, links, focused_link, theme);
-            register_link(links, words, before, child.url, is_focused);
+            collect_inline_words(children_of(child), depth + 1, qd, mqd,
+                                 words, style, links, theme);
+            register_link(links, words, before, url_of(child), theme);
             break;
         }
         case NodeType::CodeInline:
-            words.push_back(ftxui::text(normalize_emoji_width(child.text))
-                            | theme.code_inline | style);
+            words.push_back(
+                styled(word(text_of(child)) | theme.code_inline, style));
+            break;
+        default:
+            words.push_back(styled(
+                build_node(child, depth, qd, mqd, links, theme), style));
+            break;
+        }
+    }
+}
+
+// Upper bound on the words collect_inline_words() makes of nodes.
+template <class Range>
+size_t count_inline_words(Range const& nodes, int depth) {
+    if (depth > kMaxDepth) return 1;
+    size_t count = 0;
+    for (auto const& child : nodes) {
+        switch (type_of(child)) {
+        case NodeType::Text: {
+            auto t = text_of(child);
+            count += std::count(t.begin(), t.end(), ' ') + 1;
+            break;
+        }
+        case NodeType::Strong:
+        case NodeType::Emphasis:
+        case NodeType::Link:
+            count += count_inline_words(children_of(child), depth + 1);
             break;
         default:
-            words.push_back(build_node(child, depth, qd, mqd, links,
-                                       focused_link, theme) | style);
+            ++count;
             break;
         }
     }
+    return count;
 }
 
 // Check if a paragraph node contains only plain text (Text + SoftBreak).
-bool is_plain_text_paragraph(ASTNode const& node) {
-    for (auto const& child : node.children) {
-        if (child.type != NodeType::Text && child.type != NodeType::SoftBreak) {
+template <class Node>
+bool is_plain_text_paragraph(Node const& node) {
+    for (auto const& child : children_of(node)) {
+        if (type_of(child) != NodeType::Text &&
+            type_of(child) != NodeType::SoftBreak) {
             return false;
         }
     }
@@ -179,9 +665,10 @@ bool is_plain_text_paragraph(ASTNode const& node) {
 }
 
 // Check if a node contains any HardBreak children.
-bool has_hard_break(ASTNode const& node) {
-    for (auto const& child : node.children) {
-        if (child.type == NodeType::HardBreak) return true;
+template <class Node>
+bool has_hard_break(Node const& node) {
+    for (auto const& child : children_of(node)) {
+        if (type_of(child) == NodeType::HardBreak) return true;
     }
     return false;
 }
@@ -189,7 +676,7 @@ bool has_hard_break(ASTNode const& node) {
 // Build a flexbox row from a flat list of word elements.
 ftxui::Element words_to_element(ftxui::Elements& words) {
     static const auto wrap_config = ftxui::FlexboxConfig().SetGap(0, 0);
-    if (words.empty()) return ftxui::text("");
+    if (words.empty()) return word("");
     // Always use flexbox — even for a single element.  Without this,
     // a lone underlined link stretches to the full vbox width and its
     // underline extends across the entire line (looks like a separator).
@@ -199,61 +686,70 @@ ftxui::Element words_to_element(ftxui::Elements& words) {
 // Wrapping version of build_inline_container for block-level paragraphs.
 // Splits all inline content into word-level flexbox items for line wrapping.
 // HardBreak nodes force a new line by splitting into separate flexbox rows.
-ftxui::Element build_wrapping_container(ASTNode const& node, int depth, int qd,
+template <class Node>
+ftxui::Element build_wrapping_container(Node const& node, int depth, int qd,
                                         int mqd, Links& links,
-                                        int focused_link,
                                         Theme const& theme) {
     // Fast path: plain text paragraphs use ftxui::paragraph() directly,
     // avoiding per-word flexbox overhead.
     if (is_plain_text_paragraph(node)) {
-        std::string combined;
-        for (auto const& child : node.children) {
-            if (child.type == NodeType::Text) {
+        // Joined in the pool, if any; its words are copied out of it.
+        std::pmr::string combined(t_pool ? t_pool->get()
+                                         : std::pmr::get_default_resource());
+        size_t size = 0;
+        for (auto const& child : children_of(node)) {
+            size += text_of(child).size() + 1;
+        }
+        combined.reserve(size);
+        for (auto const& child : children_of(node)) {
+            if (type_of(child) == NodeType::Text) {
                 if (!combined.empty() && combined.back() != ' ') {
                     combined += ' ';
                 }
-                combined += child.text;
-            } else if (child.type == NodeType::SoftBreak) {
+                combined += text_of(child);
+            } else if (type_of(child) == NodeType::SoftBreak) {
                 if (!combined.empty() && combined.back() != ' ') {
                     combined += ' ';
                 }
             }
         }
-        return ftxui::paragraph(normalize_emoji_width(combined));
+        return make_paragraph(combined);
     }
 
     // If no hard breaks, single flexbox row (common case).
     if (!has_hard_break(node)) {
         ftxui::Elements words;
-        collect_inline_words(node, depth, qd, mqd, words, ftxui::nothing,
-                             links, focused_link, theme);
+        words.reserve(count_inline_words(children_of(node), depth));
+        collect_inline_words(children_of(node), depth, qd, mqd, words, {},
+                             links, theme);
         return words_to_element(words);
     }
 
-    // Split at HardBreak boundaries: each segment becomes its own row.
-    // Build a temporary ASTNode per segment and collect words from it.
+    // Split at HardBreak boundaries: each run of siblings between breaks
+    // becomes its own row.  Runs are iterated in place, not copied.
     ftxui::Elements rows;
-    ASTNode segment{.type = node.type};
-    auto flush_segment = [&] {
-        if (segment.children.empty()) {
-            rows.push_back(ftxui::text(""));
+    auto flush_segment = [&](auto const& segment) {
+        if (segment.begin() == segment.end()) {
+            rows.push_back(word(""));
             return;
         }
         ftxui::Elements words;
-        collect_inline_words(segment, depth, qd, mqd, words, ftxui::nothing,
-                             links, focused_link, theme);
+        words.reserve(count_inline_words(segment, depth));
+        collect_inline_words(segment, depth, qd, mqd, words, {}, links,
+                             theme);
         rows.push_back(words_to_element(words));
-        segment.children.clear();
     };
 
-    for (auto const& child : node.children) {
-        if (child.type == NodeType::HardBreak) {
-            flush_segment();
-        } else {
-            segment.children.push_back(child);
+    auto children = children_of(node);
+    auto segment_begin = children.begin();
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        if (type_of(*it) == NodeType::HardBreak) {
+            flush_segment(Span{segment_begin, it});
+            segment_begin = it;
+            ++segment_begin;
         }
     }
-    flush_segment();
+    flush_segment(Span{segment_begin, children.end()});
 
     if (rows.size() == 1) return std::move(rows[0]);
     return ftxui::vbox(std::move(rows));
@@ -261,33 +757,32 @@ ftxui::Element build_wrapping_container(ASTNode const& node, int depth, int qd,
 
 // Build a ListItem: first Paragraph gets bullet/number prefix,
 // subsequent children (nested lists) rendered below with indentation.
-ftxui::Element build_list_item(ASTNode const& node, int depth, int qd,
+template <class Node>
+ftxui::Element build_list_item(Node const& node, int depth, int qd,
                                int mqd, std::string const& prefix,
-                               Links& links, int focused_link,
-                               Theme const& theme) {
+                               Links& links, Theme const& theme) {
     std::string indent(depth * 2, ' ');
 
     ftxui::Elements rows;
     bool first_para = true;
-    for (auto const& child : node.children) {
-        if (first_para && (child.type == NodeType::Paragraph ||
-                           child.type == NodeType::Text)) {
+    for (auto const& child : children_of(node)) {
+        if (first_para && (type_of(child) == NodeType::Paragraph ||
+                           type_of(child) == NodeType::Text)) {
             // First paragraph: render with wrapping, bullet/number prefix
             auto content = build_wrapping_container(child, depth, qd, mqd,
-                                                    links, focused_link, theme);
+                                                    links, theme);
             rows.push_back(ftxui::hbox({
-                ftxui::text(indent + prefix),
+                word(indent + prefix),
                 content | ftxui::flex,
             }));
             first_para = false;
         } else {
             // Nested lists or additional paragraphs
-            rows.push_back(build_node(child, depth, qd, mqd, links,
-                                      focused_link, theme));
+            rows.push_back(build_node(child, depth, qd, mqd, links, theme));
         }
     }
     if (rows.empty()) {
-        return ftxui::text(indent + prefix);
+        return word(indent + prefix);
     }
     if (rows.size() == 1) {
         return std::move(rows[0]);
@@ -295,184 +790,625 @@ ftxui::Element build_list_item(ASTNode const& node, int depth, int qd,
     return ftxui::vbox(std::move(rows));
 }
 
-ftxui::Element build_document(ASTNode const& node, int depth, int qd, int mqd,
-                              Links& links, int focused_link,
-                              Theme const& theme) {
-    auto children = build_children(node, depth, qd, mqd, links, focused_link,
-                                   theme);
-    if (children.empty()) return ftxui::text("");
+template <class Node>
+ftxui::Element build_document(Node const& node, int depth, int qd, int mqd,
+                              Links& links, Theme const& theme) {
+    auto children = build_children(node, depth, qd, mqd, links, theme);
+    if (children.empty()) return word("");
     ftxui::Elements spaced;
     for (size_t i = 0; i < children.size(); ++i) {
-        if (i > 0) spaced.push_back(ftxui::text(""));
+        if (i > 0) spaced.push_back(word(""));
         spaced.push_back(std::move(children[i]));
     }
     return ftxui::vbox(std::move(spaced));
 }
 
-ftxui::Element build_heading(ASTNode const& node, int depth, int qd, int mqd,
-                             Links& links, int focused_link,
-                             Theme const& theme) {
+template <class Node>
+ftxui::Element build_heading(Node const& node, int depth, int qd, int mqd,
+                             Links& links, Theme const& theme) {
     auto content = build_wrapping_container(node, depth, qd, mqd, links,
-                                            focused_link, theme);
-    if (node.level == 1) return content | theme.heading1;
-    if (node.level == 2) return content | theme.heading2;
+                                            theme);
+    if (level_of(node) == 1) return content | theme.heading1;
+    if (level_of(node) == 2) return content | theme.heading2;
     return content | theme.heading3;
 }
 
-ftxui::Element build_link(ASTNode const& node, int depth, int qd, int mqd,
-                          Links& links, int focused_link,
-                          Theme const& theme) {
-    bool is_focused = is_next_link_focused(links, focused_link);
-    auto el = build_inline_container(node, depth, qd, mqd, links,
-                                     focused_link, theme)
-        | link_style(is_focused, ftxui::nothing, theme);
+template <class Node>
+ftxui::Element build_link(Node const& node, int depth, int qd, int mqd,
+                          Links& links, Theme const& theme) {
     ftxui::Elements elems;
-    elems.push_back(std::move(el));
-    register_link(links, elems, 0, node.url, is_focused);
+    elems.push_back(build_inline_container(node, depth, qd, mqd, links, theme));
+    register_link(links, elems, 0, url_of(node), theme);
     return std::move(elems[0]);
 }
 
-ftxui::Element build_bullet_list(ASTNode const& node, int depth, int qd,
-                                 int mqd, Links& links, int focused_link,
-                                 Theme const& theme) {
+template <class Node>
+ftxui::Element build_bullet_list(Node const& node, int depth, int qd,
+                                 int mqd, Links& links, Theme const& theme) {
     ftxui::Elements items;
-    for (auto const& child : node.children) {
+    for (auto const& child : children_of(node)) {
         items.push_back(build_list_item(child, depth + 1, qd, mqd, "\u2022 ",
-                                        links, focused_link, theme));
+                                        links, theme));
     }
     return ftxui::vbox(std::move(items));
 }
 
-ftxui::Element build_ordered_list(ASTNode const& node, int depth, int qd,
-                                  int mqd, Links& links, int focused_link,
-                                  Theme const& theme) {
+template <class Node>
+ftxui::Element build_ordered_list(Node const& node, int depth, int qd,
+                                  int mqd, Links& links, Theme const& theme) {
     ftxui::Elements items;
-    int num = node.list_start;
-    for (auto const& child : node.children) {
+    int num = list_start_of(node);
+    for (auto const& child : children_of(node)) {
         items.push_back(build_list_item(child, depth + 1, qd, mqd,
                                         std::to_string(num++) + ". ",
-                                        links, focused_link, theme));
+                                        links, theme));
     }
     return ftxui::vbox(std::move(items));
 }
 
-ftxui::Element build_blockquote(ASTNode const& node, int depth, int qd,
-                                int mqd, Links& links, int focused_link,
-                                Theme const& theme) {
+template <class Node>
+ftxui::Element build_blockquote(Node const& node, int depth, int qd,
+                                int mqd, Links& links, Theme const& theme) {
     auto content = ftxui::vbox(build_children(node, depth, qd + 1, mqd, links,
-                                              focused_link, theme));
+                                              theme));
     // Cap visual indentation at max_quote_depth; content still renders.
     if (qd >= mqd) {
         return content | theme.blockquote;
     }
     return ftxui::hbox({
-        ftxui::text("\u2502 "),
+        word("\u2502 "),
         content | theme.blockquote,
     });
 }
 
-ftxui::Element build_code_block(ASTNode const& node, Theme const& theme) {
-    auto sanitized_code = normalize_emoji_width(node.text);
-    std::string_view code = sanitized_code;
+template <class Node>
+ftxui::Element build_code_block(Node const& node, Theme const& theme) {
+    auto code = text_of(node);
     if (!code.empty() && code.back() == '\n') code.remove_suffix(1);
     ftxui::Elements lines;
+    lines.reserve(std::count(code.begin(), code.end(), '\n') + 1);
     size_t start = 0;
     while (start <= code.size()) {
         auto end = code.find('\n', start);
         if (end == std::string_view::npos) {
-            lines.push_back(ftxui::text(std::string(code.substr(start))));
+            lines.push_back(word(code.substr(start)));
             break;
         }
-        lines.push_back(
-            ftxui::text(std::string(code.substr(start, end - start))));
+        lines.push_back(word(code.substr(start, end - start)));
         start = end + 1;
     }
-    if (lines.empty()) lines.push_back(ftxui::text(""));
+    if (lines.empty()) lines.push_back(word(""));
     auto content = ftxui::vbox(std::move(lines)) | theme.code_block;
-    if (!node.info.empty()) {
-        return ftxui::window(ftxui::text(" " + node.info + " ") | ftxui::dim,
-                             content);
+    auto info = info_of(node);
+    if (!info.empty()) {
+        return ftxui::window(
+            word(std::string(" ").append(info).append(" ")) | ftxui::dim,
+            content);
     }
     return content | ftxui::border;
 }
 
-ftxui::Element build_image(ASTNode const& node, int depth, int qd, int mqd,
-                           Links& links, int focused_link,
-                           Theme const& theme) {
-    auto alt = build_inline_container(node, depth, qd, mqd, links,
-                                      focused_link, theme);
+template <class Node>
+ftxui::Element build_image(Node const& node, int depth, int qd, int mqd,
+                           Links& links, Theme const& theme) {
+    auto alt = build_inline_container(node, depth, qd, mqd, links, theme);
     return ftxui::hbox({
-        ftxui::text("[IMG: ") | ftxui::dim,
+        word("[IMG: ") | ftxui::dim,
         alt,
-        ftxui::text("]") | ftxui::dim,
+        word("]") | ftxui::dim,
     });
 }
 
-ftxui::Element build_node(ASTNode const& node, int depth, int qd, int mqd,
-                          Links& links, int focused_link,
-                          Theme const& theme) {
+template <class Node>
+ftxui::Element build_node(Node const& node, int depth, int qd, int mqd,
+                          Links& links, Theme const& theme) {
     // Depth guard: fall back to plain text to prevent stack overflow.
     if (depth + qd > kMaxDepth) {
-        return ftxui::paragraph(collect_text(node));
+        register_plain_links(node, links);
+        return make_paragraph(collect_raw_text(node));
     }
 
-    switch (node.type) {
+    switch (type_of(node)) {
     case NodeType::Document:
-        return build_document(node, depth, qd, mqd, links, focused_link,
-                              theme);
+        return build_document(node, depth, qd, mqd, links, theme);
     case NodeType::Heading:
-        return build_heading(node, depth, qd, mqd, links, focused_link,
-                             theme);
+        return build_heading(node, depth, qd, mqd, links, theme);
     case NodeType::Paragraph:
-        return build_wrapping_container(node, depth, qd, mqd, links,
-                                        focused_link, theme);
+        return build_wrapping_container(node, depth, qd, mqd, links, theme);
     case NodeType::Strong:
-        return build_inline_container(node, depth, qd, mqd, links,
-                                      focused_link, theme) | ftxui::bold;
+        return build_inline_container(node, depth, qd, mqd, links, theme) |
+               ftxui::bold;
     case NodeType::Emphasis:
-        return build_inline_container(node, depth, qd, mqd, links,
-                                      focused_link, theme) | ftxui::italic;
+        return build_inline_container(node, depth, qd, mqd, links, theme) |
+               ftxui::italic;
     case NodeType::Link:
-        return build_link(node, depth, qd, mqd, links, focused_link, theme);
+        return build_link(node, depth, qd, mqd, links, theme);
     case NodeType::BulletList:
-        return build_bullet_list(node, depth, qd, mqd, links, focused_link,
-                                 theme);
+        return build_bullet_list(node, depth, qd, mqd, links, theme);
     case NodeType::OrderedList:
-        return build_ordered_list(node, depth, qd, mqd, links, focused_link,
-                                  theme);
+        return build_ordered_list(node, depth, qd, mqd, links, theme);
     case NodeType::ListItem:
-        return build_list_item(node, depth, qd, mqd, "\u2022 ", links,
-                               focused_link, theme);
+        return build_list_item(node, depth, qd, mqd, "\u2022 ", links, theme);
     case NodeType::BlockQuote:
-        return build_blockquote(node, depth, qd, mqd, links, focused_link,
-                                theme);
+        return build_blockquote(node, depth, qd, mqd, links, theme);
     case NodeType::CodeInline:
-        return ftxui::text(normalize_emoji_width(node.text)) | theme.code_inline;
+        return word(text_of(node)) | theme.code_inline;
     case NodeType::CodeBlock:
         return build_code_block(node, theme);
     case NodeType::ThematicBreak:
         return ftxui::separator();
     case NodeType::Image:
-        return build_image(node, depth, qd, mqd, links, focused_link, theme);
+        return build_image(node, depth, qd, mqd, links, theme);
     case NodeType::Text:
-        return ftxui::text(normalize_emoji_width(node.text));
+        return word(text_of(node));
     case NodeType::SoftBreak:
-        return ftxui::text(" ");
+        return word(" ");
     case NodeType::HardBreak:
-        return ftxui::text("");
+        return word("");
+    default:
+        return word(text_of(node));
+    }
+}
+
+constexpr uint64_t kMemoMul = 0x9E3779B97F4A7C15ULL;
+
+// Memo keys: the block's content hash with the build settings.  Flat
+// nodes carry no hash and are not memoized.
+uint64_t memo_key(ASTNode const& block, uint64_t setup) {
+    uint64_t key = std::rotl((subtree_hash(block) ^ setup) * kMemoMul, 31);
+    return key != 0 ? key : 1;
+}
+
+uint64_t memo_key(FlatNodeRef, uint64_t) { return 0; }
+
+// How a build refers to a block while others are built: tree nodes by
+// address, flat nodes by value.
+ASTNode const* ref_of(ASTNode const& n) { return &n; }
+FlatNodeRef ref_of(FlatNodeRef n) { return n; }
+ASTNode const& deref(ASTNode const* n) { return *n; }
+FlatNodeRef deref(FlatNodeRef n) { return n; }
+
+// Fewer blocks than this are built on the calling thread.
+constexpr size_t kParallelMinBlocks = 32;
+
+unsigned build_workers(unsigned requested, size_t jobs) {
+    if (jobs < kParallelMinBlocks) return 1;
+    unsigned n = requested ? requested : std::thread::hardware_concurrency();
+    n = std::max(n, 1u);
+    return static_cast<unsigned>(std::min<size_t>(n, jobs));
+}
+
+// Width assumed by row estimates of blocks not laid out yet.
+constexpr int kEstimateWidth = 80;
+
+// Rows a block is likely to take, from its structure alone.
+int estimate_rows(ASTNode const& node, int depth = 0) {
+    switch (node.type) {
+    case NodeType::CodeBlock:
+        return 2 + std::max<int>(1, std::count(node.text.begin(),
+                                               node.text.end(), '\n'));
+    case NodeType::Heading:
+    case NodeType::ThematicBreak:
+        return 1;
+    case NodeType::BulletList:
+    case NodeType::OrderedList:
+    case NodeType::ListItem:
+    case NodeType::BlockQuote: {
+        if (depth > kMaxDepth) return 1;
+        int rows = 0;
+        for (auto const& child : node.children) {
+            rows += estimate_rows(child, depth + 1);
+        }
+        return std::max(rows, 1);
+    }
     default:
-        return ftxui::text(normalize_emoji_width(node.text));
+        return 1 + static_cast<int>((node.source_end - node.source_begin) /
+                                    kEstimateWidth);
+    }
+}
+
+// A LinkTarget per Link node, in document order, as the build makes them.
+void collect_links(ASTNode const& root, Links& links) {
+    std::vector<ASTNode const*> stack{&root};
+    while (!stack.empty()) {
+        auto* n = stack.back();
+        stack.pop_back();
+        if (n->type == NodeType::Link) {
+            links.push_back(LinkTarget{
+                .url = n->url,
+                .focused = std::make_shared<bool>(false),
+            });
+        }
+        for (auto it = n->children.rbegin(); it != n->children.rend(); ++it) {
+            stack.push_back(&*it);
+        }
     }
 }
 
 } // namespace
 
+struct DomBuilder::VirtualSource {
+    // Read as blocks are built, during layout.
+    std::shared_ptr<MarkdownAST const> ast;
+    Theme theme;
+    int max_quote_depth = 0;
+    bool node_pool = true;
+    // The build's link targets; block i's are [link_begin[i],
+    // link_begin[i + 1]).
+    LinkTarget* links = nullptr;
+    std::vector<size_t> link_begin;
+    std::vector<FlatLinkBox> flat;
+
+    ftxui::Element build(size_t i) {
+        auto const& block = ast->children[i];
+        PoolScope scope(node_pool ? make_pool(block.source_end -
+                                              block.source_begin)
+                                  : nullptr);
+        Links made;
+        auto element = build_node(block, 0, 0, max_quote_depth, made, theme);
+        size_t begin = link_begin[i];
+        size_t end = link_begin[i + 1];
+        // A block built again replaces its link boxes: drop the old ones.
+        std::erase_if(flat, [&](FlatLinkBox const& f) {
+            auto k = static_cast<size_t>(f.link_index);
+            return k >= begin && k < end;
+        });
+        // Links nested past kMaxDepth are built as plain text but still
+        // get a target, so made lines up with the links counted.
+        for (size_t k = 0; k < made.size() && begin + k < end; ++k) {
+            auto& target = links[begin + k];
+            *made[k].focused = *target.focused;
+            // The element reads made[k]'s flag and boxes; moving keeps
+            // both in place.
+            target = std::move(made[k]);
+            for (auto const& box : target.boxes) {
+                flat.push_back({&box, static_cast<int>(begin + k)});
+            }
+        }
+        return element;
+    }
+
+    // Boxes of a block that left the layout would keep stale positions.
+    void hide(size_t i) {
+        for (size_t k = link_begin[i]; k < link_begin[i + 1]; ++k) {
+            for (auto& box : links[k].boxes) box = {0, -1, 0, -1};
+        }
+    }
+};
+
+void DomBuilder::set_focus(int link) {
+    if (link == _focus) return;
+    auto count = static_cast<int>(_link_targets.size());
+    if (_focus >= 0 && _focus < count) {
+        *_link_targets[_focus].focused = false;
+        relayout_block_of(_focus);
+    }
+    _focus = link >= 0 && link < count ? link : -1;
+    if (_focus >= 0) {
+        *_link_targets[_focus].focused = true;
+        relayout_block_of(_focus);
+    }
+}
+
+void DomBuilder::relayout_block_of(int link) {
+    // Block i holds the links up to _blocks[i].link_end.
+    auto it = std::upper_bound(
+        _blocks.begin(), _blocks.end(), static_cast<size_t>(link),
+        [](size_t k, BuiltBlock const& block) { return k < block.link_end; });
+    if (it != _blocks.end()) ++it->layout_epoch;
+}
+
+void DomBuilder::release_blocks() {
+    // Memoized links go back unfocused.
+    set_focus(-1);
+    size_t begin = 0;
+    for (auto& block : _blocks) {
+        if (block.memo_key != 0) {
+            auto it = _memo.find(block.memo_key);
+            if (it != _memo.end()) {
+                // Moving a LinkTarget keeps its boxes buffer, so the
+                // reflect() references inside the element stay valid.
+                it->second.links.assign(
+                    std::make_move_iterator(_link_targets.begin() + begin),
+                    std::make_move_iterator(_link_targets.begin() +
+                                            block.link_end));
+                it->second.in_use = false;
+            }
+        }
+        begin = block.link_end;
+    }
+    _blocks.clear();
+    _link_targets.clear();
+    _virtual_source.reset();
+    _virtual_list.reset();
+}
+
+void DomBuilder::evict_memo() {
+    if (_build_count <= kMemoBuilds) return;
+    uint64_t oldest = _build_count - kMemoBuilds;
+    std::erase_if(_memo, [oldest](auto const& entry) {
+        return entry.second.used < oldest;
+    });
+}
+
+template <class Node>
+ftxui::Element DomBuilder::build_root(Node const& root, int focused_link,
+                                      Theme const& theme) {
+    release_blocks();
+    ++_build_count;
+    _reused = 0;
+    if (type_of(root) != NodeType::Document) {
+        PoolScope scope(_node_pool ? make_pool(source_end_of(root) -
+                                               source_begin_of(root))
+                                   : nullptr);
+        auto result = build_node(root, 0, 0, _max_quote_depth, _link_targets,
+                                 theme);
+        index_link_boxes();
+        evict_memo();
+        set_focus(focused_link);
+        return result;
+    }
+
+    uint64_t setup = std::hash<std::string>{}(theme.name) ^
+                     static_cast<uint64_t>(_max_quote_depth) * kMemoMul;
+    // Repeated blocks (rules, boilerplate lines) get one slot per
+    // occurrence, numbered in document order.
+    std::unordered_map<uint64_t, uint64_t> repeats;
+
+    // Blocks missing from the memo, built once every block has its slot.
+    struct Miss {
+        size_t block;
+        decltype(ref_of(std::declval<Node const&>())) node;
+        Links links;
+        ftxui::Element element;
+    };
+    std::vector<Miss> misses;
+    size_t miss_bytes = 0;
+
+    for (auto const& child : children_of(root)) {
+        uint64_t base = memo_key(child, setup);
+        uint64_t key = base;
+        auto it = key != 0 ? _memo.find(key) : _memo.end();
+        while (it != _memo.end() && it->second.in_use) {
+            key = std::rotl((base + ++repeats[base]) * kMemoMul, 27) | 1;
+            it = _memo.find(key);
+        }
+        if (it != _memo.end()) {
+            auto& slot = it->second;
+            slot.in_use = true;
+            slot.used = _build_count;
+            _blocks.push_back({slot.element, 0, source_begin_of(child),
+                               source_end_of(child), {}, key});
+            ++_reused;
+            continue;
+        }
+        if (key != 0) {
+            auto& slot = _memo[key];
+            slot.links.clear();
+            slot.in_use = true;
+            slot.used = _build_count;
+        }
+        _blocks.push_back({nullptr, 0, source_begin_of(child),
+                           source_end_of(child), {}, key});
+        misses.push_back({_blocks.size() - 1, ref_of(child), {}, nullptr});
+        miss_bytes += source_end_of(child) - source_begin_of(child);
+    }
+
+    // Blocks are independent once each has its own link list; the lists
+    // are joined in document order below.
+    auto build_miss = [&](Miss& miss) {
+        miss.element = build_node(deref(miss.node), 0, 0, _max_quote_depth,
+                                  miss.links, theme);
+    };
+    unsigned workers = build_workers(_build_threads, misses.size());
+    // Each thread builds into its own pool.  The calling thread's also
+    // takes the block wrappers made below.
+    auto new_pool = [&] {
+        return _node_pool ? make_pool(miss_bytes / workers) : nullptr;
+    };
+    PoolScope scope(new_pool());
+    if (workers <= 1) {
+        for (auto& miss : misses) build_miss(miss);
+    } else {
+        // Largest first, as parse_many() schedules.
+        std::vector<size_t> order(misses.size());
+        std::iota(order.begin(), order.end(), size_t{0});
+        auto size_of = [&](size_t i) {
+            auto const& b = _blocks[misses[i].block];
+            return b.source_end - b.source_begin;
+        };
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return size_of(a) > size_of(b);
+        });
+        std::atomic<size_t> next{0};
+        auto work = [&] {
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) <
+                           order.size();) {
+                build_miss(misses[order[i]]);
+            }
+        };
+        std::vector<std::jthread> threads;
+        threads.reserve(workers - 1);
+        for (unsigned i = 1; i < workers; ++i) {
+            threads.emplace_back([&, own = new_pool()] {
+                PoolScope thread_scope(own);
+                work();
+            });
+        }
+        work();
+        threads.clear();  // joins
+    }
+
+    auto miss = misses.begin();
+    for (size_t i = 0; i < _blocks.size(); ++i) {
+        auto& block = _blocks[i];
+        auto* slot = block.memo_key != 0 ? &_memo[block.memo_key] : nullptr;
+        Links* links = slot ? &slot->links : nullptr;
+        if (miss != misses.end() && miss->block == i) {
+            block.element = miss->element;
+            if (slot) slot->element = std::move(miss->element);
+            links = &miss->links;
+            ++miss;
+        }
+        if (links) {
+            for (auto& link : *links) {
+                _link_targets.push_back(std::move(link));
+            }
+            links->clear();
+        }
+        block.link_end = _link_targets.size();
+    }
+    index_link_boxes();
+    evict_memo();
+    set_focus(focused_link);
+
+    if (_blocks.empty()) return ftxui::text("");
+    ftxui::Elements spaced;
+    spaced.reserve(_blocks.size() * 2);
+    for (size_t i = 0; i < _blocks.size(); ++i) {
+        if (i > 0) spaced.push_back(word(""));
+        // _blocks does not grow again before the next build, so the box
+        // stays put for as long as this element is laid out.
+        size_t begin = i > 0 ? _blocks[i - 1].link_end : 0;
+        spaced.push_back(make_node<BlockBox>(
+            _blocks[i].element, &_blocks[i].box, _link_targets.data() + begin,
+            _blocks[i].link_end - begin, &_blocks[i].layout_epoch));
+    }
+    return ftxui::vbox(std::move(spaced));
+}
+
+ftxui::Element DomBuilder::build_lines(MarkdownAST const& ast,
+                                       int focused_link, Theme const& theme) {
+    release_blocks();
+    ++_build_count;
+    _reused = 0;
+    auto layout = std::make_shared<LineLayout>(ast, theme, _max_quote_depth);
+    for (auto const& link : layout->links()) {
+        _link_targets.push_back(LinkTarget{
+            .boxes = std::vector<ftxui::Box>(link.words),
+            .url = link.url,
+            .focused = std::make_shared<bool>(false),
+        });
+    }
+    for (auto const& block : layout->blocks()) {
+        _blocks.push_back({nullptr, block.link_end, block.source_begin,
+                           block.source_end});
+    }
+    std::vector<LineLayout::LinkOutput> links;
+    links.reserve(_link_targets.size());
+    for (auto& target : _link_targets) {
+        links.push_back({target.boxes.data(), target.focused});
+    }
+    std::vector<ftxui::Box*> boxes;
+    boxes.reserve(_blocks.size());
+    for (auto& block : _blocks) boxes.push_back(&block.box);
+    layout->bind(std::move(links), std::move(boxes));
+
+    index_link_boxes();
+    evict_memo();
+    set_focus(focused_link);
+    return markdown::line_layout(std::move(layout));
+}
+
+ftxui::Element DomBuilder::build_virtual(
+    std::shared_ptr<MarkdownAST const> ast, int focused_link,
+    Theme const& theme) {
+    release_blocks();
+    ++_build_count;
+    _reused = 0;
+    _flat_boxes.clear();
+    auto source = std::make_shared<VirtualSource>();
+    source->theme = theme;
+    source->max_quote_depth = _max_quote_depth;
+    source->node_pool = _node_pool;
+    source->link_begin.push_back(0);
+    std::vector<int> estimates;
+    estimates.reserve(ast->children.size());
+    for (auto const& child : ast->children) {
+        collect_links(child, _link_targets);
+        source->link_begin.push_back(_link_targets.size());
+        _blocks.push_back({nullptr, _link_targets.size(), child.source_begin,
+                           child.source_end});
+        estimates.push_back(estimate_rows(child));
+    }
+    // _link_targets does not grow again before the next build.
+    source->links = _link_targets.data();
+    source->ast = std::move(ast);
+
+    _virtual_list = std::make_shared<VirtualList>(
+        std::move(estimates),
+        [source](size_t i) { return source->build(i); });
+    _virtual_list->on_hide([source](size_t i) { source->hide(i); });
+    _virtual_list->set_viewport(_viewport);
+    _virtual_source = std::move(source);
+    evict_memo();
+    set_focus(focused_link);
+    if (_blocks.empty()) return ftxui::text("");
+    return virtual_vbox(_virtual_list);
+}
+
 ftxui::Element DomBuilder::build(MarkdownAST const& ast, int focused_link,
                                  Theme const& theme) {
-    _link_targets.clear();
-    auto result = build_node(ast, 0, 0, _max_quote_depth, _link_targets,
+    if (_line_layout) return build_lines(ast, focused_link, theme);
+    if (_virtual && ast.type == NodeType::Document) {
+        return build_virtual(std::make_shared<MarkdownAST const>(ast),
                              focused_link, theme);
+    }
+    return build_root(ast, focused_link, theme);
+}
+
+ftxui::Element DomBuilder::build(std::shared_ptr<MarkdownAST const> ast,
+                                 int focused_link, Theme const& theme) {
+    if (!_line_layout && _virtual && ast->type == NodeType::Document) {
+        return build_virtual(std::move(ast), focused_link, theme);
+    }
+    return build(*ast, focused_link, theme);
+}
 
+ftxui::Element DomBuilder::build(FlatAST const& ast, int focused_link,
+                                 Theme const& theme) {
+    if (ast.empty()) {
+        release_blocks();
+        _flat_boxes.clear();
+        _reused = 0;
+        return ftxui::text("");
+    }
+    return build_root(ast.root(), focused_link, theme);
+}
+
+void DomBuilder::set_viewport(ScrollInfo const* viewport) {
+    _viewport = viewport;
+    if (_virtual_list) _virtual_list->set_viewport(viewport);
+}
+
+size_t DomBuilder::built_blocks() const {
+    return _virtual_list ? _virtual_list->built() : _blocks.size();
+}
+
+std::vector<FlatLinkBox> const& DomBuilder::flat_link_boxes() const {
+    return _virtual_source ? _virtual_source->flat : _flat_boxes;
+}
+
+ftxui::Box DomBuilder::block_box(size_t i) const {
+    return _virtual_list ? _virtual_list->block_box(i) : _blocks[i].box;
+}
+
+int DomBuilder::block_at_source(size_t offset) const {
+    auto it = std::upper_bound(
+        _blocks.begin(), _blocks.end(), offset,
+        [](size_t value, BuiltBlock const& b) { return value < b.source_begin; });
+    return static_cast<int>(it - _blocks.begin()) - 1;
+}
+
+int DomBuilder::block_at_row(int y) const {
+    if (_virtual_list) return _virtual_list->block_at_row(y);
+    auto it = std::upper_bound(
+        _blocks.begin(), _blocks.end(), y,
+        [](int value, BuiltBlock const& b) { return value < b.box.y_min; });
+    return static_cast<int>(it - _blocks.begin()) - 1;
+}
+
+void DomBuilder::index_link_boxes() {
     // Build flat index for click detection.  Stores pointers into
     // LinkTarget::boxes — reflect() fills them during layout, so the
     // pointers stay valid and always have fresh coordinates.
@@ -482,8 +1418,6 @@ ftxui::Element DomBuilder::build(MarkdownAST const& ast, int focused_link,
             _flat_boxes.push_back({&box, i});
         }
     }
-
-    return result;
 }
 
 } // namespace markdown
@@ -18,6 +18,15 @@ std::string const& Editor::content() const {
 
 void Editor::set_content(std::string text) {
     _content = std::move(text);
+    ++_revision;
+}
+
+TextBuffer const& Editor::buffer() {
+    if (_buffer_revision != _revision) {
+        _buffer = TextBuffer(_content, _buffer);
+        _buffer_revision = _revision;
+    }
+    return _buffer;
 }
 
 void Editor::set_cursor_position(int byte_offset) {
@@ -178,6 +187,7 @@ ftxui::Component Editor::component() {
     auto input_option = ftxui::InputOption();
     input_option.multiline = true;
     input_option.cursor_position = &_cursor_pos;
+    input_option.on_change = [this] { ++_revision; };
     input_option.transform = [this](ftxui::InputState state) {
         if (state.is_placeholder) return state.element;
         update_cursor_info();
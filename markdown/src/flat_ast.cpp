@@ -0,0 +1,42 @@
+#include "markdown/flat_ast.hpp"
+
+namespace markdown {
+
+void flatten(ASTNode const& root, FlatAST& out) {
+    out.clear();
+
+    // Explicit stack of open nodes: deep trees must not overflow.
+    struct Frame {
+        ASTNode const* node;
+        uint32_t index;
+        size_t next_child;
+    };
+    std::vector<Frame> stack;
+
+    auto open = [&](ASTNode const& n) {
+        auto i = out.open(n.type);
+        auto& flat = out.nodes[i];
+        flat.level = n.level;
+        flat.list_start = n.list_start;
+        flat.source_begin = n.source_begin;
+        flat.source_end = n.source_end;
+        out.set_text(i, n.text);
+        out.set_url(i, n.url);
+        out.set_info(i, n.info);
+        stack.push_back({&n, i, 0});
+    };
+
+    open(root);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.next_child < top.node->children.size()) {
+            auto const& child = top.node->children[top.next_child++];
+            open(child);
+        } else {
+            out.close(top.index);
+            stack.pop_back();
+        }
+    }
+}
+
+} // namespace markdown
@@ -0,0 +1,401 @@
+#include "markdown/incremental.hpp"
+#include "markdown/ast_diff.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace markdown {
+namespace {
+
+size_t line_begin(std::string_view text, size_t pos) {
+    while (pos > 0 && text[pos - 1] != '\n') --pos;
+    return pos;
+}
+
+size_t line_end(std::string_view text, size_t pos) {
+    auto nl = text.find('\n', pos);
+    return nl == std::string_view::npos ? text.size() : nl + 1;
+}
+
+bool is_blank(std::string_view line) {
+    for (char c : line) {
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') return false;
+    }
+    return true;
+}
+
+// Up to three spaces of indentation are not significant at block level.
+size_t skip_indent(std::string_view line) {
+    size_t i = 0;
+    while (i < 3 && i < line.size() && line[i] == ' ') ++i;
+    return i;
+}
+
+bool is_list_marker(std::string_view line) {
+    size_t i = 0;
+    if (i < line.size() && (line[i] == '-' || line[i] == '+' ||
+                            line[i] == '*')) {
+        ++i;
+    } else {
+        size_t digits = 0;
+        while (i < line.size() && line[i] >= '0' && line[i] <= '9' &&
+               digits < 9) {
+            ++i;
+            ++digits;
+        }
+        if (digits == 0 || i >= line.size() ||
+            (line[i] != '.' && line[i] != ')')) {
+            return false;
+        }
+        ++i;
+    }
+    return i >= line.size() || line[i] == ' ' || line[i] == '\t' ||
+           line[i] == '\n' || line[i] == '\r';
+}
+
+// First non-blank line in text[from, to), or an empty view.
+std::string_view first_content_line(std::string_view text, size_t from,
+                                    size_t to) {
+    while (from < to) {
+        size_t end = std::min(line_end(text, from), to);
+        auto line = text.substr(from, end - from);
+        if (!is_blank(line)) return line;
+        from = end;
+    }
+    return {};
+}
+
+// True if nothing after offset begin can extend the block before it: the
+// previous line is blank, or the previous block closes on its own line.
+bool closed_before(std::string_view text, size_t begin, NodeType prev_type) {
+    size_t prev_line = line_begin(text, begin - 1);
+    return is_blank(text.substr(prev_line, begin - prev_line)) ||
+           prev_type == NodeType::Heading ||
+           prev_type == NodeType::ThematicBreak ||
+           prev_type == NodeType::CodeBlock;
+}
+
+// Scans the lines of a slice for constructs whose extent is not bounded
+// by blank lines.  Returns true if reparsing the slice on its own could
+// differ from parsing it in place; has_refdefs reports link reference
+// definitions, which affect links anywhere in the document.
+bool has_nonlocal_blocks(std::string_view slice, bool& has_refdefs) {
+    bool html = false;
+    char fence_char = 0;
+    size_t fence_len = 0;
+    size_t pos = 0;
+    while (pos < slice.size()) {
+        size_t end = line_end(slice, pos);
+        auto line = slice.substr(pos, end - pos);
+        pos = end;
+        size_t i = skip_indent(line);
+        if (i >= line.size()) continue;
+        char c = line[i];
+
+        if (fence_char) {
+            // Inside a fence: only a matching closing fence matters.
+            size_t run = 0;
+            while (i + run < line.size() && line[i + run] == fence_char) ++run;
+            if (run >= fence_len && is_blank(line.substr(i + run))) {
+                fence_char = 0;
+            }
+            continue;
+        }
+        if (c == '`' || c == '~') {
+            size_t run = 0;
+            while (i + run < line.size() && line[i + run] == c) ++run;
+            if (run >= 3 && (c == '~' || line.find('`', i + run) ==
+                                             std::string_view::npos)) {
+                fence_char = c;
+                fence_len = run;
+            }
+            continue;
+        }
+        // HTML blocks of kinds 1-5 run until an end marker, not a blank.
+        if (c == '<') html = true;
+    }
+    // Reference definitions may sit inside containers or have multi-line
+    // labels; any "]:" is treated as one.
+    if (slice.find("]:") != std::string_view::npos) has_refdefs = true;
+    return fence_char != 0 || html || has_refdefs;
+}
+
+} // namespace
+
+namespace detail {
+
+// True if a line placed after a blank line can only open a new top-level
+// block: indented lines and list markers may continue a preceding list.
+bool starts_fresh_block(std::string_view line) {
+    if (line.empty()) return true;
+    if (line[0] == ' ' || line[0] == '\t') return false;
+    return !is_list_marker(line);
+}
+
+// Shift the source ranges of a block subtree by delta bytes.  Inline
+// children carry no ranges, so the walk stops at leaf blocks.
+void shift_source(ASTNode& root, std::ptrdiff_t delta) {
+    std::vector<ASTNode*> stack{&root};
+    while (!stack.empty()) {
+        auto* n = stack.back();
+        stack.pop_back();
+        if (n->source_end == 0) continue;
+        n->source_begin = static_cast<size_t>(
+            static_cast<std::ptrdiff_t>(n->source_begin) + delta);
+        n->source_end = static_cast<size_t>(
+            static_cast<std::ptrdiff_t>(n->source_end) + delta);
+        if (n->type == NodeType::Paragraph || n->type == NodeType::Heading) {
+            continue;
+        }
+        for (auto& child : n->children) stack.push_back(&child);
+    }
+}
+
+} // namespace detail
+
+using detail::shift_source;
+using detail::starts_fresh_block;
+
+void IncrementalReparser::reset() {
+    _text = TextBuffer();
+    _valid = false;
+    _has_refdefs = false;
+    _tail_block = 0;
+    _tail_begin = 0;
+}
+
+bool IncrementalReparser::full_parse(MarkdownParser& parser,
+                                     TextBuffer const& text,
+                                     MarkdownAST& ast,
+                                     ParseLimits const& limits) {
+    auto status = parser.parse(text, ast, limits);
+    _text = text;
+    _valid = status == ParseStatus::Complete;
+    _last_partial = status == ParseStatus::Partial;
+    _has_refdefs = false;
+    has_nonlocal_blocks(text, _has_refdefs);
+    _last_reparsed = text.size();
+    _last_full = true;
+    _unchanged = 0;
+    _tail_block = 0;
+    _tail_begin = 0;
+    return status != ParseStatus::Failed;
+}
+
+bool IncrementalReparser::update(MarkdownParser& parser,
+                                 std::string_view text, MarkdownAST& ast,
+                                 ParseLimits const& limits) {
+    return update(parser, TextBuffer(text, _text), ast, limits);
+}
+
+bool IncrementalReparser::update(MarkdownParser& parser,
+                                 TextBuffer const& buffer, MarkdownAST& ast,
+                                 ParseLimits const& limits) {
+    _last_partial = false;
+    std::string_view old = _text;
+    std::string_view text = buffer;
+    auto& blocks = ast.children;
+    if (!_valid || _has_refdefs || blocks.empty() ||
+        ast.type != NodeType::Document) {
+        return full_parse(parser, buffer, ast, limits);
+    }
+
+    // Dirty range: the edit, from the buffer if it knows it.
+    auto edit = buffer.edit_from(_text).value_or(diff_text(old, text));
+    if (edit.removed == 0 && edit.inserted == 0) {
+        _text = buffer;
+        _last_reparsed = 0;
+        _last_full = false;
+        _unchanged = blocks.size();
+        return true;
+    }
+    size_t prefix = edit.offset;
+    size_t old_dirty_end = edit.offset + edit.removed;
+    auto delta = static_cast<std::ptrdiff_t>(edit.inserted) -
+                 static_cast<std::ptrdiff_t>(edit.removed);
+
+    // Top-level block i owns [block_start(i), block_start(i + 1)).
+    size_t n = blocks.size();
+    auto block_start = [&](size_t i) {
+        return i == 0 ? 0 : line_begin(old, blocks[i].source_begin);
+    };
+    auto block_at = [&](size_t pos) {
+        size_t lo = 0, hi = n;
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (block_start(mid) <= pos) lo = mid; else hi = mid;
+        }
+        return lo;
+    };
+
+    // Reparse the touched blocks plus one neighbour on each side, since an
+    // edit can merge a block into the one before or after it.
+    size_t first = block_at(prefix);
+    size_t last = block_at(std::max(prefix, old_dirty_end) -
+                           (old_dirty_end > prefix ? 1 : 0));
+    first = first > 0 ? first - 1 : 0;
+    size_t stop = std::min(n, last + 2);
+
+    // Grow the slice until both ends sit on boundaries that a standalone
+    // parse cannot blur: a blank line followed by a line that can only
+    // open a fresh block.
+    size_t begin = 0, new_end = 0;
+    for (;;) {
+        begin = block_start(first);
+        new_end = stop == n
+            ? text.size()
+            : static_cast<size_t>(
+                  static_cast<std::ptrdiff_t>(block_start(stop)) + delta);
+        if (first > 0) {
+            if (!closed_before(text, begin, blocks[first - 1].type) ||
+                !starts_fresh_block(first_content_line(text, begin,
+                                                       new_end))) {
+                --first;
+                continue;
+            }
+        }
+        if (stop < n) {
+            size_t last_line = line_begin(text, new_end - 1);
+            auto next = text.substr(new_end, line_end(text, new_end) - new_end);
+            if (new_end == begin ||
+                !is_blank(text.substr(last_line, new_end - last_line)) ||
+                !starts_fresh_block(next)) {
+                ++stop;
+                continue;
+            }
+        }
+        break;
+    }
+
+    auto slice = text.substr(begin, new_end - begin);
+    bool refdefs = false;
+    if ((first == 0 && stop == n) || has_nonlocal_blocks(slice, refdefs)) {
+        return full_parse(parser, buffer, ast, limits);
+    }
+
+    // cmark extends blocks still open at the end of its input over the
+    // trailing blank lines.  The slice is therefore parsed together with
+    // the line after it, which closes the slice's last block as it does
+    // in the whole text; the block that line opens is dropped.
+    size_t parse_end = stop < n ? line_end(text, new_end) : new_end;
+    MarkdownAST sub;
+    if (!parser.parse(text.substr(begin, parse_end - begin), sub)) {
+        return full_parse(parser, buffer, ast, limits);
+    }
+    while (!sub.children.empty() &&
+           sub.children.back().source_begin >= slice.size()) {
+        sub.children.pop_back();
+    }
+    for (auto& block : sub.children) {
+        shift_source(block, static_cast<std::ptrdiff_t>(begin));
+    }
+    for (size_t i = stop; i < n; ++i) shift_source(blocks[i], delta);
+
+    blocks.erase(blocks.begin() + static_cast<std::ptrdiff_t>(first),
+                 blocks.begin() + static_cast<std::ptrdiff_t>(stop));
+    blocks.insert(blocks.begin() + static_cast<std::ptrdiff_t>(first),
+                  std::make_move_iterator(sub.children.begin()),
+                  std::make_move_iterator(sub.children.end()));
+    ast.source_begin = 0;
+    ast.source_end = text.size();
+    seal_hash(ast);
+
+    _text = buffer;
+    _last_reparsed = slice.size();
+    _last_full = false;
+    _unchanged = first;
+    // Streaming restarts from the top after an arbitrary edit.
+    _tail_block = 0;
+    _tail_begin = 0;
+    return true;
+}
+
+bool IncrementalReparser::append(MarkdownParser& parser,
+                                 std::string_view text, MarkdownAST& ast,
+                                 ParseLimits const& limits) {
+    // Appending to a copy of the last text is O(appended) when it is the
+    // newest holder of the storage.
+    TextBuffer buffer = _text;
+    if (text.size() >= _text.size()) {
+        buffer.append(text.substr(_text.size()));
+    } else {
+        buffer = TextBuffer(text);
+    }
+    return append(parser, buffer, ast, limits);
+}
+
+bool IncrementalReparser::append(MarkdownParser& parser,
+                                 TextBuffer const& text, MarkdownAST& ast,
+                                 ParseLimits const& limits) {
+    _last_partial = false;
+    if (!_valid || _has_refdefs || ast.type != NodeType::Document ||
+        text.size() < _text.size()) {
+        return full_parse(parser, text, ast, limits);
+    }
+    auto& blocks = ast.children;
+    if (text.size() == _text.size()) {
+        _text = text;
+        _last_reparsed = 0;
+        _last_full = false;
+        _unchanged = blocks.size();
+        return true;
+    }
+
+    _text = text;
+    std::string_view all = _text;
+    auto tail = all.substr(_tail_begin);
+    bool refdefs = false;
+    has_nonlocal_blocks(tail, refdefs);
+    if (refdefs) return full_parse(parser, text, ast, limits);
+
+    MarkdownAST sub;
+    auto stream = parser.open_stream();
+    stream->feed(tail);
+    if (!stream->finish(sub)) return full_parse(parser, text, ast, limits);
+    for (auto& block : sub.children) {
+        shift_source(block, static_cast<std::ptrdiff_t>(_tail_begin));
+    }
+
+    // Commit every tail block before the last safe boundary.  A boundary
+    // needs a complete first line after it (a partial "1" may still turn
+    // into a list marker) and no open fence or HTML block before it.  The
+    // last block always stays open: the next chunk may extend it.
+    size_t commit = 0;
+    size_t commit_begin = _tail_begin;
+    for (size_t j = sub.children.size(); j-- > 1;) {
+        size_t begin = line_begin(all, sub.children[j].source_begin);
+        auto first_line = all.substr(begin, line_end(all, begin) - begin);
+        if (first_line.empty() || first_line.back() != '\n' ||
+            !closed_before(all, begin, sub.children[j - 1].type) ||
+            !starts_fresh_block(first_line)) {
+            continue;
+        }
+        bool unused = false;
+        if (has_nonlocal_blocks(all.substr(_tail_begin, begin - _tail_begin),
+                                unused)) {
+            continue;
+        }
+        commit = j;
+        commit_begin = begin;
+        break;
+    }
+
+    blocks.erase(blocks.begin() + static_cast<std::ptrdiff_t>(_tail_block),
+                 blocks.end());
+    blocks.insert(blocks.end(),
+                  std::make_move_iterator(sub.children.begin()),
+                  std::make_move_iterator(sub.children.end()));
+    ast.source_begin = 0;
+    ast.source_end = all.size();
+    seal_hash(ast);
+
+    _last_reparsed = tail.size();
+    _last_full = false;
+    _unchanged = _tail_block;
+    _tail_block += commit;
+    _tail_begin = commit_begin;
+    return true;
+}
+
+} // namespace markdown
@@ -0,0 +1,758 @@
+#include "markdown/line_layout.hpp"
+
+#include <algorithm>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <ftxui/dom/node.hpp>
+
+#include "markdown/text_utils.hpp"
+
+namespace markdown {
+namespace {
+
+// Same limit as the element tree: deeper content becomes plain text.
+constexpr int kMaxDepth = 40;
+// Wrap width assumed before the first layout reports the real one.
+constexpr int kFirstWidth = 80;
+// What ftxui::reflect() leaves in the box of an element out of view.
+constexpr ftxui::Box kHidden{0, -1, 0, -1};
+
+void append_raw_text(std::string& out, ASTNode const& root) {
+    std::vector<ASTNode const*> stack{&root};
+    while (!stack.empty()) {
+        auto* n = stack.back();
+        stack.pop_back();
+        out += n->text;
+        if (n->type == NodeType::SoftBreak) out += ' ';
+        if (n->type == NodeType::HardBreak) out += '\n';
+        for (auto it = n->children.rbegin(); it != n->children.rend(); ++it) {
+            stack.push_back(&*it);
+        }
+    }
+}
+
+} // namespace
+
+CellStyle CellStyle::sample(ftxui::Decorator const& decorator) {
+    ftxui::Screen screen(1, 1);
+    ftxui::Render(screen, ftxui::text("x") | decorator);
+    auto const& pixel = screen.PixelAt(0, 0);
+    CellStyle style;
+    style.bold = pixel.bold;
+    style.dim = pixel.dim;
+    style.italic = pixel.italic;
+    style.underlined = pixel.underlined;
+    style.inverted = pixel.inverted;
+    style.has_fg = !(pixel.foreground_color == ftxui::Color());
+    style.has_bg = !(pixel.background_color == ftxui::Color());
+    style.fg = pixel.foreground_color;
+    style.bg = pixel.background_color;
+    return style;
+}
+
+CellStyle CellStyle::then(CellStyle const& outer) const {
+    CellStyle result = *this;
+    result.bold |= outer.bold;
+    result.dim |= outer.dim;
+    result.italic |= outer.italic;
+    result.underlined |= outer.underlined;
+    result.inverted |= outer.inverted;
+    if (outer.has_fg) {
+        result.has_fg = true;
+        result.fg = outer.fg;
+    }
+    if (outer.has_bg) {
+        result.has_bg = true;
+        result.bg = outer.bg;
+    }
+    return result;
+}
+
+void CellStyle::apply(ftxui::Pixel& pixel) const {
+    if (bold) pixel.bold = true;
+    if (dim) pixel.dim = true;
+    if (italic) pixel.italic = true;
+    if (underlined) pixel.underlined = true;
+    if (inverted) pixel.inverted = true;
+    if (has_fg) pixel.foreground_color = fg;
+    if (has_bg) pixel.background_color = bg;
+}
+
+bool CellStyle::operator==(CellStyle const& other) const {
+    return bold == other.bold && dim == other.dim &&
+           italic == other.italic && underlined == other.underlined &&
+           inverted == other.inverted && has_fg == other.has_fg &&
+           has_bg == other.has_bg && (!has_fg || fg == other.fg) &&
+           (!has_bg || bg == other.bg);
+}
+
+// Reduces the AST to rows, words and prefix pieces, following the
+// element tree's structure so both paths show the same text in the same
+// places: words split as collect_inline_words() splits them, list
+// prefixes and quote bars on the rows they would stand beside.
+struct LineLayout::Builder {
+    struct Prefix {
+        uint32_t begin = 0;
+        uint32_t count = 0;
+    };
+    // Everything a block inherits from its ancestors.
+    struct Context {
+        Prefix bars;          // quote bars, outermost first
+        CellStyle outer;      // decorators around the block
+        int depth = 0;
+        int qd = 0;
+    };
+
+    LineLayout& out;
+    int mqd;
+    CellStyle bold, italic, underlined, inverted, dim;
+    CellStyle link, code_inline, code_block, blockquote;
+    CellStyle heading1, heading2, heading3;
+    uint32_t block = kNoBlock;
+
+    Builder(LineLayout& layout, Theme const& theme, int max_quote_depth)
+        : out(layout), mqd(max_quote_depth),
+          bold(CellStyle::sample(ftxui::bold)),
+          italic(CellStyle::sample(ftxui::italic)),
+          underlined(CellStyle::sample(ftxui::underlined)),
+          inverted(CellStyle::sample(ftxui::inverted)),
+          dim(CellStyle::sample(ftxui::dim)),
+          link(CellStyle::sample(theme.link)),
+          code_inline(CellStyle::sample(theme.code_inline)),
+          code_block(CellStyle::sample(theme.code_block)),
+          blockquote(CellStyle::sample(theme.blockquote)),
+          heading1(CellStyle::sample(theme.heading1)),
+          heading2(CellStyle::sample(theme.heading2)),
+          heading3(CellStyle::sample(theme.heading3)) {
+        out._styles.push_back(CellStyle{});
+    }
+
+    uint16_t style_id(CellStyle const& style) {
+        auto it = std::find(out._styles.begin(), out._styles.end(), style);
+        if (it != out._styles.end()) {
+            return static_cast<uint16_t>(it - out._styles.begin());
+        }
+        out._styles.push_back(style);
+        return static_cast<uint16_t>(out._styles.size() - 1);
+    }
+
+    uint32_t add_text(std::string_view text) {
+        auto begin = static_cast<uint32_t>(out._text.size());
+        out._text += text;
+        return begin;
+    }
+
+    // bars followed by one more piece, if text is not empty.
+    Prefix prefix(Prefix bars, std::string_view text, CellStyle const& style) {
+        if (text.empty()) return bars;
+        Prefix result{static_cast<uint32_t>(out._pieces.size()),
+                      bars.count + 1};
+        for (uint32_t i = 0; i < bars.count; ++i) {
+            out._pieces.push_back(out._pieces[bars.begin + i]);
+        }
+        out._pieces.push_back(Piece{
+            .begin = add_text(text),
+            .size = static_cast<uint32_t>(text.size()),
+            .width = utf8_display_width(text),
+            .style = style_id(style),
+        });
+        return result;
+    }
+
+    Row& open_row(Prefix lead, Prefix indent, RowKind kind = RowKind::Text) {
+        auto at = static_cast<uint32_t>(out._words.size());
+        out._rows.push_back(Row{
+            .kind = kind,
+            .lead_begin = lead.begin,
+            .lead_count = lead.count,
+            .indent_begin = indent.begin,
+            .indent_count = indent.count,
+            .word_begin = at,
+            .word_end = at,
+            .block = block,
+        });
+        return out._rows.back();
+    }
+
+    void close_row() {
+        out._rows.back().word_end = static_cast<uint32_t>(out._words.size());
+    }
+
+    bool row_has_words() const {
+        return out._words.size() > out._rows.back().word_begin;
+    }
+
+    void add_word(std::string_view text, CellStyle const& style,
+                  CellStyle const& focus, int32_t link_index) {
+        Word word{
+            .begin = add_text(text),
+            .size = static_cast<uint32_t>(text.size()),
+            .width = utf8_display_width(text),
+            .style = style_id(style),
+            .focus_style = style_id(focus),
+            .link = link_index,
+        };
+        if (link_index >= 0) {
+            word.link_word =
+                static_cast<uint32_t>(out._links[link_index].words++);
+        }
+        out._words.push_back(word);
+    }
+
+    // Links shown as plain text keep an entry without words, so link
+    // numbers stay those of DocumentIndex.
+    void plain_links(ASTNode const& root) {
+        std::vector<ASTNode const*> stack{&root};
+        while (!stack.empty()) {
+            auto* n = stack.back();
+            stack.pop_back();
+            if (n->type == NodeType::Link) {
+                out._links.push_back(LinkInfo{.url = n->url});
+            }
+            for (auto it = n->children.rbegin(); it != n->children.rend();
+                 ++it) {
+                stack.push_back(&*it);
+            }
+        }
+    }
+
+    // Words of a run of inline nodes.  style and focus are the decorator
+    // chains inside the block (focus differs inside a link); outer is the
+    // block's.
+    template <class Range>
+    void inline_words(Range const& nodes, int depth, CellStyle const& style,
+                      CellStyle const& focus, CellStyle const& outer,
+                      int32_t link_index) {
+        auto word = [&](std::string_view text, CellStyle const& own) {
+            add_word(text, own.then(style).then(outer),
+                     own.then(focus).then(outer), link_index);
+        };
+        if (depth > kMaxDepth) {
+            std::string text;
+            for (auto const& n : nodes) append_raw_text(text, n);
+            if (!text.empty()) word(text, {});
+            for (auto const& n : nodes) plain_links(n);
+            return;
+        }
+        for (auto const& child : nodes) {
+            switch (child.type) {
+            case NodeType::Text: {
+                std::string_view t = child.text;
+                size_t pos = 0;
+                while (pos < t.size()) {
+                    size_t space_start = pos;
+                    while (pos < t.size() && t[pos] == ' ') ++pos;
+                    if (pos >= t.size()) {
+                        // Trailing spaces separate it from the next node.
+                        if (space_start < pos && row_has_words()) {
+                            word(" ", {});
+                        }
+                        break;
+                    }
+                    auto end = t.find(' ', pos);
+                    if (end == std::string_view::npos) end = t.size();
+                    std::string w;
+                    if (space_start < pos) w += ' ';
+                    w.append(t.data() + pos, end - pos);
+                    word(w, {});
+                    pos = end;
+                }
+                break;
+            }
+            case NodeType::SoftBreak:
+                word(" ", {});
+                break;
+            case NodeType::HardBreak:
+                break; // rows split at the block's own hard breaks
+            case NodeType::Strong:
+                inline_words(child.children, depth + 1, bold.then(style),
+                             bold.then(focus), outer, link_index);
+                break;
+            case NodeType::Emphasis:
+                inline_words(child.children, depth + 1, italic.then(style),
+                             italic.then(focus), outer, link_index);
+                break;
+            case NodeType::Link: {
+                auto index = static_cast<int32_t>(out._links.size());
+                out._links.push_back(LinkInfo{.url = child.url});
+                inline_words(child.children, depth + 1,
+                             style.then(underlined).then(link),
+                             style.then(underlined).then(inverted), outer,
+                             index);
+                break;
+            }
+            case NodeType::CodeInline:
+                word(child.text, code_inline);
+                break;
+            case NodeType::Image:
+                word("[IMG: ", dim);
+                inline_words(child.children, depth, style, focus, outer,
+                             link_index);
+                word("]", dim);
+                break;
+            default: {
+                std::string text;
+                append_raw_text(text, child);
+                word(text, {});
+                break;
+            }
+            }
+        }
+    }
+
+    // A paragraph-like node: one row per run between hard breaks.
+    void text_rows(ASTNode const& node, Context const& ctx, Prefix lead,
+                   Prefix indent, CellStyle const& outer) {
+        open_row(lead, indent);
+        auto const& children = node.children;
+        auto begin = children.begin();
+        for (auto it = children.begin(); it != children.end(); ++it) {
+            if (it->type != NodeType::HardBreak) continue;
+            inline_words(std::span(begin, it), ctx.depth, {}, {}, outer, -1);
+            close_row();
+            open_row(indent, indent);
+            begin = it + 1;
+        }
+        inline_words(std::span(begin, children.end()), ctx.depth, {}, {},
+                     outer, -1);
+        close_row();
+    }
+
+    void list_item(ASTNode const& node, Context const& ctx,
+                   std::string const& marker) {
+        std::string lead(static_cast<size_t>(ctx.depth) * 2, ' ');
+        lead += marker;
+        bool first_para = true;
+        for (auto const& child : node.children) {
+            if (first_para && (child.type == NodeType::Paragraph ||
+                               child.type == NodeType::Text)) {
+                Prefix first = prefix(ctx.bars, lead, ctx.outer);
+                Prefix rest = prefix(
+                    ctx.bars,
+                    std::string(static_cast<size_t>(
+                                    utf8_display_width(lead)), ' '),
+                    {});
+                if (child.type == NodeType::Text) {
+                    open_row(first, rest);
+                    inline_words(std::span(&child, 1), ctx.depth, {}, {},
+                                 ctx.outer, -1);
+                    close_row();
+                } else {
+                    text_rows(child, ctx, first, rest, ctx.outer);
+                }
+                first_para = false;
+            } else {
+                block_rows(child, ctx);
+            }
+        }
+        if (node.children.empty()) {
+            open_row(prefix(ctx.bars, lead, ctx.outer), ctx.bars);
+            close_row();
+        }
+    }
+
+    void code_rows(ASTNode const& node, Context const& ctx) {
+        auto border = style_id(ctx.outer);
+        open_row(ctx.bars, ctx.bars, RowKind::BoxTop).style = border;
+        if (!node.info.empty()) {
+            add_word(" " + node.info + " ", dim.then(ctx.outer),
+                     dim.then(ctx.outer), -1);
+        }
+        close_row();
+
+        std::string_view code = node.text;
+        if (!code.empty() && code.back() == '\n') code.remove_suffix(1);
+        auto text = code_block.then(ctx.outer);
+        for (auto line : split_lines(code)) {
+            open_row(ctx.bars, ctx.bars, RowKind::BoxLine).style = border;
+            add_word(line, text, text, -1);
+            close_row();
+        }
+        if (code.empty()) {
+            open_row(ctx.bars, ctx.bars, RowKind::BoxLine).style = border;
+            close_row();
+        }
+        open_row(ctx.bars, ctx.bars, RowKind::BoxBottom).style = border;
+        close_row();
+    }
+
+    void block_rows(ASTNode const& node, Context const& ctx) {
+        if (ctx.depth + ctx.qd > kMaxDepth) {
+            std::string text;
+            append_raw_text(text, node);
+            ASTNode plain{.type = NodeType::Text, .text = std::move(text)};
+            open_row(ctx.bars, ctx.bars);
+            inline_words(std::span(&plain, 1), 0, {}, {}, ctx.outer, -1);
+            close_row();
+            plain_links(node);
+            return;
+        }
+        switch (node.type) {
+        case NodeType::Document:
+            for (auto const& child : node.children) block_rows(child, ctx);
+            break;
+        case NodeType::Heading: {
+            auto const& h = node.level == 1   ? heading1
+                            : node.level == 2 ? heading2
+                                              : heading3;
+            text_rows(node, ctx, ctx.bars, ctx.bars, h.then(ctx.outer));
+            break;
+        }
+        case NodeType::Paragraph:
+            text_rows(node, ctx, ctx.bars, ctx.bars, ctx.outer);
+            break;
+        case NodeType::BulletList: {
+            Context inner = ctx;
+            ++inner.depth;
+            for (auto const& child : node.children) {
+                list_item(child, inner, "• ");
+            }
+            break;
+        }
+        case NodeType::OrderedList: {
+            Context inner = ctx;
+            ++inner.depth;
+            int num = node.list_start;
+            for (auto const& child : node.children) {
+                list_item(child, inner, std::to_string(num++) + ". ");
+            }
+            break;
+        }
+        case NodeType::ListItem:
+            list_item(node, ctx, "• ");
+            break;
+        case NodeType::BlockQuote: {
+            Context inner = ctx;
+            ++inner.qd;
+            if (ctx.qd < mqd) {
+                inner.bars = prefix(ctx.bars, "│ ", ctx.outer);
+            }
+            inner.outer = blockquote.then(ctx.outer);
+            for (auto const& child : node.children) {
+                block_rows(child, inner);
+            }
+            break;
+        }
+        case NodeType::CodeBlock:
+            code_rows(node, ctx);
+            break;
+        case NodeType::ThematicBreak:
+            open_row(ctx.bars, ctx.bars, RowKind::Rule).style =
+                style_id(ctx.outer);
+            close_row();
+            break;
+        default:
+            open_row(ctx.bars, ctx.bars);
+            inline_words(std::span(&node, 1), ctx.depth, {}, {}, ctx.outer,
+                         -1);
+            close_row();
+            break;
+        }
+    }
+
+    void document(MarkdownAST const& ast) {
+        if (ast.type != NodeType::Document) {
+            block_rows(ast, {});
+            return;
+        }
+        for (auto const& child : ast.children) {
+            if (!out._blocks.empty()) {
+                block = kNoBlock;
+                open_row({}, {});
+                close_row();
+            }
+            block = static_cast<uint32_t>(out._blocks.size());
+            block_rows(child, {});
+            out._blocks.push_back(BlockInfo{
+                .source_begin = child.source_begin,
+                .source_end = child.source_end,
+                .link_end = out._links.size(),
+            });
+        }
+    }
+};
+
+LineLayout::LineLayout(MarkdownAST const& ast, Theme const& theme,
+                       int max_quote_depth) {
+    Builder(*this, theme, max_quote_depth).document(ast);
+}
+
+void LineLayout::bind(std::vector<LinkOutput> links,
+                      std::vector<ftxui::Box*> block_boxes) {
+    _link_out = std::move(links);
+    _block_out = std::move(block_boxes);
+    for (size_t i = 0; i < _link_out.size() && i < _links.size(); ++i) {
+        std::fill_n(_link_out[i].boxes, _links[i].words, kHidden);
+    }
+}
+
+int LineLayout::prefix_width(uint32_t begin, uint32_t count) const {
+    int width = 0;
+    for (uint32_t i = begin; i < begin + count; ++i) {
+        width += _pieces[i].width;
+    }
+    return width;
+}
+
+void LineLayout::wrap(int width) {
+    _width = width;
+    _lines.clear();
+    _block_lines.assign(_blocks.size(), {0, 0});
+    for (uint32_t r = 0; r < _rows.size(); ++r) {
+        auto const& row = _rows[r];
+        if (row.block != kNoBlock) {
+            auto& range = _block_lines[row.block];
+            if (range.second == 0) range.first = _lines.size();
+        }
+        if (row.kind != RowKind::Text) {
+            _lines.push_back({r, row.word_begin, row.word_end, true});
+        } else {
+            int avail = std::max(
+                1, width - prefix_width(row.lead_begin, row.lead_count));
+            uint32_t start = row.word_begin;
+            int used = 0;
+            bool first = true;
+            for (uint32_t w = row.word_begin; w < row.word_end; ++w) {
+                if (w > start && used + _words[w].width > avail) {
+                    _lines.push_back({r, start, w, first});
+                    first = false;
+                    start = w;
+                    used = 0;
+                    avail = std::max(1, width - prefix_width(
+                                                    row.indent_begin,
+                                                    row.indent_count));
+                }
+                used += _words[w].width;
+            }
+            _lines.push_back({r, start, row.word_end, first});
+        }
+        if (row.block != kNoBlock) {
+            _block_lines[row.block].second = _lines.size();
+        }
+    }
+}
+
+int LineLayout::line_count(int width) {
+    if (width != _width) wrap(width);
+    return static_cast<int>(_lines.size());
+}
+
+void LineLayout::set_box(ftxui::Box box) {
+    _box = box;
+    line_count(box.x_max - box.x_min + 1);
+    // Block boxes are not clipped, so every block gets one, as the
+    // element tree's BlockBox nodes do.
+    for (size_t b = 0; b < _block_out.size() && b < _block_lines.size();
+         ++b) {
+        auto [first, end] = _block_lines[b];
+        *_block_out[b] = ftxui::Box{
+            box.x_min, box.x_max, box.y_min + static_cast<int>(first),
+            box.y_min + static_cast<int>(end) - 1};
+    }
+}
+
+int LineLayout::paint_text(ftxui::Screen& screen, int x, int y,
+                           uint32_t begin, uint32_t size,
+                           CellStyle const& style) const {
+    std::string_view text(_text.data() + begin, size);
+    ftxui::Pixel* last = nullptr;
+    size_t i = 0;
+    while (i < text.size()) {
+        size_t len = std::min(utf8_byte_length(text[i]), text.size() - i);
+        auto glyph = text.substr(i, len);
+        i += len;
+        int width = codepoint_width(utf8_codepoint(glyph.data(), len));
+        if (width == 0) {
+            if (last) last->character += glyph;
+            continue;
+        }
+        if (x + width - 1 > _box.x_max) return _box.x_max + 1;
+        last = nullptr;
+        if (screen.stencil.Contain(x, y)) {
+            last = &screen.PixelAt(x, y);
+            last->character = glyph;
+            style.apply(*last);
+            if (width == 2 && screen.stencil.Contain(x + 1, y)) {
+                auto& next = screen.PixelAt(x + 1, y);
+                next.character = "";
+                style.apply(next);
+            }
+        }
+        x += width;
+    }
+    return x;
+}
+
+void LineLayout::paint_line(ftxui::Screen& screen, size_t index, int y) {
+    auto const& line = _lines[index];
+    auto const& row = _rows[line.row];
+    int x = _box.x_min;
+    uint32_t begin = line.first ? row.lead_begin : row.indent_begin;
+    uint32_t count = line.first ? row.lead_count : row.indent_count;
+    for (uint32_t i = begin; i < begin + count; ++i) {
+        auto const& piece = _pieces[i];
+        x = paint_text(screen, x, y, piece.begin, piece.size,
+                       _styles[piece.style]);
+    }
+
+    auto const& border = _styles[row.style];
+    auto fill = [&](std::string_view glyph, int from, int to) {
+        for (int c = from; c <= to; ++c) {
+            if (!screen.stencil.Contain(c, y)) continue;
+            auto& pixel = screen.PixelAt(c, y);
+            pixel.character = glyph;
+            border.apply(pixel);
+        }
+    };
+    int right = _box.x_max;
+    switch (row.kind) {
+    case RowKind::Rule:
+        fill("─", x, right);
+        return;
+    case RowKind::BoxTop:
+    case RowKind::BoxBottom: {
+        bool top = row.kind == RowKind::BoxTop;
+        fill(top ? "╭" : "╰", x, x);
+        fill("─", x + 1, right - 1);
+        if (top && line.word_begin < line.word_end) {
+            auto const& title = _words[line.word_begin];
+            paint_text(screen, x + 1, y, title.begin, title.size,
+                       _styles[title.style]);
+        }
+        if (right > x) fill(top ? "╮" : "╯", right, right);
+        return;
+    }
+    case RowKind::BoxLine: {
+        fill("│", x, x);
+        if (right > x) fill("│", right, right);
+        if (line.word_begin < line.word_end) {
+            auto const& text = _words[line.word_begin];
+            auto saved = _box.x_max;
+            _box.x_max = right - 1;
+            paint_text(screen, x + 1, y, text.begin, text.size,
+                       _styles[text.style]);
+            _box.x_max = saved;
+        }
+        return;
+    }
+    case RowKind::Text:
+        break;
+    }
+
+    for (uint32_t w = line.word_begin; w < line.word_end; ++w) {
+        auto const& word = _words[w];
+        bool bound = word.link >= 0 &&
+                     static_cast<size_t>(word.link) < _link_out.size();
+        bool focused = bound && *_link_out[word.link].focused;
+        int start = x;
+        x = paint_text(screen, x, y, word.begin, word.size,
+                       _styles[focused ? word.focus_style : word.style]);
+        if (bound) {
+            auto* box = &_link_out[word.link].boxes[word.link_word];
+            *box = ftxui::Box::Intersection(
+                ftxui::Box{start, std::min(x, _box.x_max + 1) - 1, y, y},
+                screen.stencil);
+            _painted.push_back(box);
+        }
+    }
+}
+
+void LineLayout::clear_painted() {
+    for (auto* box : _painted) *box = kHidden;
+    _painted.clear();
+}
+
+void LineLayout::place_link(size_t link, ftxui::Box const& stencil) {
+    auto block = std::upper_bound(
+        _blocks.begin(), _blocks.end(), link,
+        [](size_t value, BlockInfo const& b) { return value < b.link_end; });
+    if (block == _blocks.end()) return;
+    auto [first, end] = _block_lines[block - _blocks.begin()];
+    for (size_t i = first; i < end; ++i) {
+        auto const& line = _lines[i];
+        auto const& row = _rows[line.row];
+        if (row.kind != RowKind::Text) continue;
+        int x = _box.x_min + (line.first ? prefix_width(row.lead_begin,
+                                                         row.lead_count)
+                                         : prefix_width(row.indent_begin,
+                                                        row.indent_count));
+        int y = _box.y_min + static_cast<int>(i);
+        for (uint32_t w = line.word_begin; w < line.word_end; ++w) {
+            auto const& word = _words[w];
+            if (static_cast<size_t>(word.link) == link) {
+                auto* box = &_link_out[link].boxes[word.link_word];
+                *box = ftxui::Box::Intersection(
+                    ftxui::Box{x, std::min(x + word.width, _box.x_max + 1) - 1,
+                               y, y},
+                    stencil);
+                _painted.push_back(box);
+            }
+            x += word.width;
+        }
+    }
+}
+
+void LineLayout::paint(ftxui::Screen& screen) {
+    clear_painted();
+    auto visible = ftxui::Box::Intersection(_box, screen.stencil);
+    for (int y = visible.y_min; y <= visible.y_max; ++y) {
+        auto line = static_cast<size_t>(y - _box.y_min);
+        if (line >= _lines.size()) break;
+        paint_line(screen, line, y);
+    }
+    // The focused link gets its boxes even out of view, clipped the way
+    // reflect() clips them, so the Viewer can scroll to it.
+    for (size_t i = 0; i < _link_out.size(); ++i) {
+        if (*_link_out[i].focused) place_link(i, screen.stencil);
+    }
+}
+
+namespace {
+
+// Lays out and paints a LineLayout.  Its height is only known once the
+// width is: a width change asks ftxui for another layout pass, as
+// ftxui's own flexbox does.
+class LineLayoutNode : public ftxui::Node {
+public:
+    explicit LineLayoutNode(std::shared_ptr<LineLayout> layout)
+        : _layout(std::move(layout)) {}
+
+    void ComputeRequirement() override {
+        requirement_ = {};
+        requirement_.min_y =
+            _layout->line_count(_width > 0 ? _width : kFirstWidth);
+    }
+
+    void SetBox(ftxui::Box box) override {
+        Node::SetBox(box);
+        int width = box.x_max - box.x_min + 1;
+        if (width != _width) {
+            _width = width;
+            _relayout = true;
+        }
+        _layout->set_box(box);
+    }
+
+    void Check(Status* status) override {
+        status->need_iteration |= _relayout;
+        _relayout = false;
+    }
+
+    void Render(ftxui::Screen& screen) override { _layout->paint(screen); }
+
+private:
+    std::shared_ptr<LineLayout> _layout;
+    int _width = -1;
+    bool _relayout = false;
+};
+
+} // namespace
+
+ftxui::Element line_layout(std::shared_ptr<LineLayout> layout) {
+    return std::make_shared<LineLayoutNode>(std::move(layout));
+}
+
+} // namespace markdown
@@ -0,0 +1,147 @@
+#include "markdown/live_preview.hpp"
+
+#include <algorithm>
+
+#include <ftxui/component/event.hpp>
+#include <ftxui/component/screen_interactive.hpp>
+#include <ftxui/dom/elements.hpp>
+
+namespace markdown {
+namespace {
+
+// Quiet time before forwarding, as a multiple of the update cost.
+constexpr int kIntervalPerCost = 2;
+// Continuous typing still forwards after this many intervals.
+constexpr int kMaxDelayIntervals = 4;
+constexpr LivePreview::Duration kMaxInterval{1000000};
+
+} // namespace
+
+LivePreview::LivePreview(std::unique_ptr<MarkdownParser> parser)
+    : _viewer(std::move(parser)) {}
+
+void LivePreview::set_theme(Theme const& theme) {
+    _editor.set_theme(theme);
+    _viewer.set_theme(theme);
+}
+
+LivePreview::Duration LivePreview::debounce_interval() const {
+    // The async viewer never blocks a frame; it coalesces on its own.
+    if (_viewer.async() || _cost <= _budget) return Duration{0};
+    return std::min(_cost * kIntervalPerCost, kMaxInterval);
+}
+
+void LivePreview::sample_cost() {
+    if (_viewer.update_count() == _seen_updates) return;
+    _seen_updates = _viewer.update_count();
+    auto cost = std::chrono::duration_cast<Duration>(
+        _viewer.last_update_cost());
+    // Smooth out one-off spikes, but follow a growing document quickly.
+    _cost = _cost.count() == 0 ? cost : (_cost + cost * 3) / 4;
+}
+
+void LivePreview::push() {
+    _viewer.set_content(_editor.buffer());
+    _pushed_revision = _editor.revision();
+    wake_at(Clock::time_point::max());
+}
+
+// Post Event::Custom to the active screen at `at`, replacing the wake-up
+// asked for before; Clock::time_point::max() cancels it.
+void LivePreview::wake_at(Clock::time_point at) {
+    auto* screen = ftxui::ScreenInteractive::Active();
+    if (!_waker.joinable()) {
+        if (!screen || at == Clock::time_point::max()) return;
+        _waker = std::jthread([this](std::stop_token stop) {
+            wake_loop(stop);
+        });
+    }
+    {
+        std::lock_guard lock(_wake_mutex);
+        if (at == _wake_at && screen == _wake_screen) return;
+        _wake_at = at;
+        _wake_screen = screen;
+    }
+    _wake_cv.notify_one();
+}
+
+void LivePreview::wake_loop(std::stop_token stop) {
+    std::unique_lock lock(_wake_mutex);
+    while (!stop.stop_requested()) {
+        auto at = _wake_at;
+        if (at == Clock::time_point::max()) {
+            _wake_cv.wait(lock, stop,
+                          [&] { return _wake_at != Clock::time_point::max(); });
+            continue;
+        }
+        // Moved or cancelled meanwhile: wait for the new time instead.
+        if (_wake_cv.wait_until(lock, stop, at,
+                                [&] { return _wake_at != at; })) {
+            continue;
+        }
+        if (stop.stop_requested()) break;
+        _wake_at = Clock::time_point::max();
+        if (_wake_screen) _wake_screen->PostEvent(ftxui::Event::Custom);
+    }
+}
+
+void LivePreview::flush() {
+    if (pending()) push();
+}
+
+void LivePreview::sync() {
+    sample_cost();
+
+    auto now = Clock::now();
+    auto revision = _editor.revision();
+    if (revision != _seen_revision) {
+        if (_seen_revision == _pushed_revision) _first_edit = now;
+        _seen_revision = revision;
+        _last_edit = now;
+    }
+    if (pending()) {
+        auto interval = debounce_interval();
+        auto due = std::min(_last_edit + interval,
+                            _first_edit + interval * kMaxDelayIntervals);
+        if (now >= due) {
+            push();
+        } else {
+            // Nothing else may redraw before then; frames in between
+            // would only find the edits still held.
+            wake_at(due);
+        }
+    }
+
+    if (_scroll_sync && !_viewer.active()) {
+        // Place the cursor's block through the source map; the line ratio
+        // is only a stand-in until the preview has been laid out once.
+        auto offset = static_cast<size_t>(_editor.cursor_position());
+        if (!_viewer.scroll_to_source(offset)) {
+            float ratio = 0.0f;
+            if (_editor.total_lines() > 1) {
+                ratio = static_cast<float>(_editor.cursor_line() - 1) /
+                        static_cast<float>(_editor.total_lines() - 1);
+            }
+            _viewer.set_scroll(ratio);
+        }
+    }
+}
+
+ftxui::Component LivePreview::component() {
+    if (_component) return _component;
+
+    auto editor_comp = _editor.component();
+    auto viewer_comp = _viewer.component();
+    auto container = ftxui::Container::Horizontal({editor_comp, viewer_comp});
+    _component = ftxui::Renderer(container, [this, editor_comp, viewer_comp] {
+        sync();
+        return ftxui::hbox({
+            editor_comp->Render() | ftxui::frame | ftxui::flex,
+            ftxui::separator(),
+            viewer_comp->Render() | ftxui::flex,
+        });
+    });
+    return _component;
+}
+
+} // namespace markdown
@@ -0,0 +1,421 @@
+#include "markdown/parallel.hpp"
+
+#include "markdown/ast_diff.hpp"
+#include "markdown/incremental.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <numeric>
+#include <string>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MARKDOWN_PARALLEL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace markdown {
+namespace {
+
+// Appended after a chunk so that its last block is closed the way the
+// next chunk's first line would close it.  A paragraph starting exactly
+// there also proves nothing was left open.
+constexpr std::string_view kSentinel = "x\n";
+constexpr std::string_view kBom = "\xEF\xBB\xBF";
+
+unsigned worker_count(unsigned requested, size_t jobs) {
+    unsigned n = requested ? requested : std::thread::hardware_concurrency();
+    n = std::max(n, 1u);
+    return static_cast<unsigned>(std::min<size_t>(n, jobs));
+}
+
+// Records where every line starts, 16 bytes at a time.  Returns false on
+// a '\r' not followed by '\n': cmark ends a line there and this scan
+// would not.
+bool index_lines(std::string_view s, std::vector<size_t>& starts) {
+    starts.clear();
+    starts.push_back(0);
+    char const* p = s.data();
+    size_t n = s.size();
+    size_t i = 0;
+#ifdef MARKDOWN_PARALLEL_SSE2
+    __m128i const newline = _mm_set1_epi8('\n');
+    __m128i const cr = _mm_set1_epi8('\r');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+        auto crs = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, cr)));
+        for (; crs; crs &= crs - 1) {
+            size_t at = i + static_cast<size_t>(std::countr_zero(crs));
+            if (at + 1 >= n || p[at + 1] != '\n') return false;
+        }
+        auto mask = static_cast<unsigned>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+        for (; mask; mask &= mask - 1) {
+            starts.push_back(i + static_cast<size_t>(std::countr_zero(mask)) +
+                             1);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (p[i] == '\n') {
+            starts.push_back(i + 1);
+        } else if (p[i] == '\r' && (i + 1 >= n || p[i + 1] != '\n')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_blank(std::string_view line) {
+    for (char c : line) {
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') return false;
+    }
+    return true;
+}
+
+size_t skip_indent(std::string_view line) {
+    size_t i = 0;
+    while (i < 3 && i < line.size() && line[i] == ' ') ++i;
+    return i;
+}
+
+char lower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// True if s starts with word, ignoring ASCII case.
+bool starts_with_nocase(std::string_view s, std::string_view word) {
+    if (s.size() < word.size()) return false;
+    for (size_t i = 0; i < word.size(); ++i) {
+        if (lower(s[i]) != word[i]) return false;
+    }
+    return true;
+}
+
+constexpr std::string_view kRawTags[] = {"script", "pre", "style",
+                                         "textarea"};
+
+// Kind (1-5) of the HTML block that s opens, or 0.  Only these kinds run
+// past blank lines.
+int html_block_kind(std::string_view s) {
+    if (s.starts_with("<!--")) return 2;
+    if (s.starts_with("<?")) return 3;
+    if (s.starts_with("<![CDATA[")) return 5;
+    if (s.size() > 2 && s[0] == '<' && s[1] == '!' &&
+        ((s[2] >= 'A' && s[2] <= 'Z') || (s[2] >= 'a' && s[2] <= 'z'))) {
+        return 4;
+    }
+    for (auto tag : kRawTags) {
+        if (!starts_with_nocase(s.substr(1), tag)) continue;
+        size_t at = 1 + tag.size();
+        if (at >= s.size() || s[at] == ' ' || s[at] == '\t' ||
+            s[at] == '>' || s[at] == '\n' || s[at] == '\r') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// True if s holds the end marker of an HTML block of the given kind.
+bool html_block_ends(int kind, std::string_view s) {
+    switch (kind) {
+    case 2: return s.find("-->") != std::string_view::npos;
+    case 3: return s.find("?>") != std::string_view::npos;
+    case 4: return s.find('>') != std::string_view::npos;
+    case 5: return s.find("]]>") != std::string_view::npos;
+    default: break;
+    }
+    for (size_t at = s.find("</"); at != std::string_view::npos;
+         at = s.find("</", at + 2)) {
+        for (auto tag : kRawTags) {
+            auto rest = s.substr(at + 2);
+            if (starts_with_nocase(rest, tag) && rest.size() > tag.size() &&
+                rest[tag.size()] == '>') {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool is_sentinel(ASTNode const& block, size_t at) {
+    return block.type == NodeType::Paragraph && block.source_begin == at;
+}
+
+class ParallelParser : public MarkdownParser {
+public:
+    explicit ParallelParser(ParallelParseOptions options)
+        : _options(std::move(options)), _parser(_options.make_parser()) {}
+
+    bool parse(std::string_view input, MarkdownAST& out) override {
+        if (input.size() < 2 * _options.min_chunk_bytes) {
+            return _parser->parse(input, out);
+        }
+        return parse_parallel(input, out, _options);
+    }
+
+    // Chunks parsed on other threads cannot be stopped, so a bounded
+    // parse runs on the calling thread.
+    ParseStatus parse(std::string_view input, MarkdownAST& out,
+                      ParseLimits const& limits) override {
+        if (!limits.bounded()) {
+            return parse(input, out) ? ParseStatus::Complete
+                                     : ParseStatus::Failed;
+        }
+        return _parser->parse(input, out, limits);
+    }
+
+private:
+    ParallelParseOptions _options;
+    std::unique_ptr<MarkdownParser> _parser;
+};
+
+} // namespace
+
+size_t parse_many(std::span<std::string_view const> inputs,
+                  std::span<MarkdownAST> out,
+                  ParseManyOptions const& options) {
+    size_t n = std::min(inputs.size(), out.size());
+    if (n == 0) return 0;
+
+    // Largest first: the tail of the schedule is made of short parses.
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return inputs[a].size() > inputs[b].size();
+    });
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> succeeded{0};
+    auto work = [&] {
+        auto parser = options.make_parser();
+        size_t ok = 0;
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;) {
+            size_t job = order[i];
+            if (parser->parse(inputs[job], out[job])) ++ok;
+        }
+        succeeded.fetch_add(ok, std::memory_order_relaxed);
+    };
+
+    unsigned workers = worker_count(options.threads, n);
+    std::vector<std::jthread> pool;
+    pool.reserve(workers - 1);
+    for (unsigned i = 1; i < workers; ++i) pool.emplace_back(work);
+    work();
+    pool.clear();  // joins
+    return succeeded.load(std::memory_order_relaxed);
+}
+
+std::vector<MarkdownAST> parse_many(std::span<std::string_view const> inputs,
+                                    ParseManyOptions const& options) {
+    std::vector<MarkdownAST> out(inputs.size());
+    parse_many(inputs, out, options);
+    return out;
+}
+
+std::vector<size_t> split_points(std::string_view text) {
+    std::vector<size_t> points;
+    std::vector<size_t> starts;
+    // cmark drops a byte order mark only at the very start of its input.
+    if (text.starts_with(kBom) || !index_lines(text, starts)) return points;
+
+    char fence_char = 0;
+    size_t fence_len = 0;
+    int html = 0;
+    bool after_blank = false;
+    for (size_t k = 0; k < starts.size() && starts[k] < text.size(); ++k) {
+        size_t begin = starts[k];
+        size_t end = k + 1 < starts.size() ? starts[k + 1] : text.size();
+        auto line = text.substr(begin, end - begin);
+        size_t i = skip_indent(line);
+
+        if (fence_char) {
+            size_t run = 0;
+            while (i + run < line.size() && line[i + run] == fence_char) ++run;
+            if (run >= fence_len && is_blank(line.substr(i + run))) {
+                fence_char = 0;
+            }
+            continue;
+        }
+        if (html) {
+            if (html_block_ends(html, line)) html = 0;
+            continue;
+        }
+        if (is_blank(line)) {
+            after_blank = true;
+            continue;
+        }
+        if (after_blank && detail::starts_fresh_block(line) &&
+            !line.starts_with(kBom)) {
+            points.push_back(begin);
+        }
+        after_blank = false;
+
+        char c = line[i];
+        if (c == '`' || c == '~') {
+            size_t run = 0;
+            while (i + run < line.size() && line[i + run] == c) ++run;
+            if (run >= 3 && (c == '~' || line.find('`', i + run) ==
+                                             std::string_view::npos)) {
+                fence_char = c;
+                fence_len = run;
+            }
+        } else if (c == '<') {
+            html = html_block_kind(line.substr(i));
+            if (html && html_block_ends(html, line.substr(i))) html = 0;
+        }
+    }
+    return points;
+}
+
+bool parse_parallel(std::string_view text, MarkdownAST& out,
+                    ParallelParseOptions const& options) {
+    auto whole = [&] { return options.make_parser()->parse(text, out); };
+    size_t min_chunk = std::max<size_t>(options.min_chunk_bytes, 1);
+    if (text.size() < 2 * min_chunk) return whole();
+    auto points = split_points(text);
+    if (points.empty()) return whole();
+
+    unsigned workers = worker_count(options.threads, points.size() + 1);
+    size_t target = std::max(min_chunk, text.size() / (size_t{workers} * 4));
+    auto plan = detail::plan_chunks(text, points, target);
+    size_t chunks = plan.chunks();
+    if (chunks < 2) return whole();
+
+    std::vector<std::string> inputs(chunks);
+    std::vector<std::string_view> views(chunks);
+    for (size_t c = 0; c < chunks; ++c) {
+        inputs[c] = detail::chunk_input(plan, text, c, c + 1);
+        views[c] = inputs[c];
+    }
+
+    std::vector<MarkdownAST> parts(chunks);
+    ParseManyOptions many{.threads = options.threads,
+                          .make_parser = options.make_parser};
+    if (parse_many(views, parts, many) != chunks) return whole();
+
+    // Keep each chunk's own blocks, between the sentinels, and rebase them.
+    std::vector<ASTNode> blocks;
+    size_t total = 0;
+    for (auto const& part : parts) total += part.children.size();
+    blocks.reserve(total);
+    for (size_t c = 0; c < chunks; ++c) {
+        if (!detail::take_chunk(plan, c, c + 1, parts[c], blocks)) {
+            return whole();
+        }
+    }
+
+    out = ASTNode{.type = NodeType::Document};
+    out.source_begin = 0;
+    out.source_end = text.size();
+    out.children = std::move(blocks);
+    seal_hash(out);
+    return true;
+}
+
+namespace detail {
+
+ChunkPlan plan_chunks(std::string_view text, std::span<size_t const> points,
+                      size_t target) {
+    ChunkPlan plan;
+    if (points.empty()) {
+        plan.cuts.push_back(text.size());
+        return plan;
+    }
+
+    // Segments lie between consecutive split points.  Those holding "]:"
+    // may define link references.
+    size_t segments = points.size() + 1;
+    auto segment_begin = [&](size_t s) { return s == 0 ? 0 : points[s - 1]; };
+    std::vector<char> defines(segments, 0);
+    for (size_t at = text.find("]:"); at != std::string_view::npos;
+         at = text.find("]:", at + 2)) {
+        auto s = std::upper_bound(points.begin(), points.end(), at) -
+                 points.begin();
+        defines[static_cast<size_t>(s)] = 1;
+    }
+
+    // Cut a chunk once it reaches the target size, and on both sides of
+    // every run of defining segments: the run's edges are then chunk
+    // edges, which the sentinels check.
+    for (size_t s = 0; s < segments; ++s) {
+        size_t begin = segment_begin(s);
+        if (s > 0 && (defines[s] != defines[s - 1] ||
+                      begin - plan.cuts.back() >= target)) {
+            plan.cuts.push_back(begin);
+        }
+        if (defines[s]) {
+            size_t end = s + 1 < segments ? points[s] : text.size();
+            plan.head.append(text.substr(begin, end - begin));
+        }
+    }
+    plan.cuts.push_back(text.size());
+    if (plan.head.size() * 8 > text.size()) {
+        plan.head.clear();
+        plan.cuts = {0, text.size()};
+        return plan;
+    }
+
+    // The definitions are closed by a sentinel paragraph of their own.
+    if (!plan.head.empty()) {
+        if (plan.head.back() != '\n') plan.head += '\n';
+        plan.head += '\n';
+        plan.head.append(kSentinel);
+        plan.head += '\n';
+    }
+    return plan;
+}
+
+std::string chunk_input(ChunkPlan const& plan, std::string_view text,
+                        size_t c, size_t d) {
+    auto chunk = text.substr(plan.cuts[c], plan.cuts[d] - plan.cuts[c]);
+    std::string input;
+    input.reserve(plan.head.size() + chunk.size() + kSentinel.size());
+    input = plan.head;
+    input.append(chunk);
+    if (d < plan.chunks()) input.append(kSentinel);
+    return input;
+}
+
+bool take_chunk(ChunkPlan const& plan, size_t c, size_t d, MarkdownAST& part,
+                std::vector<ASTNode>& blocks) {
+    auto& children = part.children;
+    size_t head = plan.head.size();
+    size_t first = 0;
+    if (head > 0) {
+        while (first < children.size() &&
+               children[first].source_begin < head) {
+            ++first;
+        }
+        if (first == 0 || !is_sentinel(children[first - 1], head - 3)) {
+            return false;
+        }
+    }
+    size_t last = children.size();
+    if (d < plan.chunks()) {
+        size_t sentinel = head + (plan.cuts[d] - plan.cuts[c]);
+        if (last == first || !is_sentinel(children[last - 1], sentinel)) {
+            return false;
+        }
+        --last;
+    }
+    auto delta = static_cast<std::ptrdiff_t>(plan.cuts[c]) -
+                 static_cast<std::ptrdiff_t>(head);
+    for (size_t i = first; i < last; ++i) {
+        shift_source(children[i], delta);
+        blocks.push_back(std::move(children[i]));
+    }
+    return true;
+}
+
+} // namespace detail
+
+std::unique_ptr<MarkdownParser> make_parallel_parser(
+    ParallelParseOptions options) {
+    return std::make_unique<ParallelParser>(std::move(options));
+}
+
+} // namespace markdown
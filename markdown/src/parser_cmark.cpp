@@ -1,152 +1,671 @@
 #include "markdown/parser.hpp"
+#include "markdown/ast_diff.hpp"
+#include "markdown/parallel.hpp"
+#include "markdown/text_utils.hpp"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <cmark-gfm.h>
 
 namespace markdown {
 namespace {
 
-ASTNode convert_node(cmark_node* node) {
-    ASTNode result;
+// Byte offset of the first character of every input line, used to turn
+// cmark's 1-based (line, column) positions into offsets into the input.
+// Line endings follow cmark: "\n", "\r\n" and a lone "\r".  base is
+// added to every offset, for text that is a slice of a larger input.
+class LineIndex {
+public:
+    explicit LineIndex(std::string_view text, size_t base = 0)
+        : _size(text.size()), _base(base) {
+        _starts.push_back(0);
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == '\n' ||
+                (text[i] == '\r' &&
+                 (i + 1 == text.size() || text[i + 1] != '\n'))) {
+                _starts.push_back(i + 1);
+            }
+        }
+    }
+
+    size_t offset(int line, int column) const {
+        if (line < 1) return _base;
+        auto idx = std::min(static_cast<size_t>(line - 1), _starts.size() - 1);
+        size_t col = column > 0 ? static_cast<size_t>(column - 1) : 0;
+        return _base + std::min(_starts[idx] + col, _size);
+    }
+
+private:
+    std::vector<size_t> _starts;
+    size_t _size;
+    size_t _base;
+};
+
+struct SourceRange {
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+SourceRange source_range(cmark_node* node, LineIndex const& lines) {
+    SourceRange r;
+    r.begin = lines.offset(cmark_node_get_start_line(node),
+                           cmark_node_get_start_column(node));
+    // end_column is inclusive (0 when the block ends on an empty line).
+    r.end = lines.offset(cmark_node_get_end_line(node),
+                         cmark_node_get_end_column(node) + 1);
+    r.end = std::max(r.end, r.begin);
+    return r;
+}
+
+// How a cmark node maps onto our node model.  The literals point into
+// the cmark tree and stay valid until it is freed.
+struct NodeInfo {
+    NodeType type = NodeType::Paragraph;
+    int level = 0;
+    int list_start = 1;
+    char const* text = nullptr;
+    char const* url = nullptr;
+    char const* info = nullptr;
+    bool leaf = false;   // children are not converted
+};
 
+NodeInfo describe(cmark_node* node) {
+    NodeInfo info;
     switch (cmark_node_get_type(node)) {
     case CMARK_NODE_DOCUMENT:
-        result.type = NodeType::Document;
+        info.type = NodeType::Document;
         break;
     case CMARK_NODE_PARAGRAPH:
-        result.type = NodeType::Paragraph;
+        info.type = NodeType::Paragraph;
+        break;
+    case CMARK_NODE_TEXT:
+        info.type = NodeType::Text;
+        info.text = cmark_node_get_literal(node);
+        info.leaf = true;
         break;
-    case CMARK_NODE_TEXT: {
-        result.type = NodeType::Text;
-        auto const* literal = cmark_node_get_literal(node);
-        if (literal) {
-            result.text = literal;
-        }
-        return result; // leaf node, no children
-    }
     case CMARK_NODE_SOFTBREAK:
-        result.type = NodeType::SoftBreak;
-        return result;
+        info.type = NodeType::SoftBreak;
+        info.leaf = true;
+        break;
     case CMARK_NODE_LINEBREAK:
-        result.type = NodeType::HardBreak;
-        return result;
+        info.type = NodeType::HardBreak;
+        info.leaf = true;
+        break;
     case CMARK_NODE_HEADING:
-        result.type = NodeType::Heading;
-        result.level = cmark_node_get_heading_level(node);
+        info.type = NodeType::Heading;
+        info.level = cmark_node_get_heading_level(node);
         break;
     case CMARK_NODE_EMPH:
-        result.type = NodeType::Emphasis;
+        info.type = NodeType::Emphasis;
         break;
     case CMARK_NODE_STRONG:
-        result.type = NodeType::Strong;
+        info.type = NodeType::Strong;
         break;
-    case CMARK_NODE_LINK: {
-        result.type = NodeType::Link;
-        auto const* url = cmark_node_get_url(node);
-        if (url) {
-            result.url = url;
-        }
+    case CMARK_NODE_LINK:
+        info.type = NodeType::Link;
+        info.url = cmark_node_get_url(node);
         break;
-    }
     case CMARK_NODE_LIST:
         if (cmark_node_get_list_type(node) == CMARK_ORDERED_LIST) {
-            result.type = NodeType::OrderedList;
-            result.list_start = cmark_node_get_list_start(node);
+            info.type = NodeType::OrderedList;
+            info.list_start = cmark_node_get_list_start(node);
         } else {
-            result.type = NodeType::BulletList;
+            info.type = NodeType::BulletList;
         }
         break;
     case CMARK_NODE_ITEM:
-        result.type = NodeType::ListItem;
+        info.type = NodeType::ListItem;
+        break;
+    case CMARK_NODE_CODE:
+        info.type = NodeType::CodeInline;
+        info.text = cmark_node_get_literal(node);
+        info.leaf = true;
         break;
-    case CMARK_NODE_CODE: {
-        result.type = NodeType::CodeInline;
-        auto const* literal = cmark_node_get_literal(node);
-        if (literal) {
-            result.text = literal;
-        }
-        return result;
-    }
     case CMARK_NODE_BLOCK_QUOTE:
-        result.type = NodeType::BlockQuote;
+        info.type = NodeType::BlockQuote;
         break;
     case CMARK_NODE_THEMATIC_BREAK:
-        result.type = NodeType::ThematicBreak;
-        return result;
-    case CMARK_NODE_IMAGE: {
-        result.type = NodeType::Image;
-        auto const* url = cmark_node_get_url(node);
-        if (url) {
-            result.url = url;
-        }
+        info.type = NodeType::ThematicBreak;
+        info.leaf = true;
+        break;
+    case CMARK_NODE_IMAGE:
+        info.type = NodeType::Image;
+        info.url = cmark_node_get_url(node);
         break; // children become alt text
-    }
-    case CMARK_NODE_HTML_INLINE: {
-        result.type = NodeType::Text;
-        auto const* literal = cmark_node_get_literal(node);
-        if (literal) {
-            result.text = literal;
-        }
-        return result;
-    }
-    case CMARK_NODE_HTML_BLOCK: {
-        result.type = NodeType::Text;
-        auto const* literal = cmark_node_get_literal(node);
-        if (literal) {
-            result.text = literal;
-        }
-        return result;
-    }
+    case CMARK_NODE_HTML_INLINE:
+    case CMARK_NODE_HTML_BLOCK:
+        info.type = NodeType::Text;
+        info.text = cmark_node_get_literal(node);
+        info.leaf = true;
+        break;
     case CMARK_NODE_CODE_BLOCK: {
-        result.type = NodeType::CodeBlock;
-        auto const* literal = cmark_node_get_literal(node);
-        if (literal) {
-            result.text = literal;
-        }
+        info.type = NodeType::CodeBlock;
+        info.text = cmark_node_get_literal(node);
         auto const* fence_info = cmark_node_get_fence_info(node);
         if (fence_info && fence_info[0]) {
-            result.info = fence_info;
+            info.info = fence_info;
         }
-        return result;
+        info.leaf = true;
+        break;
     }
     default:
         // Unsupported node types rendered as plain text
-        result.type = NodeType::Paragraph;
+        info.type = NodeType::Paragraph;
         break;
     }
+    return info;
+}
+
+bool is_block(cmark_node* node) {
+    return (cmark_node_get_type(node) & CMARK_NODE_TYPE_MASK) ==
+           CMARK_NODE_TYPE_BLOCK;
+}
+
+// Fill result from node, children aside.  Returns true if node's children
+// should be converted.
+bool fill_node(ASTNode& result, cmark_node* node, LineIndex const& lines) {
+    auto info = describe(node);
+    result.type = info.type;
+    result.level = info.level;
+    result.list_start = info.list_start;
+    if (info.text) {
+        result.text = info.text;
+        normalize_emoji_width_in_place(result.text);
+    }
+    if (info.url) result.url = info.url;
+    if (info.info) result.info = info.info;
+    if (is_block(node)) {
+        auto range = source_range(node, lines);
+        result.source_begin = range.begin;
+        result.source_end = range.end;
+    }
+    return !info.leaf;
+}
 
-    // Recurse into children
+size_t count_children(cmark_node* node) {
+    size_t n = 0;
     for (auto* child = cmark_node_first_child(node); child;
          child = cmark_node_next(child)) {
-        result.children.push_back(convert_node(child));
+        ++n;
     }
+    return n;
+}
+
+// Bounded parses check their limits every kWatchPeriod cmark allocations
+// and every kWatchPeriod converted nodes.
+constexpr unsigned kWatchPeriod = 256;
 
+// Convert the cmark tree under root.  Walks with parent/sibling links like
+// convert_flat, so nesting depth costs heap, not native stack.  Each
+// children vector is reserved to its exact size before its first child is
+// added: subtrees are built in place, never moved by a reallocation, and
+// the parent pointers on the stack stay valid.  A node's hash is sealed
+// once its last child is: leaves right away, parents while climbing.
+//
+// With limits, conversion stops once they expire: expired is set and the
+// unfinished result must be discarded.
+ASTNode convert_node(cmark_node* root, LineIndex const& lines,
+                     ParseLimits const* limits = nullptr,
+                     bool* expired = nullptr) {
+    ASTNode result;
+    std::vector<ASTNode*> open;
+    cmark_node* node = root;
+    ASTNode* out = &result;
+    unsigned countdown = kWatchPeriod;
+    for (;;) {
+        if (limits && --countdown == 0) {
+            countdown = kWatchPeriod;
+            if (limits->expired()) {
+                *expired = true;
+                return result;
+            }
+        }
+        auto* child = fill_node(*out, node, lines)
+            ? cmark_node_first_child(node) : nullptr;
+        if (child) {
+            out->children.reserve(count_children(node));
+            open.push_back(out);
+            node = child;
+            out = &out->children.emplace_back();
+            continue;
+        }
+        seal_hash(*out);
+        // Climb until an ancestor has a next sibling.
+        while (node != root && !cmark_node_next(node)) {
+            node = cmark_node_parent(node);
+            seal_hash(*open.back());
+            open.pop_back();
+        }
+        if (node == root) break;
+        node = cmark_node_next(node);
+        out = &open.back()->children.emplace_back();
+    }
     return result;
 }
 
+// Store text as node i's literal, emoji-normalized where it sits in the
+// arena, so non-ASCII literals need no temporary copy either.
+void set_normalized_text(FlatAST& out, uint32_t i, std::string_view text) {
+    out.set_text(i, text);
+    if (is_ascii(text)) return;
+    auto& node = out.nodes[i];
+    node.text_size = static_cast<uint32_t>(normalize_emoji_width_in_place(
+        out.arena.data() + node.text_offset, node.text_size));
+    out.arena.resize(node.text_offset + node.text_size);
+    // As set_text() leaves an empty literal.
+    if (node.text_size == 0) node.text_offset = 0;
+}
+
+// Emit the cmark tree straight into a FlatAST in preorder.  Walks with
+// parent/sibling links instead of recursion; the only bookkeeping is the
+// stack of open node indices.
+void convert_flat(cmark_node* root, LineIndex const& lines, FlatAST& out) {
+    std::vector<uint32_t> open;
+    cmark_node* node = root;
+    while (node) {
+        auto info = describe(node);
+        auto i = out.open(info.type);
+        out.nodes[i].level = info.level;
+        out.nodes[i].list_start = info.list_start;
+        if (info.text) set_normalized_text(out, i, info.text);
+        if (info.url) out.set_url(i, info.url);
+        if (info.info) out.set_info(i, info.info);
+        if (is_block(node)) {
+            auto range = source_range(node, lines);
+            out.nodes[i].source_begin = range.begin;
+            out.nodes[i].source_end = range.end;
+        }
+
+        auto* child = info.leaf ? nullptr : cmark_node_first_child(node);
+        if (child) {
+            open.push_back(i);
+            node = child;
+            continue;
+        }
+        out.close(i);
+        // Climb until an ancestor has a next sibling, closing as we go.
+        while (node != root && !cmark_node_next(node)) {
+            node = cmark_node_parent(node);
+            out.close(open.back());
+            open.pop_back();
+        }
+        node = node == root ? nullptr : cmark_node_next(node);
+    }
+}
+
+// Monotonic allocator behind cmark's cmark_mem.  Allocations bump a
+// pointer through a few large chunks, frees are no-ops, and reset() makes
+// the whole arena reusable at once, once a parse's tree is converted.
+// Chunks are kept across parses; after a parse that spilled into several,
+// they are replaced by one contiguous chunk sized for recent parses.
+class Arena {
+public:
+    Arena() = default;
+    Arena(Arena const&) = delete;
+    Arena& operator=(Arena const&) = delete;
+
+    void* allocate(size_t size) {
+        size_t need = sizeof(Header) + round_up(size);
+        if (_current >= _chunks.size() ||
+            _offset + need > _chunks[_current].size) {
+            next_chunk(need);
+        }
+        char* block = _chunks[_current].data.get() + _offset;
+        _offset += need;
+        _used += need;
+        reinterpret_cast<Header*>(block)->size = size;
+        _last = block + sizeof(Header);
+        return _last;
+    }
+
+    void* reallocate(void* p, size_t size) {
+        if (!p) return allocate(size);
+        auto* header = reinterpret_cast<Header*>(
+            static_cast<char*>(p) - sizeof(Header));
+        if (size <= header->size) return p;
+        // cmark grows buffers one at a time: the newest block can usually
+        // grow where it is.
+        size_t grow = round_up(size) - round_up(header->size);
+        if (p == _last && _offset + grow <= _chunks[_current].size) {
+            _offset += grow;
+            _used += grow;
+            header->size = size;
+            return p;
+        }
+        void* q = allocate(size);
+        std::memcpy(q, p, header->size);
+        return q;
+    }
+
+    void reset() {
+        // Size for recent parses, not just the last one: incremental
+        // reparses mix small slices with occasional full documents.
+        _peak = std::max(_used, _peak - _peak / 8);
+        size_t target = std::max(kChunkSize, _peak + _peak / 2);
+        if (_chunks.size() > 1 ||
+            (_chunks.size() == 1 && _chunks[0].size > 4 * target)) {
+            _chunks.clear();
+            _chunks.push_back(Chunk{std::make_unique<char[]>(target), target});
+        }
+        _current = 0;
+        _offset = 0;
+        _used = 0;
+        _last = nullptr;
+    }
+
+private:
+    // Keeps every block aligned like malloc's.
+    struct alignas(std::max_align_t) Header {
+        size_t size;
+    };
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    static size_t round_up(size_t n) {
+        return (n + alignof(Header) - 1) & ~(alignof(Header) - 1);
+    }
+
+    void next_chunk(size_t need) {
+        _offset = 0;
+        // Chunks kept from earlier parses first, then a new one.
+        while (++_current < _chunks.size()) {
+            if (_chunks[_current].size >= need) return;
+        }
+        size_t size = std::max({kChunkSize, need, _used});
+        _chunks.push_back(Chunk{std::make_unique<char[]>(size), size});
+        _current = _chunks.size() - 1;
+    }
+
+    std::vector<Chunk> _chunks;
+    size_t _current = 0;  // chunk being filled
+    size_t _offset = 0;   // bytes used in it
+    size_t _used = 0;     // bytes used since reset()
+    size_t _peak = 0;     // decaying maximum of _used
+    char* _last = nullptr;
+};
+
+// cmark_mem has no user pointer, so its callbacks reach the arena of the
+// parse running on this thread.
+thread_local Arena* t_arena = nullptr;
+
+// Limits of the bounded parse running on this thread.  cmark cannot be
+// stopped, but all of its allocations go through the arena: every
+// kWatchPeriod of them the limits are checked, and once they have expired
+// the parse is abandoned with a longjmp back to parse_document().  Only
+// cmark frames and the allocation hooks are skipped, none of them with
+// destructors to run, and everything cmark allocated is in the arena,
+// which the enclosing ArenaScope releases as usual.
+struct Watchdog {
+    ParseLimits const* limits = nullptr;
+    unsigned countdown = 0;
+    std::jmp_buf resume;
+};
+
+thread_local Watchdog* t_watchdog = nullptr;
+
+void watch() {
+    auto* w = t_watchdog;
+    if (!w || --w->countdown != 0) return;
+    w->countdown = kWatchPeriod;
+    if (w->limits->expired()) std::longjmp(w->resume, 1);
+}
+
+void* arena_calloc(size_t count, size_t size) {
+    watch();
+    if (size && count > SIZE_MAX / size) std::abort();
+    void* p = t_arena->allocate(count * size);
+    std::memset(p, 0, count * size);
+    return p;
+}
+
+void* arena_realloc(void* p, size_t size) {
+    watch();
+    return t_arena->reallocate(p, size);
+}
+
+void arena_free(void*) {}
+
+cmark_mem arena_mem = {arena_calloc, arena_realloc, arena_free};
+
+// Routes this thread's cmark allocations to arena for one parse, then
+// releases them all at once.
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena& arena) : _arena(arena), _saved(t_arena) {
+        t_arena = &arena;
+    }
+    ~ArenaScope() {
+        t_arena = _saved;
+        _arena.reset();
+    }
+    ArenaScope(ArenaScope const&) = delete;
+    ArenaScope& operator=(ArenaScope const&) = delete;
+
+private:
+    Arena& _arena;
+    Arena* _saved;
+};
+
+// Convert a finished cmark document (or its absence) into out.
+bool convert_tree(cmark_node* doc, std::string_view input, MarkdownAST& out) {
+    if (!doc) {
+        // Parsing failed — provide raw text as fallback
+        out = ASTNode{.type = NodeType::Document};
+        detail::append_raw_text(out, input, 0);
+        return false;
+    }
+
+    out = convert_node(doc, LineIndex(input));
+    out.source_begin = 0;
+    out.source_end = input.size();
+    return true;
+}
+
+// Chunked input through cmark_parser_feed().  The chunks are also kept
+// so block positions can be mapped back to byte offsets.
+class CmarkParseStream : public ParseStream {
+public:
+    CmarkParseStream() : _parser(cmark_parser_new(CMARK_OPT_DEFAULT)) {}
+    ~CmarkParseStream() override {
+        if (_parser) cmark_parser_free(_parser);
+    }
+    CmarkParseStream(CmarkParseStream const&) = delete;
+    CmarkParseStream& operator=(CmarkParseStream const&) = delete;
+
+    void feed(std::string_view chunk) override {
+        _text.append(chunk);
+        if (_parser) cmark_parser_feed(_parser, chunk.data(), chunk.size());
+    }
+
+    bool finish(MarkdownAST& out) override {
+        cmark_node* doc = _parser ? cmark_parser_finish(_parser) : nullptr;
+        bool ok = convert_tree(doc, _text, out);
+        if (doc) cmark_node_free(doc);
+        return ok;
+    }
+
+private:
+    cmark_parser* _parser;
+    std::string _text;
+};
+
+// Bounded parses go through the input in chunks of about this size, each
+// parsed on its own, so the work lost when time runs out stays small.
+constexpr size_t kChunkBytes = 64 * 1024;
+
 class CmarkParser : public MarkdownParser {
 public:
     bool parse(std::string_view input, MarkdownAST& out) override {
-        cmark_node* doc = cmark_parse_document(
-            input.data(), input.size(), CMARK_OPT_DEFAULT);
+        ArenaScope scope(_arena);
+        bool expired = false;
+        return convert_tree(parse_document(input, nullptr, expired), input,
+                            out);
+    }
+
+    // The input is cut at split points into chunks of about kChunkBytes,
+    // planned like parse_parallel(): reference definitions are copied in
+    // front of every chunk, and sentinels check that no block spans a cut.
+    // Chunks are parsed and converted in order until the limits expire;
+    // the chunk in progress then and everything after it become raw text.
+    // A chunk whose sentinels fail is merged with the rest of the input,
+    // and if the definitions do not stand on their own either, the input
+    // is parsed as one chunk.  If every chunk finishes, the result equals
+    // the unbounded parse.
+    ParseStatus parse(std::string_view input, MarkdownAST& out,
+                      ParseLimits const& limits) override {
+        if (!limits.bounded()) {
+            return parse(input, out) ? ParseStatus::Complete
+                                     : ParseStatus::Failed;
+        }
+        out = ASTNode{.type = NodeType::Document, .source_end = input.size()};
+        if (limits.expired()) {
+            detail::append_raw_text(out, input, 0);
+            return ParseStatus::Partial;
+        }
+
+        // Every chunk repeats the definitions: keep that under half of it.
+        auto points = split_points(input);
+        auto plan = detail::plan_chunks(input, points, kChunkBytes);
+        if (plan.head.size() * 2 > kChunkBytes) {
+            plan = detail::plan_chunks(input, points, plan.head.size() * 2);
+        }
+
+        std::vector<ASTNode> blocks;
+        size_t c = 0;
+        size_t d = 1;
+        while (c < plan.chunks()) {
+            auto text = detail::chunk_input(plan, input, c, d);
+            bool expired = false;
+            MarkdownAST part;
+            bool parsed = false;
+            {
+                ArenaScope scope(_arena);
+                cmark_node* doc = parse_document(text, &limits, expired);
+                if (doc) {
+                    part = convert_node(doc, LineIndex(text), &limits,
+                                        &expired);
+                    parsed = !expired;
+                }
+            }
+            if (!parsed) {
+                out.children = std::move(blocks);
+                detail::append_raw_text(out, input, plan.cuts[c]);
+                return expired ? ParseStatus::Partial : ParseStatus::Failed;
+            }
+            if (detail::take_chunk(plan, c, d, part, blocks)) {
+                c = d;
+                d = c + 1;
+            } else if (d < plan.chunks()) {
+                d = plan.chunks();
+            } else {
+                plan = detail::plan_chunks(input, {}, kChunkBytes);
+                blocks.clear();
+                c = 0;
+                d = 1;
+            }
+        }
+        out.children = std::move(blocks);
+        seal_hash(out);
+        return ParseStatus::Complete;
+    }
+
+    std::unique_ptr<ParseStream> open_stream() override {
+        return std::make_unique<CmarkParseStream>();
+    }
+
+    bool parse(std::string_view input, FlatAST& out) override {
+        out.clear();
+        ArenaScope scope(_arena);
+        bool expired = false;
+        cmark_node* doc = parse_document(input, nullptr, expired);
 
         if (!doc) {
             // Parsing failed — provide raw text as fallback
-            out = ASTNode{.type = NodeType::Document};
-            ASTNode para{.type = NodeType::Paragraph};
-            para.children.push_back(
-                ASTNode{.type = NodeType::Text, .text = std::string(input)});
-            out.children.push_back(std::move(para));
+            auto root = out.open(NodeType::Document);
+            auto para = out.open(NodeType::Paragraph);
+            auto text = out.open(NodeType::Text);
+            set_normalized_text(out, text, input);
+            out.close(text);
+            out.close(para);
+            out.close(root);
             return false;
         }
 
-        out = convert_node(doc);
-        cmark_node_free(doc);
+        // Size hints: literals rarely exceed the input, and nodes average
+        // well over eight input bytes each.
+        out.arena.reserve(input.size());
+        out.nodes.reserve(input.size() / 8 + 1);
+        convert_flat(doc, LineIndex(input), out);
+        out.nodes[0].source_begin = 0;
+        out.nodes[0].source_end = input.size();
         return true;
     }
+
+private:
+    // cmark_parse_document() on the arena.  The tree, and the parser
+    // itself, live until the enclosing ArenaScope resets the arena, so
+    // neither is freed node by node.  The parser cannot outlive the
+    // reset: cmark_parser_finish() reallocates its state on the arena.
+    //
+    // With limits, the watchdog may jump back here; expired is then set and
+    // nullptr returned.  Bounded input is fed in slices, so long runs of
+    // plain lines, which allocate rarely, are checked too.  No object with
+    // a destructor may live in this frame.
+    cmark_node* parse_document(std::string_view input,
+                               ParseLimits const* limits, bool& expired) {
+        Watchdog watchdog{.limits = limits, .countdown = kWatchPeriod};
+        if (setjmp(watchdog.resume) != 0) {
+            t_watchdog = nullptr;
+            expired = true;
+            return nullptr;
+        }
+        if (limits) t_watchdog = &watchdog;
+        cmark_parser* parser =
+            cmark_parser_new_with_mem(CMARK_OPT_DEFAULT, &arena_mem);
+        size_t slice = limits ? kChunkBytes / 4 : input.size();
+        for (size_t pos = 0; pos < input.size(); pos += slice) {
+            cmark_parser_feed(parser, input.data() + pos,
+                              std::min(slice, input.size() - pos));
+            if (limits && limits->expired()) {
+                t_watchdog = nullptr;
+                expired = true;
+                return nullptr;
+            }
+        }
+        cmark_node* doc = cmark_parser_finish(parser);
+        t_watchdog = nullptr;
+        return doc;
+    }
+
+    Arena _arena;
 };
 
 } // namespace
 
+namespace detail {
+void append_raw_text(MarkdownAST& doc, std::string_view input, size_t from) {
+    ASTNode para{.type = NodeType::Paragraph,
+                 .source_begin = from,
+                 .source_end = input.size()};
+    auto& text = para.children.emplace_back(
+        ASTNode{.type = NodeType::Text,
+                .text = normalize_emoji_width(input.substr(from))});
+    seal_hash(text);
+    seal_hash(para);
+    doc.children.push_back(std::move(para));
+    seal_hash(doc);
+}
+} // namespace detail
+
 std::unique_ptr<MarkdownParser> make_cmark_parser() {
     return std::make_unique<CmarkParser>();
 }
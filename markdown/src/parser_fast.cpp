@@ -0,0 +1,1316 @@
+#include "markdown/parser.hpp"
+#include "markdown/ast_diff.hpp"
+#include "markdown/text_utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MARKDOWN_FAST_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// A hand-written parser for the Markdown subset the viewer renders.  The
+// block and inline passes follow cmark-gfm's own algorithms step by step
+// (blocks.c and inlines.c), so that positions, text splitting and
+// emphasis nesting come out exactly as cmark builds them.  Whatever the
+// port does not cover -- HTML, entities, tabs, setext headings, indented
+// code, reference definitions and a few ambiguous corners -- makes
+// parse_fast() give up, and the document goes to cmark instead.
+
+namespace markdown {
+namespace {
+
+constexpr size_t kMaxContainerDepth = 32;
+constexpr size_t kMaxBacktickRun = 80;
+
+constexpr std::array<bool, 256> make_table(std::string_view chars) {
+    std::array<bool, 256> table{};
+    for (char c : chars) table[static_cast<unsigned char>(c)] = true;
+    return table;
+}
+
+// Bytes that can start an inline construct: cmark's special characters,
+// less '\r' and '<', which never reach the inline pass.
+constexpr auto kSpecial = make_table("\n\\`&_*[]!");
+// Bytes the link destination scan must look at.
+constexpr auto kUrlStop = make_table("\\() \n");
+constexpr auto kPunct = make_table("!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~");
+
+bool is_punct(char c) { return kPunct[static_cast<unsigned char>(c)]; }
+bool is_space(char c) { return c == ' ' || c == '\n'; }
+bool is_ascii(char c) { return static_cast<unsigned char>(c) < 0x80; }
+
+// First pass over the whole input, 16 bytes at a time: records where
+// every line starts and rejects bytes the fast path does not handle --
+// control characters other than '\n' (tabs, CR, NUL) and '<', which opens
+// HTML blocks, inline HTML and autolinks.
+bool index_lines(std::string_view s, std::vector<size_t>& starts) {
+    starts.clear();
+    starts.push_back(0);
+    char const* p = s.data();
+    size_t n = s.size();
+    size_t i = 0;
+#ifdef MARKDOWN_FAST_SSE2
+    __m128i const newline = _mm_set1_epi8('\n');
+    __m128i const lt = _mm_set1_epi8('<');
+    __m128i const ctrl_max = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + i));
+        __m128i nl = _mm_cmpeq_epi8(v, newline);
+        // Unsigned v <= 0x1F: max(v, 0x1F) is 0x1F.
+        __m128i ctrl = _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl_max), ctrl_max);
+        __m128i bad = _mm_or_si128(_mm_andnot_si128(nl, ctrl),
+                                   _mm_cmpeq_epi8(v, lt));
+        if (_mm_movemask_epi8(bad)) return false;
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(nl));
+        while (mask) {
+            starts.push_back(i + static_cast<size_t>(std::countr_zero(mask)) +
+                             1);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        auto c = static_cast<unsigned char>(p[i]);
+        if (c == '\n') {
+            starts.push_back(i + 1);
+        } else if (c < 0x20 || c == '<') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Position of the next special byte at or after pos, or s.size().
+size_t find_special(std::string_view s, size_t pos) {
+    char const* p = s.data();
+    size_t n = s.size();
+#ifdef MARKDOWN_FAST_SSE2
+    for (; pos + 16 <= n; pos += 16) {
+        __m128i v =
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + pos));
+        __m128i m = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('`')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('&')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('*')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('[')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(']')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('!')));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(m));
+        if (mask) return pos + static_cast<size_t>(std::countr_zero(mask));
+    }
+#endif
+    for (; pos < n; ++pos) {
+        if (kSpecial[static_cast<unsigned char>(p[pos])]) return pos;
+    }
+    return n;
+}
+
+// True if the '&' just before s could start an entity that cmark would
+// decode: a ';' before the next space, within the longest entity name.
+bool may_be_entity(std::string_view s) {
+    for (size_t i = 0; i < s.size() && i < 40; ++i) {
+        if (s[i] == ';') return true;
+        if (s[i] == ' ') return false;
+    }
+    return false;
+}
+
+// cmark_strbuf_unescape(): drop the backslash of escaped punctuation.
+std::string unescape(std::string_view s) {
+    size_t slash = s.find('\\');
+    if (slash == std::string_view::npos) return std::string(s);
+    std::string out(s.substr(0, slash));
+    for (size_t i = slash; i < s.size(); ++i) {
+        if (s[i] == '\\' && i + 1 < s.size() && is_punct(s[i + 1])) ++i;
+        out += s[i];
+    }
+    return out;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && is_space(s.front())) s.remove_prefix(1);
+    while (!s.empty() && is_space(s.back())) s.remove_suffix(1);
+    return s;
+}
+
+// ---------------------------------------------------------------------
+// Inlines (inlines.c)
+
+class InlineParser {
+public:
+    // Parse subject into children of out.  Returns false if it contains a
+    // construct outside the subset.
+    bool parse(std::string_view subject, ASTNode& out);
+
+private:
+    struct Node {
+        NodeType type = NodeType::Text;
+        std::string_view text;
+        std::string url;
+        int parent = -1;
+        int prev = -1;
+        int next = -1;
+        int first = -1;
+        int last = -1;
+    };
+    struct Delimiter {
+        int node;
+        char c;
+        bool can_open;
+        bool can_close;
+        int prev;
+        int next;
+    };
+    struct Bracket {
+        int node;
+        bool image;
+        bool active;
+        int prev_delim;
+    };
+
+    int make(NodeType type, std::string_view text = {}) {
+        _nodes.push_back(Node{.type = type, .text = text});
+        return static_cast<int>(_nodes.size() - 1);
+    }
+    void append(int parent, int n);
+    void insert_after(int ref, int n);
+    void insert_before(int ref, int n);
+    void unlink(int n);
+
+    void push_delimiter(int node, char c, bool can_open, bool can_close);
+    void remove_delimiter(int d);
+
+    bool handle_delim(char c);
+    bool handle_backticks();
+    bool handle_close_bracket();
+    void handle_newline();
+    void process_emphasis(int bottom);
+    int insert_emph(int opener, int closer);
+    void convert(ASTNode& out) const;
+
+    std::string_view _s;
+    size_t _pos = 0;
+    std::vector<Node> _nodes;
+    std::vector<Delimiter> _delims;
+    std::vector<Bracket> _brackets;
+    int _last_delim = -1;
+    // Start of the last backtick run of each length, once a scan for a
+    // closer has reached the end of the subject (subj->backticks).
+    std::array<size_t, kMaxBacktickRun + 1> _ticks{};
+    bool _ticks_scanned = false;
+    // _ticks as the full scan left it: the true last run of each length.
+    std::array<size_t, kMaxBacktickRun + 1> _last_ticks{};
+};
+
+void InlineParser::append(int parent, int n) {
+    auto& p = _nodes[parent];
+    _nodes[n].parent = parent;
+    _nodes[n].prev = p.last;
+    _nodes[n].next = -1;
+    if (p.last >= 0) _nodes[p.last].next = n; else p.first = n;
+    p.last = n;
+}
+
+void InlineParser::insert_after(int ref, int n) {
+    auto& r = _nodes[ref];
+    _nodes[n].parent = r.parent;
+    _nodes[n].prev = ref;
+    _nodes[n].next = r.next;
+    if (r.next >= 0) _nodes[r.next].prev = n;
+    else _nodes[r.parent].last = n;
+    r.next = n;
+}
+
+void InlineParser::insert_before(int ref, int n) {
+    auto& r = _nodes[ref];
+    _nodes[n].parent = r.parent;
+    _nodes[n].prev = r.prev;
+    _nodes[n].next = ref;
+    if (r.prev >= 0) _nodes[r.prev].next = n;
+    else _nodes[r.parent].first = n;
+    r.prev = n;
+}
+
+void InlineParser::unlink(int n) {
+    auto& node = _nodes[n];
+    if (node.prev >= 0) _nodes[node.prev].next = node.next;
+    else _nodes[node.parent].first = node.next;
+    if (node.next >= 0) _nodes[node.next].prev = node.prev;
+    else _nodes[node.parent].last = node.prev;
+    node.parent = node.prev = node.next = -1;
+}
+
+void InlineParser::push_delimiter(int node, char c, bool can_open,
+                                  bool can_close) {
+    _delims.push_back(Delimiter{node, c, can_open, can_close, _last_delim,
+                                -1});
+    int d = static_cast<int>(_delims.size() - 1);
+    if (_last_delim >= 0) _delims[_last_delim].next = d;
+    _last_delim = d;
+}
+
+void InlineParser::remove_delimiter(int d) {
+    auto& delim = _delims[d];
+    if (delim.next >= 0) _delims[delim.next].prev = delim.prev;
+    else _last_delim = delim.prev;
+    if (delim.prev >= 0) _delims[delim.prev].next = delim.next;
+}
+
+// scan_delims() and handle_delim() for '*' and '_'.
+bool InlineParser::handle_delim(char c) {
+    char before = _pos == 0 ? '\n' : _s[_pos - 1];
+    size_t start = _pos;
+    while (_pos < _s.size() && _s[_pos] == c) ++_pos;
+    char after = _pos == _s.size() ? '\n' : _s[_pos];
+    // Flanking next to non-ASCII needs Unicode classes.
+    if (!is_ascii(before) || !is_ascii(after)) return false;
+
+    bool left = !is_space(after) &&
+                (!is_punct(after) || is_space(before) || is_punct(before));
+    bool right = !is_space(before) &&
+                 (!is_punct(before) || is_space(after) || is_punct(after));
+    bool can_open = left;
+    bool can_close = right;
+    if (c == '_') {
+        can_open = left && (!right || is_punct(before));
+        can_close = right && (!left || is_punct(after));
+    }
+    // A run that can both open and close brings in the rule of three.
+    if (can_open && can_close) return false;
+
+    int node = make(NodeType::Text, _s.substr(start, _pos - start));
+    append(0, node);
+    if (can_open || can_close) push_delimiter(node, c, can_open, can_close);
+    return true;
+}
+
+bool InlineParser::handle_backticks() {
+    size_t start = _pos;
+    while (_pos < _s.size() && _s[_pos] == '`') ++_pos;
+    size_t ticks = _pos - start;
+    if (ticks > kMaxBacktickRun) return false;
+
+    // scan_to_closing_backticks()
+    size_t close = std::string_view::npos;
+    if (_ticks_scanned && _ticks[ticks] <= _pos) {
+        // cmark trusts its cache here, which a shorter scan since may
+        // have rewound past a closer that does exist.
+        if (_last_ticks[ticks] >= _pos) return false;
+    } else {
+        size_t i = _pos;
+        for (;;) {
+            i = _s.find('`', i);
+            if (i == std::string_view::npos) {
+                _ticks_scanned = true;
+                _last_ticks = _ticks;
+                break;
+            }
+            size_t run = i;
+            while (i < _s.size() && _s[i] == '`') ++i;
+            if (i - run <= kMaxBacktickRun) _ticks[i - run] = run;
+            if (i - run == ticks) {
+                close = run;
+                break;
+            }
+        }
+    }
+    if (close == std::string_view::npos) {
+        append(0, make(NodeType::Text, _s.substr(start, ticks)));
+        return true;
+    }
+
+    // S_normalize_code(), for spans on one line.
+    auto code = _s.substr(_pos, close - _pos);
+    if (code.find('\n') != std::string_view::npos) return false;
+    if (code.find_first_not_of(' ') != std::string_view::npos &&
+        code.front() == ' ' && code.back() == ' ') {
+        code = code.substr(1, code.size() - 2);
+    }
+    append(0, make(NodeType::CodeInline, code));
+    _pos = close + ticks;
+    return true;
+}
+
+void InlineParser::handle_newline() {
+    size_t nl = _pos++;
+    while (_pos < _s.size() && _s[_pos] == ' ') ++_pos;
+    bool hard = nl > 1 && _s[nl - 1] == ' ' && _s[nl - 2] == ' ';
+    append(0, make(hard ? NodeType::HardBreak : NodeType::SoftBreak));
+}
+
+bool InlineParser::handle_close_bracket() {
+    ++_pos;
+    size_t after_text = _pos;
+    auto literal = [&] {
+        append(0, make(NodeType::Text, _s.substr(after_text - 1, 1)));
+        return true;
+    };
+    if (_brackets.empty()) return literal();
+    Bracket opener = _brackets.back();
+    if (!opener.active) {
+        _brackets.pop_back();
+        return literal();
+    }
+
+    // Inline link: "(" destination [title] ")".  With no reference
+    // definitions in the document, nothing else can match.
+    auto spaces = [&](size_t i) {
+        while (i < _s.size() && is_space(_s[i])) ++i;
+        return i;
+    };
+    bool matched = false;
+    std::string_view dest;
+    if (_pos < _s.size() && _s[_pos] == '(') {
+        // manual_scan_link_url_2()
+        size_t begin = spaces(_pos + 1);
+        size_t i = begin;
+        int parens = 0;
+        bool ok = true;
+        while (i < _s.size()) {
+            char c = _s[i];
+            if (!kUrlStop[static_cast<unsigned char>(c)]) {
+                ++i;
+            } else if (c == '\\' && i + 1 < _s.size() && is_punct(_s[i + 1])) {
+                i += 2;
+            } else if (c == '(') {
+                ++i;
+                if (++parens > 32) {
+                    ok = false;
+                    break;
+                }
+            } else if (c == ')') {
+                if (parens == 0) break;
+                --parens;
+                ++i;
+            } else if (is_space(c)) {
+                break;
+            } else {
+                ++i;
+            }
+        }
+        if (ok && parens == 0 && i < _s.size()) {
+            size_t end = spaces(i);
+            if (end != i && end < _s.size() &&
+                (_s[end] == '"' || _s[end] == '\'' || _s[end] == '(')) {
+                return false;  // titles are not ported
+            }
+            if (end < _s.size() && _s[end] == ')') {
+                dest = _s.substr(begin, i - begin);
+                _pos = end + 1;
+                matched = true;
+            }
+        }
+    }
+    if (!matched) {
+        _brackets.pop_back();
+        return literal();
+    }
+
+    // cmark_clean_url()
+    for (size_t amp = dest.find('&'); amp != std::string_view::npos;
+         amp = dest.find('&', amp + 1)) {
+        if (may_be_entity(dest.substr(amp + 1))) return false;
+    }
+    int link = make(opener.image ? NodeType::Image : NodeType::Link);
+    _nodes[link].url = unescape(dest);
+    insert_before(opener.node, link);
+    for (int n = _nodes[opener.node].next; n >= 0;) {
+        int next = _nodes[n].next;
+        unlink(n);
+        append(link, n);
+        n = next;
+    }
+    unlink(opener.node);
+    process_emphasis(opener.prev_delim);
+    _brackets.pop_back();
+
+    // Links cannot contain links: deactivate earlier link openers.
+    if (!opener.image) {
+        for (auto it = _brackets.rbegin(); it != _brackets.rend(); ++it) {
+            if (it->image) continue;
+            if (!it->active) break;
+            it->active = false;
+        }
+    }
+    return true;
+}
+
+// S_insert_emph(): returns the next closer to look at.
+int InlineParser::insert_emph(int opener, int closer) {
+    int opener_node = _delims[opener].node;
+    int closer_node = _delims[closer].node;
+    auto& opener_text = _nodes[opener_node].text;
+    auto& closer_text = _nodes[closer_node].text;
+    size_t use = opener_text.size() >= 2 && closer_text.size() >= 2 ? 2 : 1;
+    opener_text.remove_suffix(use);
+    closer_text.remove_suffix(use);
+
+    for (int d = _delims[closer].prev; d >= 0 && d != opener;) {
+        int prev = _delims[d].prev;
+        remove_delimiter(d);
+        d = prev;
+    }
+
+    int emph = make(use == 1 ? NodeType::Emphasis : NodeType::Strong);
+    for (int n = _nodes[opener_node].next; n != closer_node;) {
+        int next = _nodes[n].next;
+        unlink(n);
+        append(emph, n);
+        n = next;
+    }
+    insert_after(opener_node, emph);
+
+    if (_nodes[opener_node].text.empty()) {
+        unlink(opener_node);
+        remove_delimiter(opener);
+    }
+    if (_nodes[closer_node].text.empty()) {
+        unlink(closer_node);
+        int next = _delims[closer].next;
+        remove_delimiter(closer);
+        return next;
+    }
+    return closer;
+}
+
+// process_emphasis() above delimiter bottom (-1 for all).  Runs that can
+// both open and close never get here, so the nearest opener always
+// matches and openers_bottom is only an optimisation.
+void InlineParser::process_emphasis(int bottom) {
+    int closer = -1;
+    for (int d = _last_delim; d >= 0 && d != bottom; d = _delims[d].prev) {
+        closer = d;
+    }
+    while (closer >= 0) {
+        auto const& c = _delims[closer];
+        if (!c.can_close) {
+            closer = c.next;
+            continue;
+        }
+        int opener = c.prev;
+        while (opener >= 0 && opener != bottom &&
+               !(_delims[opener].can_open && _delims[opener].c == c.c)) {
+            opener = _delims[opener].prev;
+        }
+        if (opener >= 0 && opener != bottom) {
+            closer = insert_emph(opener, closer);
+        } else {
+            int next = c.next;
+            if (!c.can_open) remove_delimiter(closer);
+            closer = next;
+        }
+    }
+    while (_last_delim >= 0 && _last_delim != bottom) {
+        remove_delimiter(_last_delim);
+    }
+}
+
+bool InlineParser::parse(std::string_view subject, ASTNode& out) {
+    _s = subject;
+    _pos = 0;
+    _nodes.clear();
+    _delims.clear();
+    _brackets.clear();
+    _last_delim = -1;
+    _ticks.fill(0);
+    _ticks_scanned = false;
+    make(NodeType::Paragraph);  // root
+
+    while (_pos < _s.size()) {
+        char c = _s[_pos];
+        bool ok = true;
+        switch (c) {
+        case '\n':
+            handle_newline();
+            break;
+        case '`':
+            ok = handle_backticks();
+            break;
+        case '\\':
+            ++_pos;
+            if (_pos < _s.size() && is_punct(_s[_pos])) {
+                append(0, make(NodeType::Text, _s.substr(_pos++, 1)));
+            } else if (_pos < _s.size() && _s[_pos] == '\n') {
+                // Only a lazy line can still start with spaces here.
+                if (++_pos < _s.size() && _s[_pos] == ' ') return false;
+                append(0, make(NodeType::HardBreak));
+            } else {
+                append(0, make(NodeType::Text, _s.substr(_pos - 1, 1)));
+            }
+            break;
+        case '&':
+            if (may_be_entity(_s.substr(_pos + 1))) return false;
+            append(0, make(NodeType::Text, _s.substr(_pos++, 1)));
+            break;
+        case '*':
+        case '_':
+            ok = handle_delim(c);
+            break;
+        case '[': {
+            int node = make(NodeType::Text, _s.substr(_pos++, 1));
+            append(0, node);
+            _brackets.push_back(Bracket{node, false, true, _last_delim});
+            break;
+        }
+        case ']':
+            ok = handle_close_bracket();
+            break;
+        case '!':
+            if (_pos + 1 < _s.size() && _s[_pos + 1] == '[') {
+                // "![^" is a footnote reference in cmark-gfm.
+                if (_pos + 2 < _s.size() && _s[_pos + 2] == '^') return false;
+                int node = make(NodeType::Text, _s.substr(_pos, 2));
+                _pos += 2;
+                append(0, node);
+                _brackets.push_back(Bracket{node, true, true, _last_delim});
+            } else {
+                append(0, make(NodeType::Text, _s.substr(_pos++, 1)));
+            }
+            break;
+        default: {
+            size_t end = find_special(_s, _pos + 1);
+            auto text = _s.substr(_pos, end - _pos);
+            if (end < _s.size() && _s[end] == '\n') {
+                while (!text.empty() && text.back() == ' ') {
+                    text.remove_suffix(1);
+                }
+                // cmark keeps an empty text node here; leave it to cmark.
+                if (text.empty()) return false;
+            }
+            append(0, make(NodeType::Text, text));
+            _pos = end;
+            break;
+        }
+        }
+        if (!ok) return false;
+    }
+    process_emphasis(-1);
+    convert(out);
+    return true;
+}
+
+// Append the inline tree to out, merging adjacent text nodes like
+// cmark_consolidate_text_nodes().  Iterative: nesting costs heap only.
+// Every inline is sealed once complete; out itself is left to the caller.
+void InlineParser::convert(ASTNode& out) const {
+    auto count = [&](int parent) {
+        size_t n = 0;
+        bool text = false;
+        for (int c = _nodes[parent].first; c >= 0; c = _nodes[c].next) {
+            bool is_text = _nodes[c].type == NodeType::Text;
+            if (!(is_text && text)) ++n;
+            text = is_text;
+        }
+        return n;
+    };
+    struct Frame {
+        int next;
+        ASTNode* out;
+    };
+    std::vector<Frame> stack;
+    out.children.reserve(count(0));
+    stack.push_back(Frame{_nodes[0].first, &out});
+    while (!stack.empty()) {
+        int n = stack.back().next;
+        ASTNode* parent = stack.back().out;
+        if (n < 0) {
+            if (stack.size() > 1) seal_hash(*parent);
+            stack.pop_back();
+            continue;
+        }
+        auto const& node = _nodes[n];
+        int next = node.next;
+        if (node.type == NodeType::Text) {
+            std::string text(node.text);
+            for (; next >= 0 && _nodes[next].type == NodeType::Text;
+                 next = _nodes[next].next) {
+                text += _nodes[next].text;
+            }
+            normalize_emoji_width_in_place(text);
+            stack.back().next = next;
+            seal_hash(parent->children.emplace_back(
+                ASTNode{.type = NodeType::Text, .text = std::move(text)}));
+            continue;
+        }
+        stack.back().next = next;
+        auto& child = parent->children.emplace_back();
+        child.type = node.type;
+        if (node.type == NodeType::CodeInline) {
+            child.text = node.text;
+            normalize_emoji_width_in_place(child.text);
+        }
+        child.url = node.url;
+        if (node.first >= 0) {
+            child.children.reserve(count(n));
+            stack.push_back(Frame{node.first, &child});
+        } else {
+            seal_hash(child);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------
+// Blocks (blocks.c)
+
+enum class Kind : uint8_t {
+    Document,
+    BlockQuote,
+    List,
+    Item,
+    Paragraph,
+    Heading,
+    CodeBlock,
+    ThematicBreak,
+};
+
+// One line of block content: input[begin, end), plus the line's '\n'
+// (real, or the one cmark appends to the last line) if newline is set.
+struct Piece {
+    size_t begin;
+    size_t end;
+    bool newline;
+};
+
+struct Block {
+    Kind kind = Kind::Document;
+    bool open = true;
+    int parent = -1;
+    int first = -1;
+    int last = -1;
+    int next = -1;
+    size_t depth = 0;
+    int start_line = 0;
+    size_t start_column = 0;  // 1-based
+    int end_line = 0;
+    size_t end_column = 0;    // inclusive, 0 for an empty line
+    // Lists and items (cmark_list)
+    bool ordered = false;
+    char marker = 0;          // bullet character or ordered delimiter
+    int list_start = 1;
+    size_t marker_offset = 0;
+    size_t padding = 0;
+    // Fenced code
+    char fence_char = 0;
+    size_t fence_length = 0;
+    size_t fence_offset = 0;
+    int level = 0;
+    // Content lines, a range of BlockParser::_pieces
+    size_t piece_begin = 0;
+    size_t piece_end = 0;
+};
+
+class BlockParser {
+public:
+    bool parse(std::string_view input, MarkdownAST& out);
+
+private:
+    // Per-line cursor (cmark_parser's offset, first_nonspace, indent and
+    // blank).  Tabs never get here, so columns equal offsets.
+    char peek(size_t i) const {
+        if (i >= _len) return 0;
+        return i < _line.size() ? _line[i] : '\n';
+    }
+    void find_first_nonspace() {
+        if (_first_nonspace <= _offset) {
+            _first_nonspace = _offset;
+            while (peek(_first_nonspace) == ' ') ++_first_nonspace;
+        }
+        _indent = _first_nonspace - _offset;
+        _blank = peek(_first_nonspace) == '\n';
+    }
+
+    bool process_line(size_t begin, size_t end);
+    int check_open_blocks(bool& all_matched);
+    bool open_new_blocks(int& container, bool all_matched);
+    bool add_text(int container, int last_matched);
+    int add_child(int parent, Kind kind, size_t start_column);
+    int finalize(int b);
+    void add_line(int b);
+    bool chop_trailing_hashes();
+
+    size_t scan_atx_heading(size_t p) const;
+    size_t scan_open_fence(size_t p) const;
+    size_t scan_close_fence(size_t p) const;
+    bool scan_setext_line(size_t p) const;
+    size_t scan_thematic_break(size_t p) const;
+    size_t parse_list_marker(size_t p, bool interrupts_paragraph,
+                             Block& data) const;
+
+    bool convert(int b, ASTNode& out);
+    std::string_view content(Block const& b);
+
+    std::string_view _input;
+    std::vector<size_t> _starts;
+    std::vector<Block> _blocks;
+    std::vector<Piece> _pieces;
+    std::string _scratch;
+    InlineParser _inlines;
+    bool _failed = false;
+
+    std::string_view _line;   // current line without its '\n'
+    size_t _base = 0;         // its offset in the input
+    size_t _len = 0;          // cmark's input.len: line plus '\n'
+    size_t _offset = 0;
+    size_t _first_nonspace = 0;
+    size_t _indent = 0;
+    bool _blank = false;
+    bool _in_line = false;    // cmark: curline.size != 0
+    int _line_number = 0;
+    size_t _last_line_length = 0;
+    int _current = 0;
+};
+
+bool accepts_lines(Kind kind) {
+    return kind == Kind::Paragraph || kind == Kind::Heading ||
+           kind == Kind::CodeBlock;
+}
+
+bool can_contain(Kind parent, Kind child) {
+    switch (parent) {
+    case Kind::Document:
+    case Kind::BlockQuote:
+    case Kind::Item:
+        return child != Kind::Item;
+    case Kind::List:
+        return child == Kind::Item;
+    default:
+        return false;
+    }
+}
+
+int BlockParser::add_child(int parent, Kind kind, size_t start_column) {
+    while (!can_contain(_blocks[parent].kind, kind)) parent = finalize(parent);
+    if (_blocks[parent].depth >= kMaxContainerDepth) _failed = true;
+    Block b;
+    b.kind = kind;
+    b.parent = parent;
+    b.depth = _blocks[parent].depth + 1;
+    b.start_line = _line_number;
+    b.start_column = start_column;
+    _blocks.push_back(b);
+    int child = static_cast<int>(_blocks.size() - 1);
+    auto& p = _blocks[parent];
+    if (p.last >= 0) _blocks[p.last].next = child; else p.first = child;
+    p.last = child;
+    return child;
+}
+
+int BlockParser::finalize(int index) {
+    auto& b = _blocks[index];
+    b.open = false;
+    if (!_in_line) {
+        b.end_line = _line_number;
+        b.end_column = _last_line_length;
+    } else if (b.kind == Kind::Document || b.kind == Kind::CodeBlock) {
+        // Fenced code ends on the current line (its closing fence).
+        b.end_line = _line_number;
+        b.end_column = _line.size();
+    } else {
+        b.end_line = _line_number - 1;
+        b.end_column = _last_line_length;
+    }
+    return b.parent;
+}
+
+void BlockParser::add_line(int index) {
+    auto& b = _blocks[index];
+    if (b.piece_begin == b.piece_end) b.piece_begin = _pieces.size();
+    size_t end = std::min(_len, _line.size());
+    size_t begin = std::min(_offset, end);
+    _pieces.push_back(Piece{_base + begin, _base + end, _len > _line.size()});
+    b.piece_end = _pieces.size();
+}
+
+// chop_trailing_hashtags() on an ATX heading line.  Returns false where
+// cmark's result depends on reading past the content.
+bool BlockParser::chop_trailing_hashes() {
+    auto rtrim = [&] {
+        while (_len > 0 && is_space(peek(_len - 1))) --_len;
+    };
+    rtrim();
+    size_t n = _len;
+    while (n > 0 && peek(n - 1) == '#') --n;
+    if (n != _len && n > 0 && peek(n - 1) == ' ') {
+        _len = n - 1;
+        rtrim();
+    }
+    return _len > _offset;
+}
+
+size_t BlockParser::scan_atx_heading(size_t p) const {
+    size_t i = p;
+    while (i - p < 7 && peek(i) == '#') ++i;
+    size_t level = i - p;
+    if (level < 1 || level > 6) return 0;
+    if (peek(i) == '\n') return level + 1;
+    if (peek(i) != ' ') return 0;
+    while (peek(i) == ' ') ++i;
+    return i - p;
+}
+
+size_t BlockParser::scan_open_fence(size_t p) const {
+    char c = peek(p);
+    if (c != '`' && c != '~') return 0;
+    size_t i = p;
+    while (peek(i) == c) ++i;
+    if (i - p < 3) return 0;
+    if (c == '`') {
+        for (size_t j = i; peek(j) != '\n'; ++j) {
+            if (peek(j) == '`') return 0;
+        }
+    }
+    return i - p;
+}
+
+size_t BlockParser::scan_close_fence(size_t p) const {
+    char c = peek(p);
+    if (c != '`' && c != '~') return 0;
+    size_t i = p;
+    while (peek(i) == c) ++i;
+    size_t run = i - p;
+    if (run < 3) return 0;
+    while (peek(i) == ' ') ++i;
+    return peek(i) == '\n' ? run : 0;
+}
+
+bool BlockParser::scan_setext_line(size_t p) const {
+    char c = peek(p);
+    if (c != '=' && c != '-') return false;
+    size_t i = p;
+    while (peek(i) == c) ++i;
+    while (peek(i) == ' ') ++i;
+    return peek(i) == '\n';
+}
+
+size_t BlockParser::scan_thematic_break(size_t p) const {
+    char c = peek(p);
+    if (c != '*' && c != '_' && c != '-') return 0;
+    size_t count = 1;
+    size_t i = p + 1;
+    char next = 0;
+    for (; (next = peek(i)); ++i) {
+        if (next == c) {
+            ++count;
+        } else if (next != ' ') {
+            break;
+        }
+    }
+    return count >= 3 && next == '\n' ? i - p + 1 : 0;
+}
+
+size_t BlockParser::parse_list_marker(size_t p, bool interrupts_paragraph,
+                                      Block& data) const {
+    size_t i = p;
+    char c = peek(i);
+    auto content_follows = [&](size_t j) {
+        while (peek(j) == ' ') ++j;
+        return peek(j) != '\n';
+    };
+    if (c == '*' || c == '-' || c == '+') {
+        ++i;
+        if (!is_space(peek(i))) return 0;
+        if (interrupts_paragraph && !content_follows(i)) return 0;
+        data.ordered = false;
+        data.marker = c;
+        data.list_start = 1;
+        return i - p;
+    }
+    if (c < '0' || c > '9') return 0;
+    int start = 0;
+    int digits = 0;
+    do {
+        start = 10 * start + (peek(i) - '0');
+        ++i;
+        ++digits;
+    } while (digits < 9 && peek(i) >= '0' && peek(i) <= '9');
+    if (interrupts_paragraph && start != 1) return 0;
+    c = peek(i);
+    if (c != '.' && c != ')') return 0;
+    ++i;
+    if (!is_space(peek(i))) return 0;
+    if (interrupts_paragraph && !content_follows(i)) return 0;
+    data.ordered = true;
+    data.marker = c;
+    data.list_start = start;
+    return i - p;
+}
+
+// Match the current line against the open containers.  Returns the last
+// one matched, or -1 if the line was consumed (a closing fence).
+int BlockParser::check_open_blocks(bool& all_matched) {
+    all_matched = true;
+    int container = 0;
+    for (;;) {
+        int last = _blocks[container].last;
+        if (last < 0 || !_blocks[last].open) return container;
+        container = last;
+        auto& b = _blocks[container];
+        find_first_nonspace();
+        bool matched = true;
+        switch (b.kind) {
+        case Kind::BlockQuote:
+            matched = _indent <= 3 && peek(_first_nonspace) == '>';
+            if (matched) {
+                _offset += _indent + 1;
+                if (peek(_offset) == ' ') ++_offset;
+            }
+            break;
+        case Kind::Item:
+            if (_indent >= b.marker_offset + b.padding) {
+                _offset += b.marker_offset + b.padding;
+            } else if (_blank && b.first >= 0) {
+                _offset = _first_nonspace;
+            } else {
+                matched = false;
+            }
+            break;
+        case Kind::CodeBlock: {
+            size_t fence = 0;
+            if (_indent <= 3 && peek(_first_nonspace) == b.fence_char) {
+                fence = scan_close_fence(_first_nonspace);
+            }
+            if (fence >= b.fence_length) {
+                _current = finalize(container);
+                return -1;
+            }
+            for (size_t i = b.fence_offset; i > 0 && peek(_offset) == ' ';
+                 --i) {
+                ++_offset;
+            }
+            break;
+        }
+        case Kind::Heading:
+            matched = false;
+            break;
+        case Kind::Paragraph:
+            matched = !_blank;
+            break;
+        default:
+            break;
+        }
+        if (!matched) {
+            all_matched = false;
+            return b.parent;
+        }
+    }
+}
+
+bool BlockParser::open_new_blocks(int& container, bool all_matched) {
+    bool maybe_lazy = _blocks[_current].kind == Kind::Paragraph;
+    Kind cont_type = _blocks[container].kind;
+    while (cont_type != Kind::CodeBlock) {
+        find_first_nonspace();
+        bool indented = _indent >= 4;
+        size_t fns = _first_nonspace;
+        size_t matched = 0;
+        Block data;
+        if (!indented && peek(fns) == '>') {
+            _offset = fns + 1;
+            if (peek(_offset) == ' ') ++_offset;
+            container = add_child(container, Kind::BlockQuote, fns + 1);
+        } else if (!indented && (matched = scan_atx_heading(fns))) {
+            // Empty headings: cmark reads past the line there.
+            if (peek(fns + matched) == '\n' || peek(fns + matched - 1) == '\n') {
+                return false;
+            }
+            _offset = fns + matched;
+            container = add_child(container, Kind::Heading, fns + 1);
+            int level = 0;
+            while (peek(fns + static_cast<size_t>(level)) == '#') ++level;
+            _blocks[container].level = level;
+        } else if (!indented && (matched = scan_open_fence(fns))) {
+            container = add_child(container, Kind::CodeBlock, fns + 1);
+            auto& b = _blocks[container];
+            b.fence_char = peek(fns);
+            b.fence_length = std::min<size_t>(matched, 255);
+            b.fence_offset = fns - _offset;
+            _offset = fns + matched;
+        } else if (!indented && cont_type == Kind::Paragraph &&
+                   scan_setext_line(fns)) {
+            return false;  // setext headings are not ported
+        } else if (!indented &&
+                   !(cont_type == Kind::Paragraph && !all_matched) &&
+                   scan_thematic_break(fns)) {
+            container = add_child(container, Kind::ThematicBreak, fns + 1);
+            _offset = _len - 1;
+        } else if ((!indented || cont_type == Kind::List) && _indent < 4 &&
+                   (matched = parse_list_marker(
+                        fns, _blocks[container].kind == Kind::Paragraph,
+                        data))) {
+            _offset = fns + matched;
+            size_t save = _offset;
+            while (_offset - save <= 5 && peek(_offset) == ' ') ++_offset;
+            size_t spaces = _offset - save;
+            if (spaces >= 5 || spaces < 1 || peek(_offset) == '\n') {
+                data.padding = matched + 1;
+                _offset = save;
+                if (spaces > 0) ++_offset;
+            } else {
+                data.padding = matched + spaces;
+            }
+            data.marker_offset = _indent;
+            auto const& cont = _blocks[container];
+            if (cont_type != Kind::List || cont.ordered != data.ordered ||
+                cont.marker != data.marker) {
+                container = add_child(container, Kind::List, fns + 1);
+                auto& list = _blocks[container];
+                list.ordered = data.ordered;
+                list.marker = data.marker;
+                list.list_start = data.list_start;
+            }
+            container = add_child(container, Kind::Item, fns + 1);
+            auto& item = _blocks[container];
+            item.marker_offset = data.marker_offset;
+            item.padding = data.padding;
+        } else if (indented && !maybe_lazy && !_blank) {
+            return false;  // indented code is not ported
+        } else {
+            break;
+        }
+        if (accepts_lines(_blocks[container].kind)) break;
+        cont_type = _blocks[container].kind;
+        maybe_lazy = false;
+    }
+    return true;
+}
+
+bool BlockParser::add_text(int container, int last_matched) {
+    find_first_nonspace();
+    if (_current != last_matched && container == last_matched && !_blank &&
+        _blocks[_current].kind == Kind::Paragraph) {
+        add_line(_current);  // lazy continuation
+        return true;
+    }
+    while (_current != last_matched) _current = finalize(_current);
+
+    Kind kind = _blocks[container].kind;
+    if (kind == Kind::CodeBlock) {
+        add_line(container);
+    } else if (_blank) {
+        // nothing to add
+    } else if (accepts_lines(kind)) {
+        if (kind == Kind::Heading && !chop_trailing_hashes()) return false;
+        _offset = _first_nonspace;
+        add_line(container);
+    } else {
+        container = add_child(container, Kind::Paragraph, _first_nonspace + 1);
+        _offset = _first_nonspace;
+        add_line(container);
+    }
+    _current = container;
+    return true;
+}
+
+// S_process_line() for input[begin, end), end excluding the '\n'.
+bool BlockParser::process_line(size_t begin, size_t end) {
+    _line = _input.substr(begin, end - begin);
+    _base = begin;
+    _len = _line.size() + 1;
+    _offset = 0;
+    _first_nonspace = 0;
+    _indent = 0;
+    _blank = false;
+    _in_line = true;
+    ++_line_number;
+
+    bool all_matched = true;
+    int last_matched = check_open_blocks(all_matched);
+    if (last_matched >= 0) {
+        int container = last_matched;
+        if (!open_new_blocks(container, all_matched) ||
+            !add_text(container, last_matched)) {
+            return false;
+        }
+    }
+    _last_line_length = std::min(_len, _line.size());
+    _in_line = false;
+    return !_failed;
+}
+
+// A leaf block's content as one string: a slice of the input when its
+// lines are contiguous there, else assembled in _scratch.
+std::string_view BlockParser::content(Block const& b) {
+    if (b.piece_begin == b.piece_end) return {};
+    auto const* first = &_pieces[b.piece_begin];
+    auto const* last = &_pieces[b.piece_end - 1];
+    bool contiguous = true;
+    for (auto const* p = first; p < last; ++p) {
+        if (!p->newline || p[1].begin != p->end + 1) {
+            contiguous = false;
+            break;
+        }
+    }
+    if (contiguous) {
+        return _input.substr(first->begin, last->end - first->begin);
+    }
+    _scratch.clear();
+    for (auto const* p = first; p <= last; ++p) {
+        _scratch.append(_input.substr(p->begin, p->end - p->begin));
+        if (p->newline) _scratch += '\n';
+    }
+    return _scratch;
+}
+
+bool BlockParser::convert(int index, ASTNode& out) {
+    auto const& b = _blocks[index];
+    auto offset = [&](int line, size_t column) {
+        if (line < 1) return size_t{0};
+        auto idx = std::min(static_cast<size_t>(line - 1), _starts.size() - 1);
+        return std::min(_starts[idx] + column, _input.size());
+    };
+    out.source_begin = offset(b.start_line, b.start_column - 1);
+    out.source_end = std::max(offset(b.end_line, b.end_column),
+                              out.source_begin);
+
+    switch (b.kind) {
+    case Kind::Document:
+        out.type = NodeType::Document;
+        break;
+    case Kind::BlockQuote:
+        out.type = NodeType::BlockQuote;
+        break;
+    case Kind::List:
+        out.type = b.ordered ? NodeType::OrderedList : NodeType::BulletList;
+        if (b.ordered) out.list_start = b.list_start;
+        break;
+    case Kind::Item:
+        out.type = NodeType::ListItem;
+        break;
+    case Kind::ThematicBreak:
+        out.type = NodeType::ThematicBreak;
+        seal_hash(out);
+        return true;
+    case Kind::CodeBlock: {
+        out.type = NodeType::CodeBlock;
+        // The first line is the info string; the rest is the literal.
+        auto const& info = _pieces[b.piece_begin];
+        auto raw = trim(_input.substr(info.begin, info.end - info.begin));
+        for (size_t amp = raw.find('&'); amp != std::string_view::npos;
+             amp = raw.find('&', amp + 1)) {
+            if (may_be_entity(raw.substr(amp + 1))) return false;
+        }
+        out.info = unescape(raw);
+        for (size_t i = b.piece_begin + 1; i < b.piece_end; ++i) {
+            auto const& p = _pieces[i];
+            out.text.append(_input.substr(p.begin, p.end - p.begin));
+            if (p.newline) out.text += '\n';
+        }
+        normalize_emoji_width_in_place(out.text);
+        seal_hash(out);
+        return true;
+    }
+    case Kind::Paragraph:
+    case Kind::Heading: {
+        out.type = b.kind == Kind::Heading ? NodeType::Heading
+                                           : NodeType::Paragraph;
+        out.level = b.level;
+        auto subject = content(b);
+        while (!subject.empty() && is_space(subject.back())) {
+            subject.remove_suffix(1);
+        }
+        if (!_inlines.parse(subject, out)) return false;
+        seal_hash(out);
+        return true;
+    }
+    }
+
+    size_t count = 0;
+    for (int c = b.first; c >= 0; c = _blocks[c].next) ++count;
+    out.children.reserve(count);
+    for (int c = b.first; c >= 0; c = _blocks[c].next) {
+        if (!convert(c, out.children.emplace_back())) return false;
+    }
+    seal_hash(out);
+    return true;
+}
+
+bool BlockParser::parse(std::string_view input, MarkdownAST& out) {
+    // A BOM, or "]:" anywhere (a possible reference definition), is left
+    // to cmark.
+    if (input.size() >= 3 && input.substr(0, 3) == "\xEF\xBB\xBF") {
+        return false;
+    }
+    if (input.find("]:") != std::string_view::npos) return false;
+    if (!index_lines(input, _starts)) return false;
+
+    _input = input;
+    _blocks.clear();
+    _pieces.clear();
+    _blocks.emplace_back();
+    _current = 0;
+    _failed = false;
+    _line_number = 0;
+    _last_line_length = 0;
+
+    for (size_t i = 0; i < _starts.size(); ++i) {
+        size_t begin = _starts[i];
+        if (begin == input.size()) break;  // nothing after the last '\n'
+        size_t end = i + 1 < _starts.size() ? _starts[i + 1] - 1
+                                            : input.size();
+        if (!process_line(begin, end)) return false;
+    }
+    _in_line = false;
+    while (_current != 0) _current = finalize(_current);
+    finalize(0);
+
+    out = ASTNode{};
+    if (!convert(0, out)) return false;
+    out.source_begin = 0;
+    out.source_end = input.size();
+    return true;
+}
+
+class FastParser : public MarkdownParser {
+public:
+    FastParser() : _fallback(make_cmark_parser()) {}
+
+    bool parse(std::string_view input, MarkdownAST& out) override {
+        if (_blocks.parse(input, out)) return true;
+        return _fallback->parse(input, out);
+    }
+
+    // The subset parser is linear and cheap; only cmark needs the limits.
+    ParseStatus parse(std::string_view input, MarkdownAST& out,
+                      ParseLimits const& limits) override {
+        if (_blocks.parse(input, out)) return ParseStatus::Complete;
+        return _fallback->parse(input, out, limits);
+    }
+
+    bool parse(std::string_view input, FlatAST& out) override {
+        MarkdownAST ast;
+        if (_blocks.parse(input, ast)) {
+            flatten(ast, out);
+            return true;
+        }
+        return _fallback->parse(input, out);
+    }
+
+private:
+    BlockParser _blocks;
+    std::unique_ptr<MarkdownParser> _fallback;
+};
+
+} // namespace
+
+namespace detail {
+bool parse_fast(std::string_view input, MarkdownAST& out) {
+    BlockParser parser;
+    return parser.parse(input, out);
+}
+} // namespace detail
+
+std::unique_ptr<MarkdownParser> make_fast_parser() {
+    return std::make_unique<FastParser>();
+}
+
+} // namespace markdown
@@ -0,0 +1,102 @@
+#include "markdown/text_buffer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace markdown {
+namespace {
+
+uint64_t next_version() {
+    static std::atomic<uint64_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+} // namespace
+
+TextEdit diff_text(std::string_view old, std::string_view text) {
+    size_t limit = std::min(old.size(), text.size());
+    size_t prefix = 0;
+    while (prefix < limit && old[prefix] == text[prefix]) ++prefix;
+    size_t suffix = 0;
+    while (suffix < limit - prefix &&
+           old[old.size() - 1 - suffix] == text[text.size() - 1 - suffix]) {
+        ++suffix;
+    }
+    return {.offset = prefix,
+            .removed = old.size() - prefix - suffix,
+            .inserted = text.size() - prefix - suffix};
+}
+
+// Append-only bytes.  used is the end of the longest text written so far;
+// a buffer may write past it only after claiming the range by moving used
+// from its own size, so no two buffers write the same bytes and no byte
+// changes once a buffer covers it.
+struct TextBuffer::Storage {
+    std::unique_ptr<char[]> data;
+    size_t capacity = 0;
+    std::atomic<size_t> used{0};
+
+    static std::shared_ptr<Storage> make(std::string_view text,
+                                         size_t capacity) {
+        auto storage = std::make_shared<Storage>();
+        storage->data = std::make_unique_for_overwrite<char[]>(capacity);
+        storage->capacity = capacity;
+        std::memcpy(storage->data.get(), text.data(), text.size());
+        storage->used.store(text.size(), std::memory_order_relaxed);
+        return storage;
+    }
+};
+
+TextBuffer::TextBuffer(std::string_view text)
+    : _storage(Storage::make(text, text.size())),
+      _data(_storage->data.get()),
+      _size(text.size()),
+      _version(next_version()) {}
+
+TextBuffer::TextBuffer(std::string_view text, TextBuffer const& base)
+    : TextBuffer(text) {
+    _base_version = base._version;
+    _edit = diff_text(base.view(), text);
+}
+
+void TextBuffer::append(std::string_view more) {
+    if (more.empty()) return;
+    size_t expected = _size;
+    if (_storage && more.size() <= _storage->capacity - _size &&
+        _storage->used.compare_exchange_strong(expected,
+                                               _size + more.size(),
+                                               std::memory_order_relaxed)) {
+        std::memcpy(_storage->data.get() + _size, more.data(), more.size());
+    } else {
+        size_t size = _size + more.size();
+        auto storage = Storage::make(view(), std::max<size_t>(2 * size, 64));
+        std::memcpy(storage->data.get() + _size, more.data(), more.size());
+        storage->used.store(size, std::memory_order_relaxed);
+        _storage = std::move(storage);
+        _data = _storage->data.get();
+    }
+    _base_version = _version;
+    _edit = {.offset = _size, .removed = 0, .inserted = more.size()};
+    _size += more.size();
+    _version = next_version();
+}
+
+std::optional<TextEdit> TextBuffer::edit_from(TextBuffer const& base) const {
+    if (base._version == _version) return TextEdit{.offset = _size};
+    if (_base_version != 0 && base._version == _base_version) return _edit;
+    if ((base._storage == _storage && base._size <= _size) || base.empty()) {
+        return TextEdit{.offset = base._size,
+                        .inserted = _size - base._size};
+    }
+    return std::nullopt;
+}
+
+bool TextBuffer::extends(TextBuffer const& base) const {
+    if (auto edit = edit_from(base)) {
+        return edit->removed == 0 && edit->offset == base._size;
+    }
+    return view().starts_with(base.view());
+}
+
+} // namespace markdown
@@ -2,23 +2,300 @@
 #include "markdown/scroll_frame.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <memory>
 
 #include <ftxui/component/event.hpp>
 #include <ftxui/component/mouse.hpp>
+#include <ftxui/component/screen_interactive.hpp>
 #include <ftxui/screen/box.hpp>
 #include <ftxui/screen/screen.hpp>
 
 namespace markdown {
 
+// A parse/build request: a snapshot of everything the element depends on.
+struct Viewer::AsyncJob {
+    bool stop = false;
+    uint64_t content_gen = 0;
+    TextBuffer content;  // shared with the Viewer, not copied
+    std::stop_token cancel;  // triggered once newer content is sent
+    bool incremental = false;
+    Theme theme = theme_default();
+    uint64_t theme_gen = 0;
+    uint64_t builder_gen = 0;
+    int max_quote_depth = 0;
+    bool line_layout = false;
+    bool virtual_blocks = false;
+    unsigned build_threads = 1;
+    ftxui::ScreenInteractive* screen = nullptr;
+};
+
+// A finished build.  The builder travels with its element: the element's
+// reflect boxes point into the builder's link targets.
+struct Viewer::AsyncResult {
+    uint64_t content_gen = 0;
+    uint64_t theme_gen = 0;
+    uint64_t builder_gen = 0;
+    DomBuilder builder;
+    DocumentIndex index;  // of the AST the element was built from
+    ftxui::Element element;
+};
+
+namespace {
+
+// The settings a Viewer forwards to its DomBuilder.
+void copy_settings(DomBuilder const& from, DomBuilder& to) {
+    to.set_max_quote_depth(from.max_quote_depth());
+    to.set_line_layout(from.line_layout());
+    to.set_virtual_blocks(from.virtual_blocks());
+    to.set_build_threads(from.build_threads());
+}
+
+} // namespace
+
 Viewer::Viewer(std::unique_ptr<MarkdownParser> parser)
     : _parser(std::move(parser)) {}
 
+Viewer::~Viewer() {
+    stop_worker();
+}
+
 void Viewer::set_content(std::string_view markdown_text) {
-    _content.assign(markdown_text.data(), markdown_text.size());
+    set_content(TextBuffer(markdown_text, _content));
+}
+
+void Viewer::set_content(TextBuffer content) {
+    if (content.version() == _content.version()) return;
+    _content = std::move(content);
+    _only_appended = false;
+    ++_content_gen;
+}
+
+void Viewer::append_content(std::string_view markdown_text) {
+    if (markdown_text.empty()) return;
+    _content.append(markdown_text);
     ++_content_gen;
 }
 
+void Viewer::set_incremental(bool on) {
+    _incremental = on;
+    // In async mode the reparser belongs to the worker; jobs carry the flag.
+    if (!_async) _reparser.reset();
+}
+
+void Viewer::set_async(bool on) {
+    if (on == _async) return;
+    _async = on;
+    _job_sent = false;
+    if (on) return;  // the worker starts with the first render
+    stop_worker();
+    // Continue synchronously from the worker's AST; the element on screen
+    // may be older than it, so rebuild from scratch.
+    _parsed_gen = _worker_parsed_gen;
+    _index.build(_cached_ast);
+    _only_appended = false;
+    ++_builder_gen;
+}
+
+void Viewer::stop_worker() {
+    if (!_worker.joinable()) return;
+    _job_cancel.request_stop();
+    delete _job.exchange(new AsyncJob{.stop = true});
+    _job.notify_one();
+    _worker.join();
+    _job_cancel = std::stop_source();
+    delete _job.exchange(nullptr);
+    delete _result.exchange(nullptr);
+    delete _spare.exchange(nullptr);
+}
+
+void Viewer::worker_loop() {
+    bool parsed = false;
+    bool ast_dirty = false;  // parsed since the last published build
+    bool built = false;
+    uint64_t built_theme_gen = 0;
+    uint64_t built_builder_gen = 0;
+    for (;;) {
+        _job.wait(nullptr);
+        std::unique_ptr<AsyncJob> job(_job.exchange(nullptr));
+        if (!job) continue;
+        if (job->stop) return;
+
+        if (!parsed || job->content_gen != _worker_parsed_gen) {
+            auto const& text = job->content;
+            // Full parses, whichever call makes them, stop for newer
+            // content; an invalid reparser always parses in full.
+            ParseLimits limits{.stop = job->cancel};
+            if (_reparser.valid() && text.extends(_reparser.buffer())) {
+                _reparser.append(*_parser, text, _cached_ast, limits);
+                ast_dirty |= _reparser.last_was_full() ||
+                             _reparser.last_reparsed_bytes() > 0;
+            } else {
+                if (!job->incremental) _reparser.reset();
+                _reparser.update(*_parser, text, _cached_ast, limits);
+                ast_dirty = true;
+            }
+            // Cancelled for newer content, which is waiting in _job.
+            if (_reparser.last_partial()) {
+                parsed = false;
+                continue;
+            }
+            parsed = true;
+            _worker_parsed_gen = job->content_gen;
+        }
+
+        // A newer request arrived while parsing: build that one instead.
+        if (_job.load() != nullptr) continue;
+        // Nothing the element depends on changed (e.g. set_content() with
+        // the same text): publishing would only trigger another redraw.
+        if (built && !ast_dirty && job->theme_gen == built_theme_gen &&
+            job->builder_gen == built_builder_gen) {
+            continue;
+        }
+
+        // Reuse the result the UI thread handed back, so the previous
+        // element tree is released here rather than on the UI thread.
+        std::unique_ptr<AsyncResult> result(_spare.exchange(nullptr));
+        if (!result) result = std::make_unique<AsyncResult>();
+        result->builder.set_max_quote_depth(job->max_quote_depth);
+        result->builder.set_line_layout(job->line_layout);
+        result->builder.set_virtual_blocks(job->virtual_blocks);
+        result->builder.set_build_threads(job->build_threads);
+        result->element = result->builder.build(_cached_ast, -1, job->theme);
+        result->index.build(_cached_ast);
+        result->content_gen = job->content_gen;
+        result->theme_gen = job->theme_gen;
+        result->builder_gen = job->builder_gen;
+        built = true;
+        ast_dirty = false;
+        built_theme_gen = job->theme_gen;
+        built_builder_gen = job->builder_gen;
+
+        delete _result.exchange(result.release());
+        if (job->screen) job->screen->PostEvent(ftxui::Event::Custom);
+    }
+}
+
+void Viewer::clamp_focus() {
+    int total = static_cast<int>(_builder.link_targets().size());
+    if (_focus_index >= total) {
+        _focus_index = total > 0 ? total - 1 : -1;
+    }
+    _focused_link = _focus_index;
+    // Flips the focus flags read by the link elements; no rebuild.
+    _builder.set_focus(_focused_link);
+}
+
+// Parse only when content changes
+void Viewer::parse_sync() {
+    if (_content_gen != _parsed_gen) {
+        // The budget bounds full parses, whichever call makes them.  A
+        // partial AST leaves the reparser invalid, so the next call parses
+        // in full again.
+        ParseLimits limits;
+        if (_parse_budget.count() > 0) {
+            limits = ParseLimits::within(_parse_budget);
+        }
+        if (_only_appended) {
+            _reparser.append(*_parser, _content, _cached_ast, limits);
+        } else {
+            if (!_incremental) _reparser.reset();
+            _reparser.update(*_parser, _content, _cached_ast, limits);
+        }
+        _parse_partial = _reparser.last_partial();
+        _index.build(_cached_ast);
+        _only_appended = true;
+        _parsed_gen = _content_gen;
+    }
+}
+
+void Viewer::render_sync() {
+    auto start = std::chrono::steady_clock::now();
+    bool updated = _content_gen != _parsed_gen;
+    parse_sync();
+
+    clamp_focus();
+
+    // Rebuild element when content, theme, or builder config changes.
+    // Blocks built before with the same content and theme come from the
+    // builder's memo.
+    if (_parsed_gen != _built_gen ||
+        _theme_gen != _built_theme_gen ||
+        _builder_gen != _built_builder_gen) {
+        // Shared, not owned: every parse that changes _cached_ast is
+        // followed by this build before the next layout, so virtual
+        // blocks never read it mid-change.  The worker's builds copy it.
+        std::shared_ptr<MarkdownAST const> ast(
+            std::shared_ptr<MarkdownAST const>(), &_cached_ast);
+        _cached_element = _builder.build(std::move(ast), _focused_link,
+                                         _theme);
+        _built_gen = _parsed_gen;
+        _built_theme_gen = _theme_gen;
+        _built_builder_gen = _builder_gen;
+        updated = true;
+    }
+
+    if (updated) {
+        _update_cost = std::chrono::steady_clock::now() - start;
+        ++_update_count;
+    }
+}
+
+void Viewer::render_async() {
+    if (!_worker.joinable()) {
+        _worker = std::thread([this] { worker_loop(); });
+    }
+
+    // Adopt the newest finished build.  Swapping DomBuilders moves their
+    // link box buffers without reallocating, so the reflect pointers held
+    // by the element stay valid.
+    if (auto* result = _result.exchange(nullptr)) {
+        std::swap(_builder, result->builder);
+        // The worker's builder has the settings of its job; keep ours, which
+        // may have changed since.
+        copy_settings(result->builder, _builder);
+        std::swap(_index, result->index);
+        std::swap(_cached_element, result->element);
+        _built_gen = result->content_gen;
+        _built_theme_gen = result->theme_gen;
+        _built_builder_gen = result->builder_gen;
+        delete _spare.exchange(result);
+    }
+
+    clamp_focus();
+
+    // Request a build when anything the element depends on changed since
+    // the last request.  An unclaimed older request is dropped.
+    if (!_job_sent || _content_gen != _sent_content_gen ||
+        _theme_gen != _sent_theme_gen ||
+        _builder_gen != _sent_builder_gen) {
+        if (_content_gen != _sent_content_gen) {
+            _job_cancel.request_stop();
+            _job_cancel = std::stop_source();
+        }
+        auto* job = new AsyncJob{
+            .content_gen = _content_gen,
+            .content = _content,
+            .cancel = _job_cancel.get_token(),
+            .incremental = _incremental,
+            .theme = _theme,
+            .theme_gen = _theme_gen,
+            .builder_gen = _builder_gen,
+            .max_quote_depth = _builder.max_quote_depth(),
+            .line_layout = _builder.line_layout(),
+            .virtual_blocks = _builder.virtual_blocks(),
+            .build_threads = _builder.build_threads(),
+            .screen = ftxui::ScreenInteractive::Active(),
+        };
+        delete _job.exchange(job);
+        _job.notify_one();
+        _job_sent = true;
+        _sent_content_gen = _content_gen;
+        _sent_theme_gen = _theme_gen;
+        _sent_builder_gen = _builder_gen;
+    }
+}
+
 void Viewer::set_scroll(float ratio) {
     _scroll_ratio = ratio;
 }
@@ -37,7 +314,9 @@ void Viewer::on_tab_exit(std::function<void(int direction)> callback) {
 }
 
 bool Viewer::enter_focus(int direction) {
-    int total = static_cast<int>(_builder.link_targets().size());
+    // The index knows the links before the first build does.
+    if (!_async) parse_sync();
+    int total = static_cast<int>(_index.links().size());
     if (total == 0) return false;
     _active = true;
     _focus_index = (direction > 0) ? 0 : total - 1;
@@ -50,9 +329,9 @@ bool Viewer::enter_focus(int direction) {
 
 std::string Viewer::focused_value() const {
     if (_focus_index < 0) return {};
-    auto const& targets = _builder.link_targets();
-    if (_focus_index < static_cast<int>(targets.size()))
-        return targets[_focus_index].url;
+    auto const& links = _index.links();
+    if (_focus_index < static_cast<int>(links.size()))
+        return links[_focus_index].url;
     return {};
 }
 
@@ -76,6 +355,18 @@ void Viewer::scroll_to_focus() {
     auto const& targets = _builder.link_targets();
     if (_focus_index >= static_cast<int>(targets.size())) return;
     auto const& boxes = targets[_focus_index].boxes;
+    if (_builder.virtual_blocks() &&
+        (boxes.empty() || boxes[0].y_max < boxes[0].y_min)) {
+        // Its block is not laid out, maybe not even built: bring the
+        // block into view, and the link with it.
+        auto const& links = _index.links();
+        if (_focus_index < static_cast<int>(links.size()) &&
+            links[_focus_index].block < _builder.block_count()) {
+            scroll_to_source(
+                _builder.block_source_begin(links[_focus_index].block));
+        }
+        return;
+    }
     if (boxes.empty()) return;
     auto const& lb = boxes[0];
     int scrollable = si.content_height - si.viewport_height;
@@ -95,6 +386,92 @@ void Viewer::scroll_to_focus() {
 
 namespace {
 
+// Rows DirectScrollFrame can scroll by; the ratio is a fraction of these.
+int frame_scrollable(ScrollInfo const& si) {
+    return std::max(0, si.content_height - si.viewport_height - 1);
+}
+
+} // namespace
+
+int Viewer::source_row(size_t offset) const {
+    auto const& si = _ext_scroll_info ? *_ext_scroll_info : _scroll_info;
+    if (si.viewport_height <= 0 || _builder.block_count() == 0) return -1;
+    int block = std::max(_builder.block_at_source(offset), 0);
+    auto const& box = _builder.block_box(static_cast<size_t>(block));
+    size_t begin = _builder.block_source_begin(static_cast<size_t>(block));
+    size_t end = _builder.block_source_end(static_cast<size_t>(block));
+    float within = 0.0f;
+    if (end > begin && offset > begin) {
+        within = std::min(1.0f, static_cast<float>(offset - begin) /
+                                    static_cast<float>(end - begin));
+    }
+    // The offset DirectScrollFrame applied in that layout; the ratio may
+    // have moved since, e.g. by a jump not yet rendered.
+    int dy = static_cast<int>(_layout_ratio *
+                              static_cast<float>(frame_scrollable(si)));
+    int top = box.y_min - si.viewport_y_min + dy;
+    return top + static_cast<int>(within *
+                                  static_cast<float>(box.y_max - box.y_min));
+}
+
+bool Viewer::jump_to_heading(size_t i) {
+    auto const& headings = _index.headings();
+    if (i >= headings.size()) return false;
+    if (!scroll_to_source(headings[i].source_begin)) return false;
+    _jump_heading = static_cast<int>(i);
+    _jump_ratio = _scroll_ratio;
+    return true;
+}
+
+bool Viewer::next_heading(int direction) {
+    auto const& si = _ext_scroll_info ? *_ext_scroll_info : _scroll_info;
+    if (si.viewport_height <= 0 || _builder.block_count() == 0) return false;
+    int target = -1;
+    if (_jump_heading >= 0 && _scroll_ratio == _jump_ratio) {
+        // Still where the last jump left us, which the layout may not
+        // show yet, and which may not reach the anchor near the end.
+        target = _jump_heading + (direction > 0 ? 1 : -1);
+    } else {
+        int block = _builder.block_at_row(si.viewport_y_min +
+                                          si.viewport_height / 3);
+        if (block < 0) {
+            // Above the first block: only "next" can go anywhere.
+            if (direction > 0 && !_index.headings().empty()) target = 0;
+        } else if (direction > 0) {
+            target = _index.heading_after(static_cast<size_t>(block));
+        } else {
+            target = _index.heading_before(static_cast<size_t>(block));
+        }
+    }
+    if (target < 0) return false;
+    return jump_to_heading(static_cast<size_t>(target));
+}
+
+bool Viewer::follow_fragment(std::string_view url) {
+    int heading = _index.resolve_fragment(url);
+    if (heading < 0) return false;
+    jump_to_heading(static_cast<size_t>(heading));
+    return true;
+}
+
+bool Viewer::scroll_to_source(size_t offset) {
+    int row = source_row(offset);
+    if (row < 0) return false;
+    auto const& si = _ext_scroll_info ? *_ext_scroll_info : _scroll_info;
+    int scrollable = frame_scrollable(si);
+    if (scrollable <= 0) {
+        _scroll_ratio = 0.0f;
+        return true;
+    }
+    int target = row - si.viewport_height / 3;
+    _scroll_ratio = std::clamp(
+        static_cast<float>(target) / static_cast<float>(scrollable),
+        0.0f, 1.0f);
+    return true;
+}
+
+namespace {
+
 constexpr float kScrollArrowStep = 0.05f;
 constexpr float kScrollWheelStep = 0.05f;
 
@@ -111,6 +488,7 @@ class ViewerWrap : public ftxui::ComponentBase {
     ViewerKeys const& _keys;
     ScrollInfo const& _scroll_info;
     std::function<void()> _scroll_to_focus;
+    std::function<bool(std::string_view)> _follow_fragment;
 public:
     ViewerWrap(ftxui::Component child, bool& active, float& scroll,
                int& focus_index, DomBuilder& builder,
@@ -118,14 +496,16 @@ public:
                std::function<void(int)>& tab_exit_cb,
                ViewerKeys const& keys,
                ScrollInfo const& scroll_info,
-               std::function<void()> scroll_to_focus)
+               std::function<void()> scroll_to_focus,
+               std::function<bool(std::string_view)> follow_fragment)
         : _active(active), _scroll_ratio(scroll),
           _focus_index(focus_index), _builder(builder),
           _link_callback(link_cb),
           _tab_exit_callback(tab_exit_cb),
           _keys(keys),
           _scroll_info(scroll_info),
-          _scroll_to_focus(std::move(scroll_to_focus)) {
+          _scroll_to_focus(std::move(scroll_to_focus)),
+          _follow_fragment(std::move(follow_fragment)) {
         Add(std::move(child));
     }
 
@@ -235,9 +615,9 @@ private:
         if (_focus_index < 0) return;
         auto const& targets = _builder.link_targets();
         if (_focus_index >= static_cast<int>(targets.size())) return;
-        if (_link_callback) {
-            _link_callback(targets[_focus_index].url, event);
-        }
+        auto const& url = targets[_focus_index].url;
+        if (event == LinkEvent::Press && _follow_fragment(url)) return;
+        if (_link_callback) _link_callback(url, event);
     }
 };
 } // namespace
@@ -246,32 +626,15 @@ ftxui::Component Viewer::component() {
     if (_component) return _component;
 
     auto renderer = ftxui::Renderer([this] {
-        // Parse only when content changes
-        if (_content_gen != _parsed_gen) {
-            _cached_ast = _parser->parse(_content);
-            _parsed_gen = _content_gen;
-        }
-
-        // Clamp _focus_index to valid link range
-        int total = static_cast<int>(_builder.link_targets().size());
-        if (_focus_index >= total) {
-            _focus_index = total > 0 ? total - 1 : -1;
-        }
-        _focused_link = _focus_index;
-
-        // Rebuild element when content, focused link, theme, or builder config changes
-        if (_parsed_gen != _built_gen ||
-            _focused_link != _last_focused_link ||
-            _theme_gen != _built_theme_gen ||
-            _builder_gen != _built_builder_gen) {
-            _cached_element = _builder.build(_cached_ast, _focused_link,
-                                             _theme);
-            _built_gen = _parsed_gen;
-            _last_focused_link = _focused_link;
-            _built_theme_gen = _theme_gen;
-            _built_builder_gen = _builder_gen;
+        if (_async) {
+            render_async();
+        } else {
+            render_sync();
         }
         auto el = _cached_element;
+        _layout_ratio = _scroll_ratio;
+        _builder.set_viewport(_ext_scroll_info ? _ext_scroll_info
+                                               : &_scroll_info);
 
         // Embed mode: return raw element; caller handles framing.
         if (_embed) return el;
@@ -295,6 +658,7 @@ ftxui::Component Viewer::component() {
                 _focus_index = fb.link_index;
                 _active = true;
                 auto const& link = _builder.link_targets()[fb.link_index];
+                if (follow_fragment(link.url)) return true;
                 if (_link_callback) {
                     _link_callback(link.url, LinkEvent::Press);
                 }
@@ -309,7 +673,8 @@ ftxui::Component Viewer::component() {
         inner, _active, _scroll_ratio, _focus_index,
         _builder, _link_callback, _tab_exit_callback,
         _keys, _scroll_info,
-        [this] { scroll_to_focus(); });
+        [this] { scroll_to_focus(); },
+        [this](std::string_view url) { return follow_fragment(url); });
     return _component;
 }
 
@@ -0,0 +1,197 @@
+#include "markdown/virtual_list.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+#include <ftxui/dom/node.hpp>
+
+namespace markdown {
+namespace {
+
+// ftxui's own bound on layout passes.
+constexpr int kMaxIterations = 20;
+
+// Lays element out at the top of box, repeating while it asks for another
+// pass as ftxui::Render() would.  Returns its height.
+int lay_out(ftxui::Element const& element, ftxui::Box box) {
+    element->ComputeRequirement();
+    int height = element->requirement().min_y;
+    element->SetBox(
+        {box.x_min, box.x_max, box.y_min, box.y_min + height - 1});
+    ftxui::Node::Status status;
+    element->Check(&status);
+    while (status.need_iteration && status.iteration < kMaxIterations) {
+        element->ComputeRequirement();
+        height = element->requirement().min_y;
+        element->SetBox(
+            {box.x_min, box.x_max, box.y_min, box.y_min + height - 1});
+        status.need_iteration = false;
+        ++status.iteration;
+        element->Check(&status);
+    }
+    return height;
+}
+
+} // namespace
+
+void HeightIndex::assign(std::vector<int> heights) {
+    _heights = std::move(heights);
+    // Linear-time construction: each node passes its sum to its parent.
+    _tree.assign(_heights.size() + 1, 0);
+    for (size_t i = 1; i <= _heights.size(); ++i) {
+        _tree[i] += _heights[i - 1];
+        size_t parent = i + (i & (~i + 1));
+        if (parent <= _heights.size()) _tree[parent] += _tree[i];
+    }
+}
+
+void HeightIndex::set(size_t i, int height) {
+    int delta = height - _heights[i];
+    _heights[i] = height;
+    for (size_t k = i + 1; k < _tree.size(); k += k & (~k + 1)) {
+        _tree[k] += delta;
+    }
+}
+
+int HeightIndex::offset(size_t i) const {
+    int sum = 0;
+    for (size_t k = i; k > 0; k -= k & (~k + 1)) sum += _tree[k];
+    return sum;
+}
+
+size_t HeightIndex::find(int y) const {
+    if (y < 0) return 0;
+    // Descend the tree: pos ends on the last prefix not exceeding y.
+    size_t pos = 0;
+    int rest = y;
+    for (size_t step = std::bit_floor(_heights.size()); step > 0;
+         step >>= 1) {
+        if (pos + step < _tree.size() && _tree[pos + step] <= rest) {
+            pos += step;
+            rest -= _tree[pos];
+        }
+    }
+    return pos;
+}
+
+VirtualList::VirtualList(std::vector<int> estimates, Build build, int gap)
+    : _elements(estimates.size()), _build(std::move(build)), _gap(gap) {
+    for (size_t i = 0; i + 1 < estimates.size(); ++i) estimates[i] += gap;
+    _heights.assign(std::move(estimates));
+}
+
+ftxui::Element& VirtualList::element(size_t i) {
+    if (!_elements[i]) {
+        _elements[i] = _build(i);
+        _live.push_back(i);
+    }
+    return _elements[i];
+}
+
+int VirtualList::total_height() const {
+    return _heights.total();
+}
+
+ftxui::Box VirtualList::block_box(size_t i) const {
+    int y = _box.y_min + _heights.offset(i);
+    int height = _heights.height(i) - (i + 1 < size() ? _gap : 0);
+    return {_box.x_min, _box.x_max, y, y + height - 1};
+}
+
+int VirtualList::block_at_row(int y) const {
+    if (size() == 0 || y < _box.y_min) return -1;
+    return static_cast<int>(
+        std::min(_heights.find(y - _box.y_min), size() - 1));
+}
+
+bool VirtualList::layout(ftxui::Box box) {
+    _box = box;
+    int top = box.y_min;
+    int bottom = box.y_max;
+    if (_viewport && _viewport->viewport_height > 0) {
+        top = std::max(top, _viewport->viewport_y_min);
+        bottom = std::min(bottom, _viewport->viewport_y_min +
+                                      _viewport->viewport_height);
+    }
+    top -= kOverscan;
+    bottom += kOverscan;
+
+    bool changed = false;
+    size_t old_first = _first;
+    size_t old_last = _last;
+    _first = _heights.find(top - box.y_min);
+    int y = box.y_min + _heights.offset(_first);
+    size_t i = _first;
+    // Blocks are placed by the heights of those laid out before them in
+    // this pass, so a corrected estimate moves the rest along at once.
+    for (; i < size() && y <= bottom; ++i) {
+        int height = lay_out(element(i), {box.x_min, box.x_max, y, y});
+        if (i + 1 < size()) height += _gap;
+        if (height != _heights.height(i)) {
+            _heights.set(i, height);
+            changed = true;
+        }
+        y += height;
+    }
+    _last = i;
+    if (_hide) {
+        for (size_t k = old_first; k < old_last && k < size(); ++k) {
+            if (k < _first || k >= _last) _hide(k);
+        }
+    }
+
+    // Release the elements far from the laid-out range; those blocks were
+    // hidden when they left it.
+    size_t keep_first = _heights.find(top - kRetain - box.y_min);
+    size_t keep_last = _heights.find(bottom + kRetain - box.y_min) + 1;
+    std::erase_if(_live, [&](size_t k) {
+        if (k >= keep_first && k < keep_last) return false;
+        _elements[k] = nullptr;
+        return true;
+    });
+    return changed;
+}
+
+void VirtualList::render(ftxui::Screen& screen) {
+    for (size_t i = _first; i < _last; ++i) _elements[i]->Render(screen);
+}
+
+namespace {
+
+class VirtualListNode : public ftxui::Node {
+public:
+    explicit VirtualListNode(std::shared_ptr<VirtualList> list)
+        : _list(std::move(list)) {}
+
+    void ComputeRequirement() override {
+        requirement_ = {};
+        requirement_.min_y = _list->total_height();
+    }
+
+    void SetBox(ftxui::Box box) override {
+        Node::SetBox(box);
+        _relayout |= _list->layout(box);
+    }
+
+    // The blocks settled their own layout passes in SetBox(); only a
+    // changed height matters to the parents.
+    void Check(Status* status) override {
+        status->need_iteration |= _relayout;
+        _relayout = false;
+    }
+
+    void Render(ftxui::Screen& screen) override { _list->render(screen); }
+
+private:
+    std::shared_ptr<VirtualList> _list;
+    bool _relayout = false;
+};
+
+} // namespace
+
+ftxui::Element virtual_vbox(std::shared_ptr<VirtualList> list) {
+    return std::make_shared<VirtualListNode>(std::move(list));
+}
+
+} // namespace markdown
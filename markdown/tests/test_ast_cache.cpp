@@ -0,0 +1,237 @@
+#include "test_helper.hpp"
+#include "markdown/ast_cache.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/viewer.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Counts the parses that reach the real parser.
+class CountingParser : public MarkdownParser {
+public:
+    explicit CountingParser(int& count)
+        : _count(count), _parser(make_cmark_parser()) {}
+    bool parse(std::string_view input, MarkdownAST& out) override {
+        ++_count;
+        return _parser->parse(input, out);
+    }
+
+private:
+    int& _count;
+    std::unique_ptr<MarkdownParser> _parser;
+};
+
+fs::path fresh_dir(std::string const& name) {
+    auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    auto dir = fs::temp_directory_path() /
+               ("markdown_ast_cache_" + name + "_" + std::to_string(stamp));
+    fs::remove_all(dir);
+    return dir;
+}
+
+std::string render(ftxui::Element el) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                        ftxui::Dimension::Fixed(20));
+    ftxui::Render(screen, el);
+    return screen.ToString();
+}
+
+std::string const kDoc =
+    "# Title\n\n"
+    "Text with **bold**, *italic*, `code` and [a link](https://a.com).\n\n"
+    "> Quote with ![img](i.png)\n\n"
+    "3. three\n4. four\n   - nested\n\n"
+    "```cpp\nint x = 1;\n```\n\n"
+    "---\n\n"
+    "<div>html</div> caf\xC3\xA9\n";
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: Serialization round-trips every field and source range
+    {
+        auto ast = parser->parse(kDoc);
+        std::string bytes;
+        serialize_ast(ast, 42, kDoc.size(), bytes);
+        MarkdownAST back;
+        ASSERT_TRUE(deserialize_ast(bytes, 42, kDoc.size(), back));
+        ASSERT_TRUE(back == ast);
+
+        ASTNode odd{.type = NodeType::OrderedList, .level = -3,
+                    .list_start = 0};
+        odd.children.push_back(ASTNode{.type = NodeType::Text,
+                                       .text = std::string("a\0b", 3)});
+        serialize_ast(odd, 1, 2, bytes);
+        ASSERT_TRUE(deserialize_ast(bytes, 1, 2, back));
+        ASSERT_TRUE(back == odd);
+    }
+
+    // Test 2: Damaged data, another version or another text is rejected
+    {
+        auto ast = parser->parse(kDoc);
+        std::string bytes;
+        serialize_ast(ast, 7, kDoc.size(), bytes);
+        MarkdownAST back;
+        for (size_t len = 0; len < bytes.size(); ++len) {
+            ASSERT_TRUE(!deserialize_ast(bytes.substr(0, len), 7,
+                                         kDoc.size(), back));
+        }
+        ASSERT_TRUE(!deserialize_ast(bytes + "x", 7, kDoc.size(), back));
+        ASSERT_TRUE(!deserialize_ast(bytes, 8, kDoc.size(), back));
+        ASSERT_TRUE(!deserialize_ast(bytes, 7, kDoc.size() + 1, back));
+        auto other_version = bytes;
+        other_version[4] = 99;
+        ASSERT_TRUE(!deserialize_ast(other_version, 7, kDoc.size(), back));
+        auto huge_count = bytes;
+        huge_count.back() = '\x7F';  // last node claims 127 children
+        ASSERT_TRUE(!deserialize_ast(huge_count, 7, kDoc.size(), back));
+    }
+
+    // Test 3: Hash is stable and sensitive to every byte
+    {
+        ASSERT_EQ(content_hash(kDoc), content_hash(std::string(kDoc)));
+        for (size_t i = 0; i < kDoc.size(); i += 7) {
+            auto changed = kDoc;
+            changed[i] ^= 1;
+            ASSERT_TRUE(content_hash(changed) != content_hash(kDoc));
+        }
+        ASSERT_TRUE(content_hash("") != content_hash(std::string(1, '\0')));
+    }
+
+    // Test 4: Entries persist across cache instances
+    {
+        auto dir = fresh_dir("persist");
+        {
+            AstCache cache(dir);
+            MarkdownAST ast;
+            ASSERT_TRUE(!cache.load(kDoc, ast));
+            cache.store(kDoc, parser->parse(kDoc));
+            ASSERT_EQ(cache.entries(), 1u);
+        }
+        AstCache reopened(dir);
+        ASSERT_EQ(reopened.entries(), 1u);
+        ASSERT_TRUE(reopened.bytes() > 0);
+        MarkdownAST ast;
+        ASSERT_TRUE(reopened.load(kDoc, ast));
+        ASSERT_TRUE(ast == parser->parse(kDoc));
+        ASSERT_TRUE(!reopened.load(kDoc + " ", ast));
+        ASSERT_EQ(reopened.hits(), 1u);
+        ASSERT_EQ(reopened.misses(), 1u);
+        reopened.clear();
+        ASSERT_EQ(reopened.entries(), 0u);
+        ASSERT_TRUE(fs::is_empty(dir));
+        fs::remove_all(dir);
+    }
+
+    // Test 5: Least recently used entries are evicted first
+    {
+        auto dir = fresh_dir("lru");
+        AstCache cache(dir, AstCacheLimits{.max_entries = 3});
+        std::string docs[] = {"# one", "# two", "# three", "# four"};
+        for (int i = 0; i < 3; ++i) {
+            cache.store(docs[i], parser->parse(docs[i]));
+        }
+        MarkdownAST ast;
+        ASSERT_TRUE(cache.load(docs[0], ast));  // "one" is now most recent
+        cache.store(docs[3], parser->parse(docs[3]));
+        ASSERT_EQ(cache.entries(), 3u);
+        ASSERT_TRUE(!cache.load(docs[1], ast));
+        ASSERT_TRUE(cache.load(docs[0], ast));
+        ASSERT_TRUE(cache.load(docs[2], ast));
+        ASSERT_TRUE(cache.load(docs[3], ast));
+        fs::remove_all(dir);
+    }
+
+    // Test 6: The byte limit holds, and oversized entries are skipped
+    {
+        auto dir = fresh_dir("bytes");
+        std::string bytes;
+        serialize_ast(parser->parse(kDoc), 0, kDoc.size(), bytes);
+        // Room for two entries of about that size.
+        auto limit = bytes.size() * 2 + 8;
+        AstCache cache(dir, AstCacheLimits{.max_bytes = limit});
+        for (int i = 0; i < 10; ++i) {
+            auto doc = kDoc + std::to_string(i);
+            cache.store(doc, parser->parse(doc));
+            ASSERT_TRUE(cache.bytes() <= limit);
+        }
+        ASSERT_EQ(cache.entries(), 2u);
+        std::string big(bytes.size() * 3, 'x');
+        cache.store(big, parser->parse(big));
+        MarkdownAST ast;
+        ASSERT_TRUE(!cache.load(big, ast));
+        ASSERT_EQ(cache.entries(), 2u);
+        fs::remove_all(dir);
+    }
+
+    // Test 7: A damaged entry file is a miss and gets dropped
+    {
+        auto dir = fresh_dir("damaged");
+        AstCache cache(dir);
+        cache.store(kDoc, parser->parse(kDoc));
+        for (auto const& file : fs::directory_iterator(dir)) {
+            std::ofstream(file.path(), std::ios::trunc) << "garbage";
+        }
+        MarkdownAST ast;
+        ASSERT_TRUE(!cache.load(kDoc, ast));
+        ASSERT_EQ(cache.entries(), 0u);
+        fs::remove_all(dir);
+    }
+
+    // Test 8: A Viewer with a caching parser skips parses of seen text
+    {
+        auto dir = fresh_dir("viewer");
+        auto cache = std::make_shared<AstCache>(dir);
+        int parses = 0;
+        std::string first_out;
+        for (int round = 0; round < 3; ++round) {
+            Viewer viewer(make_caching_parser(
+                std::make_unique<CountingParser>(parses), cache));
+            viewer.set_content(kDoc);
+            auto out = render(viewer.component()->Render());
+            if (round == 0) first_out = out;
+            ASSERT_EQ(out, first_out);
+        }
+        ASSERT_EQ(parses, 1);
+        ASSERT_EQ(cache->hits(), 2u);
+        ASSERT_CONTAINS(first_out, "Title");
+        fs::remove_all(dir);
+    }
+
+    // Test 9: Caches sharing a directory see each other's entries
+    {
+        auto dir = fresh_dir("shared");
+        AstCache a(dir);
+        AstCache b(dir);
+        b.store(kDoc, parser->parse(kDoc));
+        ASSERT_EQ(a.entries(), 0u);
+        MarkdownAST ast;
+        ASSERT_TRUE(a.load(kDoc, ast));
+        ASSERT_TRUE(ast == parser->parse(kDoc));
+        ASSERT_EQ(a.entries(), 1u);
+
+        b.store(kDoc + "\nMore.\n", parser->parse(kDoc + "\nMore.\n"));
+        b.clear();
+        ASSERT_EQ(a.entries(), 1u);
+        a.rescan();
+        ASSERT_EQ(a.entries(), 0u);
+        ASSERT_EQ(a.bytes(), 0u);
+        ASSERT_TRUE(!a.load(kDoc, ast));
+        fs::remove_all(dir);
+    }
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include "test_helper.hpp"
+#include "markdown/ast_diff.hpp"
+#include "markdown/dom_builder.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/viewer.hpp"
+
+#include <string>
+#include <vector>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+std::string render(ftxui::Element el, int height) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                        ftxui::Dimension::Fixed(height));
+    ftxui::Render(screen, el);
+    return screen.ToString();
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: Hashes follow content, not position
+    {
+        auto a = parser->parse("# Title\n\nSame text.\n");
+        auto b = parser->parse("Intro.\n\n# Title\n\nSame text.\n");
+        ASSERT_EQ(subtree_hash(a.children[0]), subtree_hash(b.children[1]));
+        ASSERT_EQ(subtree_hash(a.children[1]), subtree_hash(b.children[2]));
+        ASSERT_TRUE(subtree_hash(a.children[0]) != subtree_hash(a.children[1]));
+
+        // Type, level and url all count.
+        auto h1 = parser->parse("# x\n");
+        auto h2 = parser->parse("## x\n");
+        ASSERT_TRUE(subtree_hash(h1) != subtree_hash(h2));
+        auto l1 = parser->parse("[x](https://a.com)\n");
+        auto l2 = parser->parse("[x](https://b.com)\n");
+        ASSERT_TRUE(subtree_hash(l1) != subtree_hash(l2));
+        // Moving text between siblings changes the shape.
+        auto s1 = parser->parse("*ab*c\n");
+        auto s2 = parser->parse("*a*bc\n");
+        ASSERT_TRUE(subtree_hash(s1) != subtree_hash(s2));
+    }
+
+    // Test 2: Parsers store each node's hash; == rejects on it at once
+    {
+        std::string doc = "# Title\n\n- *one* [a](https://a.com)\n- two\n\n"
+                          "```cpp\nint x;\n```\n";
+        auto ast = parser->parse(doc);
+        ASSERT_TRUE(ast.hash != 0);
+        ASSERT_TRUE(ast.children[1].children[0].children[0].hash != 0);
+
+        // A hand-built copy has no hashes; computing them agrees.
+        auto copy = ast;
+        std::vector<ASTNode*> stack{&copy};
+        while (!stack.empty()) {
+            auto* n = stack.back();
+            stack.pop_back();
+            n->hash = 0;
+            for (auto& c : n->children) stack.push_back(&c);
+        }
+        ASSERT_EQ(subtree_hash(copy), ast.hash);
+        ASSERT_TRUE(copy == ast);
+        hash_tree(copy);
+        ASSERT_EQ(copy.hash, ast.hash);
+
+        // The fast parser and the cmark parser agree on hashes.
+        auto fast = make_fast_parser()->parse(doc);
+        ASSERT_EQ(fast.hash, ast.hash);
+
+        auto other = parser->parse("# Title\n\n- *one* [a](https://b.com)\n");
+        ASSERT_TRUE(other.children[0] == ast.children[0]);
+        ASSERT_TRUE(other.children[1].hash != ast.children[1].hash);
+        ASSERT_TRUE(!(other == ast));
+    }
+
+    // Test 3: Prefix, suffix, changed, inserted and removed counts
+    {
+        std::vector<uint64_t> before = {1, 2, 3, 4, 5};
+        auto same = diff_blocks(before, before);
+        ASSERT_TRUE(same.empty());
+        ASSERT_EQ(same.prefix, 5u);
+        ASSERT_EQ(same.suffix, 0u);
+
+        std::vector<uint64_t> edited = {1, 2, 9, 4, 5};
+        auto d = diff_blocks(before, edited);
+        ASSERT_EQ(d.prefix, 2u);
+        ASSERT_EQ(d.suffix, 2u);
+        ASSERT_EQ(d.changed(), 1u);
+        ASSERT_EQ(d.inserted(), 0u);
+        ASSERT_EQ(d.old_block(1), 1u);
+        ASSERT_EQ(d.old_block(2), AstDiff::npos);
+        ASSERT_EQ(d.old_block(4), 4u);
+
+        std::vector<uint64_t> grown = {1, 2, 7, 8, 3, 4, 5};
+        d = diff_blocks(before, grown);
+        ASSERT_EQ(d.prefix, 2u);
+        ASSERT_EQ(d.suffix, 3u);
+        ASSERT_EQ(d.changed(), 0u);
+        ASSERT_EQ(d.inserted(), 2u);
+        ASSERT_EQ(d.old_block(3), AstDiff::npos);
+        ASSERT_EQ(d.old_block(4), 2u);
+        ASSERT_EQ(d.old_block(6), 4u);
+
+        std::vector<uint64_t> shrunk = {1, 5};
+        d = diff_blocks(before, shrunk);
+        ASSERT_EQ(d.prefix, 1u);
+        ASSERT_EQ(d.suffix, 1u);
+        ASSERT_EQ(d.removed(), 3u);
+        ASSERT_EQ(d.old_block(1), 4u);
+
+        // Prefix and suffix never overlap.
+        std::vector<uint64_t> repeated = {1, 1};
+        std::vector<uint64_t> more = {1, 1, 1};
+        d = diff_blocks(repeated, more);
+        ASSERT_EQ(d.prefix + d.suffix, 2u);
+        ASSERT_EQ(d.inserted(), 1u);
+    }
+
+    // Test 4: build keeps the blocks the diff reports unchanged
+    {
+        std::string before = "[one](https://one.com)\n\nMiddle\n\n"
+                             "[two](https://two.com)\n";
+        std::string after = "[one](https://one.com)\n\nNew middle\n\n"
+                            "Added [three](https://three.com)\n\n"
+                            "[two](https://two.com)\n";
+        auto old_ast = parser->parse(before);
+        auto new_ast = parser->parse(after);
+        DomBuilder builder;
+        render(builder.build(old_ast), 6);
+        auto const* two = &builder.link_targets()[1].boxes[0];
+
+        auto diff = diff_blocks(old_ast, new_ast);
+        ASSERT_EQ(diff.prefix, 1u);
+        ASSERT_EQ(diff.suffix, 1u);
+        auto out = render(builder.build(new_ast), 8);
+        ASSERT_EQ(builder.reused_blocks(), 2u);
+        ASSERT_EQ(builder.link_targets().size(), 3u);
+        ASSERT_EQ(builder.link_targets()[1].url, "https://three.com");
+        ASSERT_EQ(builder.link_targets()[2].url, "https://two.com");
+        ASSERT_TRUE(&builder.link_targets()[2].boxes[0] == two);
+        ASSERT_EQ(builder.flat_link_boxes().size(), 3u);
+
+        DomBuilder fresh;
+        ASSERT_EQ(out, render(fresh.build(new_ast), 8));
+    }
+
+    // Test 5: Focus moves keep every block
+    {
+        auto ast = parser->parse("[a](https://a.com)\n\n[b](https://b.com)\n\n"
+                                 "[c](https://c.com)\n");
+        ASSERT_TRUE(diff_blocks(ast, ast).empty());
+        DomBuilder builder;
+        render(builder.build(ast, 0), 5);
+        render(builder.build(ast, 1), 5);
+        ASSERT_EQ(builder.reused_blocks(), 3u);
+
+        DomBuilder fresh;
+        ASSERT_EQ(render(builder.build(ast, 2), 5),
+                  render(fresh.build(ast, 2), 5));
+    }
+
+    // Test 6: Viewer rebuilds only the edited block
+    {
+        std::string doc;
+        for (int i = 0; i < 50; ++i) {
+            doc += "Paragraph " + std::to_string(i) + ".\n\n";
+        }
+        Viewer viewer(make_cmark_parser());
+        viewer.set_content(doc);
+        auto comp = viewer.component();
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(40),
+                                            ftxui::Dimension::Fixed(10));
+        ftxui::Render(screen, comp->Render());
+
+        auto at = doc.find("Paragraph 25");
+        doc.replace(at, 12, "Edited 25");
+        viewer.set_content(doc);
+        ftxui::Render(screen, comp->Render());
+        ASSERT_EQ(viewer.last_reused_blocks(), 49u);
+    }
+
+    return 0;
+}
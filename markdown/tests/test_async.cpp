@@ -0,0 +1,185 @@
+#include "test_helper.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/viewer.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+std::string render(ftxui::Component const& comp, int height) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                        ftxui::Dimension::Fixed(height));
+    ftxui::Render(screen, comp->Render());
+    return screen.ToString();
+}
+
+// Render until the output equals expected; the worker publishes results
+// asynchronously, so an async viewer may need a few frames.
+std::string render_until(ftxui::Component const& comp, int height,
+                         std::string const& expected) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    std::string out = render(comp, height);
+    while (out != expected && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        out = render(comp, height);
+    }
+    return out;
+}
+
+std::string make_doc(int sections) {
+    std::string doc;
+    for (int i = 0; i < sections; ++i) {
+        auto n = std::to_string(i);
+        doc += "## Section " + n + "\n\n";
+        doc += "Text with **bold** and a [link " + n + "](https://x.com/" +
+               n + ").\n\n";
+    }
+    return doc;
+}
+
+} // namespace
+
+int main() {
+    // Test 1: Async viewer converges on the synchronous output
+    {
+        Viewer sync_viewer(make_cmark_parser());
+        Viewer async_viewer(make_cmark_parser());
+        async_viewer.set_async(true);
+        ASSERT_TRUE(async_viewer.async());
+        auto sync_comp = sync_viewer.component();
+        auto async_comp = async_viewer.component();
+        auto doc = make_doc(5);
+        sync_viewer.set_content(doc);
+        async_viewer.set_content(doc);
+        auto expected = render(sync_comp, 30);
+        ASSERT_CONTAINS(expected, "Section 4");
+        ASSERT_EQ(render_until(async_comp, 30, expected), expected);
+        ASSERT_EQ(async_viewer.focused_index(), -1);
+    }
+
+    // Test 2: A burst of edits ends on the last version
+    {
+        Viewer viewer(make_cmark_parser());
+        viewer.set_async(true);
+        auto comp = viewer.component();
+        std::string text;
+        for (int i = 0; i < 200; ++i) {
+            text += "word" + std::to_string(i) + " ";
+            viewer.set_content(text);
+            render(comp, 20);
+        }
+        Viewer reference(make_cmark_parser());
+        auto ref_comp = reference.component();
+        reference.set_content(text);
+        auto expected = render(ref_comp, 20);
+        ASSERT_EQ(render_until(comp, 20, expected), expected);
+    }
+
+    // Test 3: Streaming appends and incremental edits off the UI thread
+    {
+        Viewer viewer(make_cmark_parser());
+        viewer.set_async(true);
+        viewer.set_incremental(true);
+        auto comp = viewer.component();
+        auto doc = make_doc(8);
+        for (size_t pos = 0; pos < doc.size(); pos += 13) {
+            viewer.append_content(std::string_view(doc).substr(pos, 13));
+            render(comp, 40);
+        }
+        doc.insert(doc.find("Section 3") + 9, " edited");
+        viewer.set_content(doc);
+        Viewer reference(make_cmark_parser());
+        auto ref_comp = reference.component();
+        reference.set_content(doc);
+        auto expected = render(ref_comp, 40);
+        ASSERT_CONTAINS(expected, "Section 3 edited");
+        ASSERT_EQ(render_until(comp, 40, expected), expected);
+    }
+
+    // Test 4: Link focus shows on the next frame, without the worker
+    {
+        Viewer sync_viewer(make_cmark_parser());
+        Viewer async_viewer(make_cmark_parser());
+        async_viewer.set_async(true);
+        auto sync_comp = sync_viewer.component();
+        auto async_comp = async_viewer.component();
+        auto doc = make_doc(3);
+        sync_viewer.set_content(doc);
+        async_viewer.set_content(doc);
+        auto plain = render(sync_comp, 20);
+        ASSERT_EQ(render_until(async_comp, 20, plain), plain);
+
+        ASSERT_TRUE(sync_viewer.enter_focus(-1));
+        ASSERT_TRUE(async_viewer.enter_focus(-1));
+        ASSERT_EQ(async_viewer.focused_value(), "https://x.com/2");
+        auto focused = render(sync_comp, 20);
+        ASSERT_EQ(render(async_comp, 20), focused);
+    }
+
+    // Test 5: Switching back to synchronous mode renders immediately
+    {
+        Viewer viewer(make_cmark_parser());
+        viewer.set_async(true);
+        auto comp = viewer.component();
+        viewer.set_content("# First");
+        render(comp, 5);
+        viewer.set_async(false);
+        viewer.set_content("# Second");
+        ASSERT_CONTAINS(render(comp, 5), "Second");
+    }
+
+    // Test 6: Destroying a viewer with a build in flight joins the worker
+    {
+        auto doc = make_doc(2000);
+        for (int i = 0; i < 3; ++i) {
+            Viewer viewer(make_cmark_parser());
+            viewer.set_async(true);
+            auto comp = viewer.component();
+            viewer.set_content(doc);
+            render(comp, 10);
+        }
+    }
+
+    // Test 7: Settings changed while a build is pending stay in effect
+    {
+        auto doc = make_doc(200);
+        Viewer sync_viewer(make_cmark_parser());
+        sync_viewer.set_line_layout(true);
+        auto sync_comp = sync_viewer.component();
+        sync_viewer.set_content(doc);
+        auto expected = render(sync_comp, 20);
+
+        Viewer viewer(make_cmark_parser());
+        viewer.set_async(true);
+        auto comp = viewer.component();
+        viewer.set_content(doc);
+        render(comp, 20);  // sends a job with the old settings
+        viewer.set_line_layout(true);
+        viewer.set_build_threads(3);
+        auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        std::string out;
+        while (out != expected &&
+               std::chrono::steady_clock::now() < deadline) {
+            out = render(comp, 20);
+            ASSERT_TRUE(viewer.line_layout());
+            ASSERT_EQ(viewer.build_threads(), 3u);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_EQ(out, expected);
+        // Let the worker finish anything still queued, then check again.
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ASSERT_EQ(render(comp, 20), expected);
+        ASSERT_TRUE(viewer.line_layout());
+        ASSERT_EQ(viewer.build_threads(), 3u);
+    }
+
+    return 0;
+}
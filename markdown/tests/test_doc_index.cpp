@@ -0,0 +1,160 @@
+#include "test_helper.hpp"
+#include "markdown/doc_index.hpp"
+#include "markdown/dom_builder.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/viewer.hpp"
+
+#include <string>
+
+#include <ftxui/component/event.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+std::string sections(int count) {
+    std::string doc = "[jump](#section-20) [site](https://example.com)\n\n";
+    for (int i = 0; i < count; ++i) {
+        auto n = std::to_string(i);
+        doc += "## Section " + n + "\n\n";
+        doc += "Body of section " + n + ".\nSecond line.\nThird line.\n\n";
+    }
+    return doc;
+}
+
+std::string render(ftxui::Component const& comp) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                        ftxui::Dimension::Fixed(12));
+    ftxui::Render(screen, comp->Render());
+    return screen.ToString();
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: Slugs follow GitHub's rules
+    {
+        ASSERT_EQ(heading_slug("Hello, World!"), "hello-world");
+        ASSERT_EQ(heading_slug("API v2.0 (beta)"), "api-v20-beta");
+        ASSERT_EQ(heading_slug("snake_case and-dash"), "snake_case-and-dash");
+        ASSERT_EQ(heading_slug("Café au lait"), "café-au-lait");
+    }
+
+    // Test 2: Headings and links in document order, with their blocks
+    {
+        auto ast = parser->parse(
+            "# Intro *here*\n\nSee [a](https://a.com).\n\n"
+            "> ## Quoted `code`\n> [b](https://b.com)\n\n"
+            "# Intro here\n\n# Intro here\n");
+        DocumentIndex index;
+        index.build(ast);
+        ASSERT_EQ(index.block_count(), 5u);
+        ASSERT_EQ(index.headings().size(), 4u);
+        ASSERT_EQ(index.headings()[0].text, "Intro here");
+        ASSERT_EQ(index.headings()[0].level, 1);
+        ASSERT_EQ(index.headings()[1].text, "Quoted code");
+        ASSERT_EQ(index.headings()[1].block, 2u);
+        ASSERT_EQ(index.headings()[1].slug, "quoted-code");
+        // Repeats are numbered.
+        ASSERT_EQ(index.headings()[0].slug, "intro-here");
+        ASSERT_EQ(index.headings()[2].slug, "intro-here-1");
+        ASSERT_EQ(index.headings()[3].slug, "intro-here-2");
+        ASSERT_EQ(index.find_slug("intro-here-2"), 3);
+        ASSERT_EQ(index.find_slug("missing"), -1);
+
+        ASSERT_EQ(index.links().size(), 2u);
+        ASSERT_EQ(index.links()[0].block, 1u);
+        ASSERT_EQ(index.links()[1].url, "https://b.com");
+        ASSERT_EQ(index.links()[1].block, 2u);
+
+        // Same numbering as the builder's link targets.
+        DomBuilder builder;
+        builder.build(ast);
+        ASSERT_EQ(builder.link_targets().size(), index.links().size());
+        for (size_t i = 0; i < index.links().size(); ++i) {
+            ASSERT_EQ(builder.link_targets()[i].url, index.links()[i].url);
+        }
+    }
+
+    // Test 3: Neighbouring headings by block, and fragments
+    {
+        auto ast = parser->parse("# A\n\ntext\n\ntext\n\n# B\n\ntext\n\n"
+                                 "# Crème brûlée\n");
+        DocumentIndex index;
+        index.build(ast);
+        ASSERT_EQ(index.heading_after(0), 1);
+        ASSERT_EQ(index.heading_after(1), 1);
+        ASSERT_EQ(index.heading_after(3), 2);
+        ASSERT_EQ(index.heading_after(5), -1);
+        ASSERT_EQ(index.heading_before(0), -1);
+        ASSERT_EQ(index.heading_before(3), 0);
+        ASSERT_EQ(index.heading_before(4), 1);
+        ASSERT_EQ(index.resolve_fragment("#b"), 1);
+        ASSERT_EQ(index.resolve_fragment("#crème-brûlée"), 2);
+        ASSERT_EQ(index.resolve_fragment("#cr%C3%A8me-br%C3%BBl%C3%A9e"), 2);
+        ASSERT_EQ(index.resolve_fragment("https://x.com/#b"), -1);
+        ASSERT_EQ(index.resolve_fragment("#"), -1);
+
+        index.clear();
+        ASSERT_EQ(index.block_count(), 0u);
+        ASSERT_EQ(index.heading_after(0), -1);
+    }
+
+    // Test 4: Viewer steps through headings from the reading position
+    {
+        Viewer viewer(make_cmark_parser());
+        viewer.set_content(sections(40));
+        auto comp = viewer.component();
+        ASSERT_TRUE(!viewer.next_heading());  // no layout yet
+        render(comp);
+        ASSERT_EQ(viewer.index().headings().size(), 40u);
+
+        ASSERT_TRUE(viewer.jump_to_heading(10));
+        ASSERT_CONTAINS(render(comp), "Section 10");
+        ASSERT_TRUE(viewer.next_heading());
+        ASSERT_TRUE(viewer.next_heading());
+        auto screen = render(comp);
+        ASSERT_CONTAINS(screen, "Section 12");
+        ASSERT_TRUE(screen.find("Section 10") == std::string::npos);
+        ASSERT_TRUE(viewer.next_heading(-1));
+        ASSERT_CONTAINS(render(comp), "Section 11");
+
+        // After a manual scroll, the position comes from the layout.
+        viewer.set_scroll(0.0f);
+        render(comp);
+        ASSERT_TRUE(viewer.next_heading());
+        ASSERT_CONTAINS(render(comp), "Section 1");
+        ASSERT_TRUE(!viewer.jump_to_heading(40));
+    }
+
+    // Test 5: Fragment links jump instead of reaching the callback
+    {
+        Viewer viewer(make_cmark_parser());
+        std::string pressed;
+        viewer.on_link_click([&](std::string const& url, LinkEvent event) {
+            if (event == LinkEvent::Press) pressed = url;
+        });
+        viewer.set_content(sections(40));
+        auto comp = viewer.component();
+        // The index counts links before anything is built.
+        ASSERT_TRUE(viewer.enter_focus(-1));
+        ASSERT_EQ(viewer.focused_value(), "https://example.com");
+        render(comp);
+
+        ASSERT_TRUE(viewer.enter_focus(+1));
+        ASSERT_EQ(viewer.focused_value(), "#section-20");
+        comp->OnEvent(ftxui::Event::Return);
+        ASSERT_TRUE(pressed.empty());
+        ASSERT_CONTAINS(render(comp), "Section 20");
+
+        comp->OnEvent(ftxui::Event::Tab);
+        comp->OnEvent(ftxui::Event::Return);
+        ASSERT_EQ(pressed, "https://example.com");
+        ASSERT_TRUE(!viewer.follow_fragment("#no-such-heading"));
+    }
+
+    return 0;
+}
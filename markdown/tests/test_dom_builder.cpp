@@ -70,5 +70,32 @@ int main() {
         ASSERT_CONTAINS(output, "Manual");
     }
 
+    // Test 6: Source map finds blocks by offset and keeps off-screen boxes
+    {
+        std::string text = "# Title\n\n```\na\nb\nc\n```\n\nLast para\n";
+        auto ast = parser->parse(text);
+        auto element = builder.build(ast);
+        ASSERT_EQ(builder.block_count(), 3u);
+        ASSERT_EQ(builder.block_source_begin(1), text.find("```"));
+        ASSERT_EQ(builder.block_at_source(0), 0);
+        ASSERT_EQ(builder.block_at_source(text.find("b\n")), 1);
+        ASSERT_EQ(builder.block_at_source(text.find("Last") + 2), 2);
+        ASSERT_EQ(builder.block_at_source(text.size() + 10), 2);
+
+        // Only two rows are visible; the last block is laid out below.
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(40),
+                                            ftxui::Dimension::Fixed(2));
+        ftxui::Render(screen, element | ftxui::frame);
+        auto const& code = builder.block_box(1);
+        auto const& last = builder.block_box(2);
+        ASSERT_TRUE(code.y_max - code.y_min >= 2);
+        ASSERT_TRUE(last.y_min > code.y_max);
+        ASSERT_TRUE(last.y_min >= 2);
+
+        builder.build(parser->parse(""));
+        ASSERT_EQ(builder.block_count(), 0u);
+        ASSERT_EQ(builder.block_at_source(0), -1);
+    }
+
     return 0;
 }
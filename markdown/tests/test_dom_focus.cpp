@@ -1,7 +1,12 @@
 #include "test_helper.hpp"
 #include "markdown/dom_builder.hpp"
 #include "markdown/parser.hpp"
+#include "markdown/scroll_frame.hpp"
+#include "markdown/viewer.hpp"
 
+#include <string>
+
+#include <ftxui/component/event.hpp>
 #include <ftxui/screen/screen.hpp>
 #include <ftxui/dom/elements.hpp>
 
@@ -99,5 +104,85 @@ int main() {
         ASSERT_TRUE(!screen.PixelAt(7, 0).inverted);
     }
 
+    // Test 9: set_focus moves the highlight within the same element
+    {
+        auto element = builder.build(ast, -1);
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(80),
+                                            ftxui::Dimension::Fixed(1));
+        builder.set_focus(0);
+        ftxui::Render(screen, element);
+        ASSERT_EQ(builder.focused_link(), 0);
+        ASSERT_TRUE(screen.PixelAt(7, 0).inverted);
+
+        builder.set_focus(1);
+        screen.Clear();
+        ftxui::Render(screen, element);
+        ASSERT_TRUE(!screen.PixelAt(7, 0).inverted);
+        ASSERT_TRUE(*builder.link_targets()[1].focused);
+
+        builder.set_focus(5);
+        ASSERT_EQ(builder.focused_link(), -1);
+        ASSERT_TRUE(!*builder.link_targets()[1].focused);
+    }
+
+    // Test 10: Tab through a viewer's links without rebuilding
+    {
+        std::string doc;
+        for (int i = 0; i < 50; ++i) {
+            doc += "- [link" + std::to_string(i) + "](https://example.com/" +
+                   std::to_string(i) + ")\n";
+        }
+        Viewer viewer(make_cmark_parser());
+        viewer.set_content(doc);
+        auto comp = viewer.component();
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(40),
+                                            ftxui::Dimension::Fixed(10));
+        ftxui::Render(screen, comp->Render());
+        viewer.set_active(true);
+        auto updates = viewer.update_count();
+        for (int i = 0; i < 50; ++i) {
+            comp->OnEvent(ftxui::Event::Tab);
+            ftxui::Render(screen, comp->Render());
+        }
+        ASSERT_EQ(viewer.update_count(), updates);
+        ASSERT_EQ(viewer.focused_value(), "https://example.com/49");
+    }
+
+    // Test 11: A link nested too deep to build keeps its number
+    {
+        std::string doc;
+        for (int i = 0; i < 45; ++i) {
+            doc += std::string(2 * i, ' ') + "- level\n";
+        }
+        doc += std::string(90, ' ') + "[deep](https://deep.com)\n";
+        doc += "- [next](https://next.com)\n";
+        auto deep = parser->parse(doc);
+
+        for (int mode = 0; mode < 3; ++mode) {
+            DomBuilder b;
+            b.set_line_layout(mode == 1);
+            b.set_virtual_blocks(mode == 2);
+            ScrollInfo info;
+            b.set_viewport(&info);
+            auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(120),
+                                                ftxui::Dimension::Fixed(60));
+            ftxui::Render(screen,
+                          direct_scroll(b.build(deep, 1), 0.0f, &info));
+            auto const& targets = b.link_targets();
+            ASSERT_EQ(targets.size(), 2u);
+            ASSERT_EQ(targets[0].url, "https://deep.com");
+            ASSERT_EQ(targets[1].url, "https://next.com");
+            ASSERT_TRUE(!targets[1].boxes.empty());
+            auto box = targets[1].boxes[0];
+            ASSERT_TRUE(box.y_min <= box.y_max);
+        }
+
+        Viewer viewer(make_cmark_parser());
+        viewer.set_virtual_blocks(true);
+        viewer.set_content(doc);
+        ASSERT_TRUE(viewer.enter_focus(-1));
+        ASSERT_EQ(viewer.focused_value(), "https://next.com");
+    }
+
     return 0;
 }
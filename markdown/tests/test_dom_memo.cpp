@@ -0,0 +1,137 @@
+#include "test_helper.hpp"
+#include "markdown/dom_builder.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/theme.hpp"
+#include "markdown/viewer.hpp"
+
+#include <string>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+std::string render(ftxui::Element el, int height) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                        ftxui::Dimension::Fixed(height));
+    ftxui::Render(screen, el);
+    return screen.ToString();
+}
+
+std::string links(int count) {
+    std::string doc;
+    for (int i = 0; i < count; ++i) {
+        auto n = std::to_string(i);
+        doc += "Link [" + n + "](https://" + n + ".com)\n\n";
+    }
+    return doc;
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: Building the same AST again takes every block from the memo
+    {
+        auto ast = parser->parse("# Title\n\n" + links(3) + "> quoted\n");
+        DomBuilder builder;
+        auto first = render(builder.build(ast), 12);
+        ASSERT_EQ(builder.reused_blocks(), 0u);
+        ASSERT_EQ(builder.memo_size(), 5u);
+        auto const* box = &builder.link_targets()[2].boxes[0];
+
+        auto second = render(builder.build(ast), 12);
+        ASSERT_EQ(builder.reused_blocks(), 5u);
+        ASSERT_EQ(second, first);
+        ASSERT_EQ(builder.link_targets().size(), 3u);
+        ASSERT_EQ(builder.link_targets()[2].url, "https://2.com");
+        ASSERT_TRUE(&builder.link_targets()[2].boxes[0] == box);
+        ASSERT_EQ(builder.flat_link_boxes().size(), 3u);
+    }
+
+    // Test 2: Toggling the theme back finds the old blocks
+    {
+        auto ast = parser->parse(links(4));
+        DomBuilder builder;
+        builder.build(ast, -1, theme_default());
+        builder.build(ast, -1, theme_colorful());
+        ASSERT_EQ(builder.reused_blocks(), 0u);
+        ASSERT_EQ(builder.memo_size(), 8u);
+        auto out = render(builder.build(ast, -1, theme_default()), 8);
+        ASSERT_EQ(builder.reused_blocks(), 4u);
+
+        DomBuilder fresh;
+        ASSERT_EQ(out, render(fresh.build(ast, -1, theme_default()), 8));
+
+        // The other theme's blocks go after kMemoBuilds builds without use.
+        for (uint64_t i = 0; i < DomBuilder::kMemoBuilds; ++i) {
+            builder.build(ast, -1, theme_default());
+        }
+        ASSERT_EQ(builder.memo_size(), 4u);
+    }
+
+    // Test 3: Focus moves take every block from the memo
+    {
+        auto ast = parser->parse(links(4));
+        DomBuilder builder;
+        builder.build(ast, 0);
+        builder.build(ast, 1);
+        ASSERT_EQ(builder.reused_blocks(), 4u);
+
+        DomBuilder fresh;
+        ASSERT_EQ(render(builder.build(ast, 2), 8),
+                  render(fresh.build(ast, 2), 8));
+        ASSERT_EQ(builder.focused_link(), 2);
+    }
+
+    // Test 4: Repeated blocks each keep their own entry
+    {
+        auto ast = parser->parse("---\n\n[a](https://a.com)\n\n---\n\n"
+                                 "[a](https://a.com)\n\n---\n");
+        DomBuilder builder;
+        builder.build(ast, 1);
+        ASSERT_EQ(builder.memo_size(), 5u);
+        auto out = render(builder.build(ast, 1), 10);
+        ASSERT_EQ(builder.reused_blocks(), 5u);
+        ASSERT_EQ(builder.link_targets().size(), 2u);
+
+        DomBuilder fresh;
+        ASSERT_EQ(out, render(fresh.build(ast, 1), 10));
+    }
+
+    // Test 5: An edit rebuilds only the blocks whose content changed
+    {
+        auto before = parser->parse(links(6));
+        auto doc = links(6);
+        doc.replace(doc.find("Link [3]"), 4, "Edited");
+        auto after = parser->parse(doc);
+        DomBuilder builder;
+        builder.build(before);
+        auto out = render(builder.build(after), 12);
+        ASSERT_EQ(builder.reused_blocks(), 5u);
+
+        DomBuilder fresh;
+        ASSERT_EQ(out, render(fresh.build(after), 12));
+    }
+
+    // Test 6: Viewer keeps blocks across a theme switch and back
+    {
+        Viewer viewer(make_cmark_parser());
+        viewer.set_content(links(30));
+        auto comp = viewer.component();
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(40),
+                                            ftxui::Dimension::Fixed(10));
+        ftxui::Render(screen, comp->Render());
+        viewer.set_theme(theme_high_contrast());
+        ftxui::Render(screen, comp->Render());
+        ASSERT_EQ(viewer.last_reused_blocks(), 0u);
+        viewer.set_theme(theme_default());
+        ftxui::Render(screen, comp->Render());
+        ASSERT_EQ(viewer.last_reused_blocks(), 30u);
+    }
+
+    return 0;
+}
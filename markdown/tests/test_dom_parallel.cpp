@@ -0,0 +1,95 @@
+#include "test_helper.hpp"
+#include "markdown/dom_builder.hpp"
+#include "markdown/flat_ast.hpp"
+#include "markdown/parser.hpp"
+
+#include <string>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+std::string document(int count) {
+    std::string doc = "# Title\n\n";
+    for (int i = 0; i < count; ++i) {
+        auto n = std::to_string(i);
+        doc += "Paragraph " + n + " with [a](https://a" + n + ".com) and [b](";
+        doc += "https://b" + n + ".com).\n\n";
+        if (i % 10 == 0) {
+            doc += "---\n\n- item " + n + "\n- [c](c" + n + ")\n\n";
+        }
+    }
+    return doc;
+}
+
+std::string render(ftxui::Element el) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                        ftxui::Dimension::Fixed(40));
+    ftxui::Render(screen, el);
+    return screen.ToString();
+}
+
+bool same_links(DomBuilder const& a, DomBuilder const& b) {
+    if (a.link_targets().size() != b.link_targets().size()) return false;
+    for (size_t i = 0; i < a.link_targets().size(); ++i) {
+        if (a.link_targets()[i].url != b.link_targets()[i].url) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+    auto doc = document(200);
+    auto ast = parser->parse(doc);
+
+    DomBuilder sequential;
+    auto expected = render(sequential.build(ast, 3));
+
+    // Test 1: Parallel builds match the sequential build
+    for (unsigned threads : {0u, 2u, 4u, 16u}) {
+        DomBuilder builder;
+        builder.set_build_threads(threads);
+        ASSERT_EQ(builder.build_threads(), threads);
+        ASSERT_EQ(render(builder.build(ast, 3)), expected);
+        ASSERT_TRUE(same_links(builder, sequential));
+        ASSERT_EQ(builder.block_count(), sequential.block_count());
+        for (size_t i = 0; i < builder.block_count(); ++i) {
+            ASSERT_EQ(builder.block_source_begin(i),
+                      sequential.block_source_begin(i));
+        }
+        // Every repeated rule got its own slot.
+        ASSERT_EQ(builder.memo_size(), sequential.memo_size());
+    }
+
+    // Test 2: A rebuild after an edit takes the rest from the memo
+    {
+        DomBuilder builder;
+        builder.set_build_threads(4);
+        builder.build(ast);
+        auto edited = doc;
+        edited.insert(doc.find("Paragraph 100"), "New block\n\n");
+        auto edited_ast = parser->parse(edited);
+        auto element = builder.build(edited_ast);
+        ASSERT_EQ(builder.reused_blocks(), builder.block_count() - 1);
+        DomBuilder fresh;
+        ASSERT_EQ(render(element), render(fresh.build(edited_ast)));
+        ASSERT_TRUE(same_links(builder, fresh));
+    }
+
+    // Test 3: FlatAST builds are split the same way
+    {
+        FlatAST flat;
+        parser->parse(doc, flat);
+        DomBuilder builder;
+        builder.set_build_threads(4);
+        ASSERT_EQ(render(builder.build(flat, 3)), expected);
+        ASSERT_TRUE(same_links(builder, sequential));
+    }
+
+    return 0;
+}
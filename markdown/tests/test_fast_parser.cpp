@@ -0,0 +1,134 @@
+#include "test_helper.hpp"
+#include "markdown/flat_ast.hpp"
+#include "markdown/parser.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace markdown;
+
+namespace {
+
+std::string read_file(std::string const& path) {
+    std::ifstream f(path);
+    std::ostringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+// Documents inside the fast parser's subset.
+std::vector<std::string> const kSupported = {
+    "",
+    "plain text",
+    "line one\nline two\n\nsecond paragraph\n",
+    "  indented start\n   and more  \n",
+    "# H1\n## H2 ##\n###### H6 #\n#hashtag\n####### seven\n",
+    "# Title with *emph* and `code` #\ntext\n",
+    "*em* **strong** ***both*** _u_ __uu__ snake_case_name\n",
+    "**bold *nested* text** and *unclosed\n",
+    "*a **b** c* __a _b_ c__ ** not bold **\n",
+    "`code` ``a ` b`` ` spaced ` `unclosed\n",
+    "[link](https://example.com) and ![img](pic.png)\n",
+    "[**bold link**](u) [a [nested](b) c](d) [](empty)\n",
+    "[not a link] [also](not a link) ] stray ! bang\n",
+    "[x](a(b)c) [y](a\\)b) [z](  spaced  )\n",
+    "escapes \\* \\_ \\[ \\\\ \\a and & alone\n",
+    "hard  \nbreak\\\nand soft\nbreaks\n",
+    "> quote\n> more\nlazy\n\n> > nested\n",
+    "- one\n- two\n  continued\n- three\n\n  loose para\n",
+    "1. first\n2. second\n10. tenth\n\n3) paren\n",
+    "* a\n+ b\n- c\n",
+    "- outer\n  - inner\n    - innermost\n  - back\n",
+    "1. item\n   > quoted in item\n   ```\n   code in item\n   ```\n",
+    "---\n***\n___\n- - -\n",
+    "text\n***\n",
+    "para\n- list interrupts\n\n2. not one\n",
+    "```cpp\nint x = 1;\n\n  indented\n```\nafter\n",
+    "~~~\nunclosed fence\n\n",
+    "  ```\n  stripped\n    partly\n  ```\n",
+    "````\n```\nnested fence\n````\n",
+    "> ```\n> in quote\n> ```\n",
+    "unicode: café, naïve, 日本語, emoji 🎉\n",
+    "-\n\n- \n  text\n",
+    "> # heading in quote\n> - list in quote\n",
+};
+
+// Documents that use constructs the fast parser leaves to cmark.
+std::vector<std::string> const kUnsupported = {
+    "<div>html</div>\n",
+    "text with <b>inline</b> html\n",
+    "<https://autolink.com>\n",
+    "entity &amp; and &#35;\n",
+    "tab\tseparated\n",
+    "crlf\r\nline\r\n",
+    "Setext\n======\n",
+    "    indented code\n",
+    "[ref]\n\n[ref]: https://example.com\n",
+    "[title](url \"a title\")\n",
+    "*both*flanking*runs*\n",
+    "#\n",
+    "\xEF\xBB\xBF" "bom\n",
+    "`multi\nline code`\n",
+};
+
+} // namespace
+
+int main() {
+    auto cmark = make_cmark_parser();
+    auto fast = make_fast_parser();
+
+    std::string dir = SNIPPETS_DIR;
+    std::vector<std::string> snippets{read_file(dir + "/email1.md"),
+                                      read_file(dir + "/email2.md")};
+
+    // Test 1: Snippet emails take the fast path and match cmark exactly
+    for (auto const& doc : snippets) {
+        ASSERT_TRUE(!doc.empty());
+        MarkdownAST ast;
+        ASSERT_TRUE(detail::parse_fast(doc, ast));
+        ASSERT_TRUE(ast == cmark->parse(doc));
+    }
+
+    // Test 2: Every prefix boundary of the snippets matches cmark
+    for (auto const& doc : snippets) {
+        for (size_t len = 0; len < doc.size(); len += 61) {
+            auto prefix = std::string_view(doc).substr(0, len);
+            ASSERT_TRUE(fast->parse(prefix) == cmark->parse(prefix));
+        }
+    }
+
+    // Test 3: Supported constructs take the fast path and match cmark
+    for (auto const& doc : kSupported) {
+        MarkdownAST ast;
+        if (!detail::parse_fast(doc, ast)) {
+            std::cerr << "fast path declined:\n" << doc << "\n";
+            return 1;
+        }
+        if (!(ast == cmark->parse(doc))) {
+            std::cerr << "mismatch for:\n" << doc << "\n";
+            return 1;
+        }
+    }
+
+    // Test 4: Other documents fall back to cmark transparently
+    for (auto const& doc : kUnsupported) {
+        MarkdownAST ast;
+        ASSERT_TRUE(!detail::parse_fast(doc, ast));
+        ASSERT_TRUE(fast->parse(doc) == cmark->parse(doc));
+    }
+
+    // Test 5: The flat parse matches too, on both paths
+    for (std::string_view doc : {std::string_view(snippets[0]),
+                                 std::string_view(kSupported[5]),
+                                 std::string_view(kUnsupported[0])}) {
+        FlatAST flat;
+        ASSERT_TRUE(fast->parse(doc, flat));
+        FlatAST expected;
+        cmark->parse(doc, expected);
+        ASSERT_TRUE(flat == expected);
+    }
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "test_helper.hpp"
+#include "markdown/dom_builder.hpp"
+#include "markdown/flat_ast.hpp"
+#include "markdown/parser.hpp"
+
+#include <string>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+std::string render(ftxui::Element el, int height) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                        ftxui::Dimension::Fixed(height));
+    ftxui::Render(screen, el);
+    return screen.ToString();
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    std::string const doc =
+        "# Title\n\n"
+        "Text with **bold**, *italic*, `code` and [a link](https://a.com).\n\n"
+        "> Quote with ![img](i.png)\n\n"
+        "1. one\n2. two\n   - nested\n\n"
+        "line one  \nline two\\\nline three\n\n"
+        "```cpp\nint x = 1;\n```\n\n"
+        "---\n\n"
+        "<div>html</div>\n\n"
+        "Entities &amp; escapes \\*x\\*\n";
+
+    // Test 1: Direct flat parse matches the flattened tree parse
+    {
+        FlatAST flat;
+        ASSERT_TRUE(parser->parse(doc, flat));
+        FlatAST expected;
+        flatten(parser->parse(doc), expected);
+        ASSERT_TRUE(flat == expected);
+    }
+
+    // Test 2: Preorder layout, subtree sizes and arena views
+    {
+        FlatAST flat;
+        parser->parse("# Hi\n\nsee [x](u)", flat);
+        ASSERT_EQ(flat.nodes.size(), 7u);
+        ASSERT_EQ(flat.nodes[0].subtree_size, 7u);
+        ASSERT_EQ(flat.arena, "Hisee ux");
+        auto root = flat.root();
+        ASSERT_EQ(root.type(), NodeType::Document);
+
+        auto it = root.children().begin();
+        auto heading = *it;
+        ASSERT_EQ(heading.type(), NodeType::Heading);
+        ASSERT_EQ(heading.level(), 1);
+        ASSERT_EQ((*heading.children().begin()).text(), "Hi");
+
+        auto para = *++it;
+        ASSERT_EQ(para.type(), NodeType::Paragraph);
+        ASSERT_EQ(para.node().source_begin, 6u);
+        auto inl = para.children().begin();
+        ASSERT_EQ((*inl).text(), "see ");
+        auto link = *++inl;
+        ASSERT_EQ(link.type(), NodeType::Link);
+        ASSERT_EQ(link.url(), "u");
+        ASSERT_TRUE(++inl == para.children().end());
+        ASSERT_TRUE(++it == root.children().end());
+    }
+
+    // Test 3: Empty input yields a lone Document node
+    {
+        FlatAST flat;
+        parser->parse("", flat);
+        ASSERT_EQ(flat.nodes.size(), 1u);
+        ASSERT_TRUE(flat.root().children().empty());
+        ASSERT_TRUE(flat.arena.empty());
+    }
+
+    // Test 4: Reparsing into the same FlatAST reuses its buffers
+    {
+        FlatAST flat;
+        parser->parse(doc, flat);
+        auto node_cap = flat.nodes.capacity();
+        auto arena_cap = flat.arena.capacity();
+        auto const* nodes_data = flat.nodes.data();
+        parser->parse(doc, flat);
+        ASSERT_EQ(flat.nodes.capacity(), node_cap);
+        ASSERT_EQ(flat.arena.capacity(), arena_cap);
+        ASSERT_TRUE(flat.nodes.data() == nodes_data);
+    }
+
+    // Test 5: DomBuilder renders the flat AST identically
+    {
+        DomBuilder tree_builder;
+        DomBuilder flat_builder;
+        FlatAST flat;
+        parser->parse(doc, flat);
+        auto tree_out = render(tree_builder.build(parser->parse(doc), 0), 40);
+        auto flat_out = render(flat_builder.build(flat, 0), 40);
+        ASSERT_EQ(flat_out, tree_out);
+        ASSERT_CONTAINS(flat_out, "line three");
+        ASSERT_CONTAINS(flat_out, "int x = 1;");
+        ASSERT_EQ(flat_builder.link_targets().size(), 1u);
+        ASSERT_EQ(flat_builder.link_targets()[0].url, "https://a.com");
+        ASSERT_EQ(flat_builder.flat_link_boxes().size(),
+                  tree_builder.flat_link_boxes().size());
+    }
+
+    // Test 6: Deep nesting hits the depth guard without recursion issues
+    {
+        std::string deep;
+        for (int i = 0; i < 60; ++i) deep += "> ";
+        deep += "deep *a **b** c*\n";
+        FlatAST flat;
+        parser->parse(deep, flat);
+        DomBuilder builder;
+        auto out = render(builder.build(flat), 5);
+        ASSERT_EQ(out, render(builder.build(parser->parse(deep)), 5));
+        ASSERT_CONTAINS(out, "deep");
+    }
+
+    // Test 7: Building an empty FlatAST is safe
+    {
+        DomBuilder builder;
+        FlatAST flat;
+        ASSERT_CONTAINS(render(builder.build(flat), 1), "");
+        ASSERT_TRUE(builder.link_targets().empty());
+    }
+
+    return 0;
+}
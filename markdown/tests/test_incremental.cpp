@@ -0,0 +1,179 @@
+#include "test_helper.hpp"
+#include "markdown/incremental.hpp"
+#include "markdown/parser.hpp"
+
+#include <string>
+
+using namespace markdown;
+
+namespace {
+
+// Apply text to the reparser and check the result against a full parse.
+bool check(IncrementalReparser& rp, MarkdownParser& parser,
+           MarkdownAST& ast, std::string const& text) {
+    rp.update(parser, text, ast);
+    return ast == parser.parse(text);
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: Block source offsets from the cmark parser
+    {
+        auto ast = parser->parse("# Title\n\nSome text\n\n- a\n- b\n");
+        ASSERT_EQ(ast.children.size(), 3u);
+        ASSERT_EQ(ast.children[0].source_begin, 0u);
+        ASSERT_EQ(ast.children[0].source_end, 7u);
+        ASSERT_EQ(ast.children[1].source_begin, 9u);
+        ASSERT_EQ(ast.children[1].source_end, 18u);
+        ASSERT_EQ(ast.children[2].source_begin, 20u);
+        ASSERT_EQ(ast.children[2].children[1].source_begin, 24u);
+        // Inline nodes carry no range
+        ASSERT_EQ(ast.children[1].children[0].source_end, 0u);
+    }
+
+    // Test 2: First update parses in full, unchanged text reparses nothing
+    {
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        std::string text = "Para one\n\nPara two\n";
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        ASSERT_TRUE(rp.last_was_full());
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        ASSERT_EQ(rp.last_reparsed_bytes(), 0u);
+        ASSERT_TRUE(!rp.last_was_full());
+    }
+
+    // Test 3: Typing inside one paragraph of a long document
+    {
+        std::string text;
+        for (int i = 0; i < 200; ++i) {
+            text += "## Section " + std::to_string(i) + "\n\n";
+            text += "Paragraph with **bold** and `code` number " +
+                    std::to_string(i) + ".\n\n";
+        }
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+
+        auto pos = text.find("number 100");
+        for (char c : std::string(" typed")) {
+            text.insert(pos, 1, c);
+            ++pos;
+            ASSERT_TRUE(check(rp, *parser, ast, text));
+            ASSERT_TRUE(!rp.last_was_full());
+            ASSERT_TRUE(rp.last_reparsed_bytes() < 300);
+        }
+    }
+
+    // Test 4: Deleting a blank line merges two paragraphs
+    {
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        std::string text = "# H\n\nalpha\n\nbeta\n\ngamma\n\n# End\n";
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        text.erase(text.find("alpha") + 6, 1);
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        ASSERT_EQ(ast.children.size(), 4u);
+        text.insert(text.find("beta"), "\n");
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        ASSERT_EQ(ast.children.size(), 5u);
+    }
+
+    // Test 5: Lists merge and split across blank lines
+    {
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        std::string text = "- one\n- two\n\npara\n\n- three\n\ntail\n";
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        text.replace(text.find("para"), 4, "- para");
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        text.replace(text.find("tail"), 4, "  tail");
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        text.replace(text.find("- para"), 6, "para");
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+    }
+
+    // Test 6: Opening and closing a code fence
+    {
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        std::string text = "intro\n\nbody\n\nmore\n\nend\n";
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        text.insert(text.find("body"), "```\n");
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        ASSERT_EQ(ast.children.size(), 2u);
+        text.insert(text.find("more"), "```\n");
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        text.insert(text.find("more"), "x");
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+    }
+
+    // Test 7: Setext underline and lazy continuation
+    {
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        std::string text = "> quote\n\nTitle\n\nnext\n";
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        text.insert(text.find("Title") + 6, "===\n");
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        ASSERT_EQ(ast.children[1].type, NodeType::Heading);
+        text.erase(text.find("quote") + 6, 1);
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+    }
+
+    // Test 8: Link reference definitions force a full parse
+    {
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        std::string text = "See [docs].\n\nother\n";
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        text += "\n[docs]: https://example.com\n";
+        ASSERT_TRUE(check(rp, *parser, ast, text));
+        ASSERT_TRUE(rp.last_was_full());
+        ASSERT_EQ(ast.children[0].children[1].type, NodeType::Link);
+    }
+
+    // Test 9: Deleting everything, then typing again
+    {
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        ASSERT_TRUE(check(rp, *parser, ast, "a\n\nb\n"));
+        ASSERT_TRUE(check(rp, *parser, ast, ""));
+        ASSERT_TRUE(check(rp, *parser, ast, "c"));
+        ASSERT_TRUE(check(rp, *parser, ast, "c\n\n---\n\nd"));
+        ASSERT_TRUE(check(rp, *parser, ast, "c\n\n---\nd"));
+    }
+
+    // Test 10: Buffers that record their edit, as the Editor's do
+    {
+        std::string text;
+        for (int i = 0; i < 200; ++i) {
+            text += "Paragraph " + std::to_string(i) + ".\n\n";
+        }
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        TextBuffer buffer(text);
+        rp.update(*parser, buffer, ast);
+        for (int i = 0; i < 20; ++i) {
+            text.insert(text.size() / 2, "x");
+            TextBuffer next(text, buffer);
+            auto edit = next.edit_from(buffer);
+            ASSERT_TRUE(edit.has_value());
+            ASSERT_EQ(edit->inserted, 1u);
+            rp.update(*parser, next, ast);
+            ASSERT_TRUE(ast == parser->parse(text));
+            ASSERT_TRUE(!rp.last_was_full());
+            ASSERT_TRUE(rp.text().data() == next.view().data());
+            buffer = next;
+        }
+        buffer.append("Tail.\n");
+        rp.update(*parser, buffer, ast);
+        ASSERT_TRUE(ast == parser->parse(buffer.view()));
+        ASSERT_TRUE(!rp.last_was_full());
+    }
+
+    return 0;
+}
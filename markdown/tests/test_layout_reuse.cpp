@@ -0,0 +1,91 @@
+#include "test_helper.hpp"
+#include "markdown/dom_builder.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/scroll_frame.hpp"
+
+#include <string>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+std::string document() {
+    std::string doc = "# Title\n\n```\ncode\n```\n\n";
+    for (int i = 0; i < 60; ++i) {
+        auto n = std::to_string(i);
+        doc += "Paragraph " + n + " with enough words to wrap at forty "
+               "columns, and [link " + n + "](https://" + n + ".com).\n\n";
+    }
+    return doc;
+}
+
+std::string render(ftxui::Element el, float ratio, int width) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(width),
+                                        ftxui::Dimension::Fixed(12));
+    ftxui::Render(screen, direct_scroll(std::move(el), ratio));
+    return screen.ToString();
+}
+
+bool same(ftxui::Box a, ftxui::Box b) {
+    return a.x_min == b.x_min && a.x_max == b.x_max && a.y_min == b.y_min &&
+           a.y_max == b.y_max;
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+    auto ast = parser->parse(document());
+
+    // Test 1: Scrolling a kept element matches fresh layouts
+    {
+        DomBuilder builder;
+        auto element = builder.build(ast);
+        for (float ratio : {0.0f, 0.3f, 0.31f, 0.9f, 0.5f, 0.0f}) {
+            DomBuilder fresh;
+            ASSERT_EQ(render(element, ratio, 40),
+                      render(fresh.build(ast), ratio, 40));
+            // Link boxes out of view are placed as reflect() places them.
+            for (size_t k : {0u, 20u, 40u, 59u}) {
+                ASSERT_TRUE(same(builder.link_targets()[k].boxes[0],
+                                 fresh.link_targets()[k].boxes[0]));
+            }
+            ASSERT_TRUE(same(builder.block_box(30), fresh.block_box(30)));
+        }
+    }
+
+    // Test 2: A focus move after scrolling shows up
+    {
+        DomBuilder builder;
+        auto element = builder.build(ast);
+        render(element, 0.0f, 40);
+        render(element, 0.5f, 40);
+        builder.set_focus(30);
+        DomBuilder fresh;
+        ASSERT_EQ(render(element, 0.5f, 40),
+                  render(fresh.build(ast, 30), 0.5f, 40));
+        // Only the blocks of the old and new link are laid out again.
+        for (int link : {31, 29, -1}) {
+            builder.set_focus(link);
+            DomBuilder expected;
+            ASSERT_EQ(render(element, 0.5f, 40),
+                      render(expected.build(ast, link), 0.5f, 40));
+        }
+    }
+
+    // Test 3: A new width lays everything out again
+    {
+        DomBuilder builder;
+        auto element = builder.build(ast);
+        render(element, 0.2f, 60);
+        DomBuilder fresh;
+        ASSERT_EQ(render(element, 0.2f, 40),
+                  render(fresh.build(ast), 0.2f, 40));
+        ASSERT_TRUE(same(builder.block_box(59), fresh.block_box(59)));
+    }
+
+    return 0;
+}
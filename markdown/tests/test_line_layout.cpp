@@ -0,0 +1,141 @@
+#include "test_helper.hpp"
+#include "markdown/dom_builder.hpp"
+#include "markdown/line_layout.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/theme.hpp"
+#include "markdown/viewer.hpp"
+
+#include <string>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+ftxui::Screen render(ftxui::Element el, int width, int height) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(width),
+                                        ftxui::Dimension::Fixed(height));
+    ftxui::Render(screen, el);
+    return screen;
+}
+
+std::string row(ftxui::Screen& screen, int y) {
+    std::string out;
+    for (int x = 0; x < screen.dimx(); ++x) {
+        out += screen.PixelAt(x, y).character;
+    }
+    return out;
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: Blocks keep their prefixes and a blank row between them
+    {
+        auto ast = parser->parse("# Title\n\n- one\n- two\n\n> quoted\n\n"
+                                 "```py\nx = 1\n```\n");
+        DomBuilder builder;
+        builder.set_line_layout(true);
+        auto screen = render(builder.build(ast), 30, 12);
+        ASSERT_CONTAINS(row(screen, 0), "Title");
+        ASSERT_CONTAINS(row(screen, 2), "• one");
+        ASSERT_CONTAINS(row(screen, 3), "• two");
+        ASSERT_CONTAINS(row(screen, 5), "│ quoted");
+        ASSERT_CONTAINS(row(screen, 7), "╭ py ─");
+        ASSERT_CONTAINS(row(screen, 8), "│x = 1");
+        ASSERT_CONTAINS(row(screen, 9), "╰─");
+        ASSERT_TRUE(screen.PixelAt(0, 0).bold);
+        ASSERT_EQ(builder.block_count(), 4u);
+        ASSERT_EQ(builder.block_box(1).y_min, 2);
+        ASSERT_EQ(builder.block_box(1).y_max, 3);
+        ASSERT_EQ(builder.block_at_row(8), 3);
+    }
+
+    // Test 2: Words wrap to the laid out width, continuation lines indented
+    {
+        std::string doc = "- ";
+        for (int i = 0; i < 12; ++i) doc += "word ";
+        LineLayout layout(parser->parse(doc), theme_default(), 10);
+        ASSERT_EQ(layout.line_count(80), 1);
+        int narrow = layout.line_count(20);
+        ASSERT_TRUE(narrow > 2);
+
+        DomBuilder builder;
+        builder.set_line_layout(true);
+        auto screen = render(builder.build(parser->parse(doc)), 20, 8);
+        ASSERT_CONTAINS(row(screen, 0), "• word word");
+        ASSERT_EQ(row(screen, 1).substr(0, 9), "     word");
+        ASSERT_EQ(builder.block_box(0).y_max, narrow - 1);
+    }
+
+    // Test 3: Link words get boxes, and focus inverts them without a build
+    {
+        auto ast = parser->parse("See [the docs](https://x.com) here\n");
+        DomBuilder builder;
+        builder.set_line_layout(true);
+        auto element = builder.build(ast);
+        auto screen = render(element, 40, 3);
+        ASSERT_EQ(builder.link_targets().size(), 1u);
+        ASSERT_EQ(builder.link_targets()[0].url, "https://x.com");
+        auto const& boxes = builder.link_targets()[0].boxes;
+        ASSERT_EQ(boxes.size(), 2u);
+        ASSERT_EQ(builder.flat_link_boxes().size(), 2u);
+        ASSERT_EQ(boxes[0].x_min, 3);  // " the" keeps its space
+        ASSERT_EQ(boxes[0].y_min, 0);
+        ASSERT_TRUE(screen.PixelAt(4, 0).underlined);
+        ASSERT_TRUE(!screen.PixelAt(4, 0).inverted);
+
+        builder.set_focus(0);
+        screen = render(element, 40, 3);
+        ASSERT_TRUE(screen.PixelAt(4, 0).inverted);
+        ASSERT_TRUE(!screen.PixelAt(0, 0).inverted);
+    }
+
+    // Test 4: Only the visible lines are painted; other links stay empty
+    {
+        std::string doc;
+        for (int i = 0; i < 5000; ++i) {
+            doc += "Paragraph [" + std::to_string(i) + "](https://" +
+                   std::to_string(i) + ".com)\n\n";
+        }
+        DomBuilder builder;
+        builder.set_line_layout(true);
+        auto element = builder.build(parser->parse(doc));
+        auto screen = render(element, 40, 10);
+        ASSERT_CONTAINS(row(screen, 0), "Paragraph 0");
+        auto const& first = builder.link_targets()[0].boxes[0];
+        auto const& last = builder.link_targets()[4999].boxes[0];
+        ASSERT_EQ(first.y_min, 0);
+        ASSERT_TRUE(last.y_max < last.y_min);
+        ASSERT_EQ(builder.block_count(), 5000u);
+        ASSERT_EQ(builder.block_box(4999).y_min, 2 * 4999);
+        ASSERT_EQ(builder.block_at_source(doc.size() - 1), 4999);
+
+        // The focused link is placed out of view too, for scroll_to_focus.
+        builder.set_focus(4999);
+        ftxui::Render(screen, element);
+        ASSERT_EQ(last.y_min, 2 * 4999);
+        ASSERT_TRUE(last.y_max < last.y_min);
+    }
+
+    // Test 5: Viewer renders through the line layout when asked to
+    {
+        Viewer viewer(make_cmark_parser());
+        viewer.set_line_layout(true);
+        ASSERT_TRUE(viewer.line_layout());
+        viewer.set_content("Hello **world**\n\n[link](https://a.com)\n");
+        auto comp = viewer.component();
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(40),
+                                            ftxui::Dimension::Fixed(6));
+        ftxui::Render(screen, comp->Render());
+        ASSERT_CONTAINS(screen.ToString(), "Hello");
+        ASSERT_CONTAINS(screen.ToString(), "link");
+        ASSERT_EQ(viewer.index().links().size(), 1u);
+    }
+
+    return 0;
+}
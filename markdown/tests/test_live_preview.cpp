@@ -0,0 +1,132 @@
+#include "test_helper.hpp"
+#include "markdown/live_preview.hpp"
+#include "markdown/parser.hpp"
+
+#include <string>
+#include <thread>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+std::string render(ftxui::Component const& comp) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(100),
+                                        ftxui::Dimension::Fixed(20));
+    ftxui::Render(screen, comp->Render());
+    return screen.ToString();
+}
+
+// What the preview pane shows, without the editor beside it.
+std::string shown(LivePreview& preview) {
+    return render(preview.viewer().component());
+}
+
+std::string make_doc(int paragraphs, std::string const& marker) {
+    std::string doc = "# " + marker + "\n\n";
+    for (int i = 0; i < paragraphs; ++i) {
+        doc += "Paragraph " + std::to_string(i) +
+               " with **bold** and a [link](https://x.com).\n\n";
+    }
+    return doc;
+}
+
+} // namespace
+
+int main() {
+    // Test 1: Cheap updates reach the preview on the same frame
+    {
+        LivePreview preview(make_cmark_parser());
+        auto comp = preview.component();
+        preview.editor().set_content("# First");
+        render(comp);
+        ASSERT_CONTAINS(shown(preview), "First");
+        ASSERT_EQ(preview.debounce_interval().count(), 0);
+
+        preview.editor().set_content("# Second");
+        ASSERT_TRUE(preview.pending());
+        render(comp);
+        ASSERT_TRUE(!preview.pending());
+        auto out = shown(preview);
+        ASSERT_CONTAINS(out, "Second");
+        ASSERT_TRUE(out.find("First") == std::string::npos);
+    }
+
+    // Test 2: Updates over budget are held until typing pauses
+    {
+        LivePreview preview(make_cmark_parser());
+        preview.set_frame_budget(LivePreview::Duration{0});
+        auto comp = preview.component();
+        preview.editor().set_content(make_doc(200, "Before"));
+        render(comp);  // nothing measured yet: forwarded at once
+        ASSERT_CONTAINS(shown(preview), "Before");
+        render(comp);
+        ASSERT_TRUE(preview.measured_cost().count() > 0);
+        auto interval = preview.debounce_interval();
+        ASSERT_TRUE(interval.count() > 0);
+
+        preview.editor().set_content(make_doc(200, "After"));
+        render(comp);
+        ASSERT_TRUE(preview.pending());
+        ASSERT_CONTAINS(shown(preview), "Before");
+
+        std::this_thread::sleep_for(interval + std::chrono::milliseconds(5));
+        render(comp);
+        ASSERT_TRUE(!preview.pending());
+        ASSERT_CONTAINS(shown(preview), "After");
+    }
+
+    // Test 3: flush() forwards at once regardless of the debounce
+    {
+        LivePreview preview(make_cmark_parser());
+        preview.set_frame_budget(LivePreview::Duration{0});
+        auto comp = preview.component();
+        preview.editor().set_content(make_doc(200, "Old"));
+        render(comp);
+        render(comp);
+        preview.editor().set_content(make_doc(200, "New"));
+        preview.flush();
+        ASSERT_TRUE(!preview.pending());
+        ASSERT_CONTAINS(shown(preview), "New");
+    }
+
+    // Test 4: The preview follows the editor cursor (cursor info is
+    // refreshed by the editor's render, so it shows one frame later)
+    {
+        LivePreview preview(make_cmark_parser());
+        auto comp = preview.component();
+        preview.editor().set_content(make_doc(50, "Scroll"));
+        render(comp);
+        int last = preview.editor().total_lines();
+        ASSERT_TRUE(last > 1);
+        preview.editor().set_cursor(last, 1);
+        render(comp);
+        render(comp);
+        ASSERT_EQ(preview.viewer().scroll(), 1.0f);
+        preview.editor().set_cursor(1, 1);
+        render(comp);
+        render(comp);
+        ASSERT_EQ(preview.viewer().scroll(), 0.0f);
+
+        preview.set_scroll_sync(false);
+        preview.editor().set_cursor(last, 1);
+        render(comp);
+        render(comp);
+        ASSERT_EQ(preview.viewer().scroll(), 0.0f);
+    }
+
+    // Test 5: An async viewer is never debounced
+    {
+        LivePreview preview(make_cmark_parser());
+        preview.set_frame_budget(LivePreview::Duration{0});
+        preview.viewer().set_async(true);
+        preview.editor().set_content("# Async");
+        preview.sync();
+        ASSERT_EQ(preview.debounce_interval().count(), 0);
+        ASSERT_TRUE(!preview.pending());
+    }
+
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include "test_helper.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/viewer.hpp"
+
+#include <chrono>
+#include <stop_token>
+#include <string>
+
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+using Clock = std::chrono::steady_clock;
+
+// How far a bounded parse may run past its budget (generous for CI).
+constexpr auto kOvershoot = std::chrono::milliseconds(250);
+
+namespace {
+
+std::string long_doc(size_t sections) {
+    std::string doc;
+    for (size_t i = 0; i < sections; ++i) {
+        auto n = std::to_string(i);
+        doc += "## Section " + n + "\n\n";
+        doc += "Paragraph " + n + " with **bold**, *italic* and a "
+               "[link](https://example.com/" + n + ").\n\n";
+        doc += "- point one\n- point two\n\n";
+        doc += "```cpp\nint x = " + n + ";\n```\n\n";
+    }
+    return doc;
+}
+
+// A pasted log: one paragraph of many short lines.
+std::string log_lines(size_t lines) {
+    std::string doc;
+    for (size_t i = 0; i < lines; ++i) {
+        doc += "2024-05-01 12:00:" + std::to_string(i % 60) +
+               " INFO [worker-" + std::to_string(i % 8) + "] request " +
+               std::to_string(i) + " done in *" + std::to_string(i % 97) +
+               "ms*\n";
+    }
+    return doc;
+}
+
+// Blocks parsed in time precede the raw remainder, and the remainder
+// holds the input verbatim from where it starts.
+bool well_formed_partial(std::string_view input, MarkdownAST const& ast) {
+    if (ast.children.empty()) return false;
+    auto const& raw = ast.children.back();
+    if (raw.type != NodeType::Paragraph || raw.children.size() != 1) {
+        return false;
+    }
+    if (raw.source_end != input.size() ||
+        raw.children[0].text != input.substr(raw.source_begin)) {
+        return false;
+    }
+    size_t last = 0;
+    for (auto const& block : ast.children) {
+        if (block.source_begin < last) return false;
+        last = block.source_begin;
+    }
+    return true;
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: Unbounded and roomy limits give the plain parse
+    {
+        auto doc = long_doc(20);
+        MarkdownAST ast;
+        ASSERT_TRUE(parser->parse(doc, ast, ParseLimits{}) ==
+                    ParseStatus::Complete);
+        ASSERT_TRUE(ast == parser->parse(doc));
+        auto roomy = ParseLimits::within(std::chrono::seconds(30));
+        ASSERT_TRUE(parser->parse(doc, ast, roomy) == ParseStatus::Complete);
+        ASSERT_TRUE(ast == parser->parse(doc));
+    }
+
+    // Test 2: An expired deadline or a stop request yields raw text
+    {
+        std::string doc = "# Title\n\nSome *text*.\n";
+        MarkdownAST ast;
+        ParseLimits past{.deadline = Clock::now() - std::chrono::seconds(1)};
+        ASSERT_TRUE(parser->parse(doc, ast, past) == ParseStatus::Partial);
+        ASSERT_EQ(ast.children.size(), 1u);
+        ASSERT_EQ(ast.children[0].children[0].text, doc);
+
+        std::stop_source stop;
+        stop.request_stop();
+        ParseLimits stopped{.stop = stop.get_token()};
+        ASSERT_TRUE(parser->parse(doc, ast, stopped) == ParseStatus::Partial);
+        ASSERT_TRUE(well_formed_partial(doc, ast));
+    }
+
+    // Test 3: Other parsers honour the limits too
+    {
+        std::string doc = "<div>html is outside the fast subset</div>\n";
+        auto fast = make_fast_parser();
+        MarkdownAST ast;
+        ParseLimits past{.deadline = Clock::now()};
+        ASSERT_TRUE(fast->parse(doc, ast, past) == ParseStatus::Partial);
+        ASSERT_TRUE(well_formed_partial(doc, ast));
+        ASSERT_TRUE(fast->parse("plain text\n", ast, past) ==
+                    ParseStatus::Complete);
+    }
+
+    // Test 4: A large document stops near the budget, keeping a prefix
+    {
+        auto doc = long_doc(40000);
+        auto start = Clock::now();
+        auto whole = parser->parse(doc);
+        auto full = Clock::now() - start;
+
+        auto budget = std::chrono::duration_cast<Clock::duration>(full / 10);
+        MarkdownAST ast;
+        start = Clock::now();
+        auto status = parser->parse(doc, ast, ParseLimits::within(budget));
+        auto bounded = Clock::now() - start;
+        ASSERT_TRUE(status == ParseStatus::Partial);
+        ASSERT_TRUE(well_formed_partial(doc, ast));
+        ASSERT_TRUE(bounded < budget + kOvershoot);
+        // The blocks kept match the whole parse.
+        ASSERT_TRUE(ast.children.size() > 1);
+        ASSERT_TRUE(ast.children[0] == whole.children[0]);
+    }
+
+    // Test 5: A pasted log, one paragraph with no blank lines
+    {
+        auto doc = log_lines(50000);
+        auto start = Clock::now();
+        parser->parse(doc);
+        auto full = Clock::now() - start;
+        auto budget = std::chrono::duration_cast<Clock::duration>(full / 10);
+        MarkdownAST ast;
+        start = Clock::now();
+        auto status = parser->parse(doc, ast, ParseLimits::within(budget));
+        auto bounded = Clock::now() - start;
+        ASSERT_TRUE(status == ParseStatus::Partial);
+        ASSERT_TRUE(well_formed_partial(doc, ast));
+        ASSERT_TRUE(bounded < budget + kOvershoot);
+    }
+
+    // Test 6: Viewer with a parse budget shows the partial result
+    {
+        Viewer viewer(make_cmark_parser());
+        viewer.set_parse_budget(std::chrono::microseconds(1));
+        viewer.set_content(long_doc(2000));
+        auto comp = viewer.component();
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                            ftxui::Dimension::Fixed(10));
+        ftxui::Render(screen, comp->Render());
+        ASSERT_TRUE(viewer.last_parse_partial());
+        ASSERT_CONTAINS(screen.ToString(), "Section 0");
+
+        viewer.set_parse_budget(std::chrono::microseconds(0));
+        viewer.set_content("# Small\n");
+        ftxui::Render(screen, comp->Render());
+        ASSERT_TRUE(!viewer.last_parse_partial());
+        ASSERT_CONTAINS(screen.ToString(), "Small");
+    }
+
+    // Test 7: Chunks keep fenced code whole and match the whole parse
+    {
+        std::string doc;
+        for (int i = 0; i < 40; ++i) {
+            doc += "```\n";
+            for (int j = 0; j < 2000; ++j) doc += "code line\n\n";
+            doc += "```\n\n";
+            doc += long_doc(20);
+        }
+        auto start = Clock::now();
+        auto whole = parser->parse(doc);
+        auto full = Clock::now() - start;
+        auto budget = std::chrono::duration_cast<Clock::duration>(full / 3);
+        MarkdownAST ast;
+        auto status = parser->parse(doc, ast, ParseLimits::within(budget));
+        ASSERT_TRUE(status == ParseStatus::Partial);
+        ASSERT_TRUE(well_formed_partial(doc, ast));
+        for (size_t i = 0; i + 1 < ast.children.size(); ++i) {
+            ASSERT_TRUE(ast.children[i] == whole.children[i]);
+        }
+    }
+
+    // Test 8: A definition at the end still applies to the blocks kept
+    {
+        auto doc = "[ref]\n\n" + long_doc(40000) + "[ref]: /url\n";
+        auto start = Clock::now();
+        auto whole = parser->parse(doc);
+        auto full = Clock::now() - start;
+        auto budget = std::chrono::duration_cast<Clock::duration>(full / 10);
+        MarkdownAST ast;
+        auto status = parser->parse(doc, ast, ParseLimits::within(budget));
+        ASSERT_TRUE(status == ParseStatus::Partial);
+        ASSERT_TRUE(well_formed_partial(doc, ast));
+        ASSERT_TRUE(ast.children.size() > 1);
+        ASSERT_TRUE(whole.children[0].children[0].type == NodeType::Link);
+        for (size_t i = 0; i + 1 < ast.children.size(); ++i) {
+            ASSERT_TRUE(ast.children[i] == whole.children[i]);
+        }
+    }
+
+    // Test 9: The budget also bounds the first parse after appending
+    {
+        Viewer viewer(make_cmark_parser());
+        viewer.set_parse_budget(std::chrono::microseconds(1));
+        viewer.set_content("# Title\n");
+        auto comp = viewer.component();
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                            ftxui::Dimension::Fixed(10));
+        ftxui::Render(screen, comp->Render());
+        viewer.append_content("\n" + long_doc(2000));
+        ftxui::Render(screen, comp->Render());
+        ASSERT_TRUE(viewer.last_parse_partial());
+
+        viewer.set_parse_budget(std::chrono::microseconds(0));
+        viewer.append_content("More text.\n");
+        ftxui::Render(screen, comp->Render());
+        ASSERT_TRUE(!viewer.last_parse_partial());
+        ASSERT_CONTAINS(screen.ToString(), "Title");
+    }
+
+    // Test 10: Chunks with a definition head finish equal to the whole parse
+    {
+        auto doc = "[ref]\n\n" + long_doc(2000) + "[ref]: /url\n";
+        MarkdownAST ast;
+        auto roomy = ParseLimits::within(std::chrono::seconds(30));
+        ASSERT_TRUE(parser->parse(doc, ast, roomy) == ParseStatus::Complete);
+        ASSERT_TRUE(ast == parser->parse(doc));
+    }
+
+    return 0;
+}
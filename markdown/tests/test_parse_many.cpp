@@ -0,0 +1,122 @@
+#include "test_helper.hpp"
+#include "markdown/parallel.hpp"
+#include "markdown/parser.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace markdown;
+
+namespace {
+
+// An inbox of message bodies of very different sizes.
+std::vector<std::string> make_inbox(int count) {
+    std::vector<std::string> inbox;
+    for (int i = 0; i < count; ++i) {
+        std::string body = "Hi **" + std::to_string(i) + "**,\n\n";
+        int paragraphs = 1 + (i * 37) % 40;
+        for (int p = 0; p < paragraphs; ++p) {
+            body += "Paragraph " + std::to_string(p) + " with *emphasis*, "
+                    "`code` and [a link](https://example.com/" +
+                    std::to_string(p) + ").\n\n";
+            if (p % 5 == 0) body += "- item one\n- item two\n\n";
+            if (p % 9 == 0) body += "```\ncode block\n```\n\n";
+        }
+        body += "> quoted reply\n> continues\n";
+        inbox.push_back(std::move(body));
+    }
+    inbox.push_back("");
+    return inbox;
+}
+
+std::vector<std::string_view> views(std::vector<std::string> const& docs) {
+    return {docs.begin(), docs.end()};
+}
+
+// Echoes its input as text and reports failure.
+class FailingParser : public MarkdownParser {
+public:
+    bool parse(std::string_view input, MarkdownAST& out) override {
+        out = ASTNode{.type = NodeType::Text, .text = std::string(input)};
+        return false;
+    }
+};
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+    auto inbox = make_inbox(300);
+    auto inputs = views(inbox);
+
+    std::vector<MarkdownAST> expected;
+    for (auto input : inputs) expected.push_back(parser->parse(input));
+
+    // Test 1: Every thread count yields the sequential results, in order
+    for (unsigned threads : {1u, 2u, 7u, 0u}) {
+        auto result = parse_many(inputs, {.threads = threads});
+        ASSERT_EQ(result.size(), inputs.size());
+        ASSERT_TRUE(result == expected);
+    }
+
+    // Test 2: One parser per worker, never more workers than inputs
+    {
+        std::atomic<int> created{0};
+        ParseManyOptions options{
+            .threads = 8,
+            .make_parser = [&] {
+                ++created;
+                return make_cmark_parser();
+            }};
+        std::vector<MarkdownAST> out(inputs.size());
+        ASSERT_EQ(parse_many(inputs, out, options), inputs.size());
+        ASSERT_EQ(created.load(), 8);
+        ASSERT_TRUE(out == expected);
+
+        created = 0;
+        auto few = std::span(inputs).first(3);
+        auto result = parse_many(few, options);
+        ASSERT_EQ(created.load(), 3);
+        ASSERT_TRUE(std::equal(result.begin(), result.end(), expected.begin()));
+    }
+
+    // Test 3: Empty batches and failed parses
+    {
+        ASSERT_TRUE(parse_many(std::span<std::string_view const>()).empty());
+        std::vector<MarkdownAST> out(2);
+        std::string_view two[] = {"a", "b"};
+        ParseManyOptions failing{
+            .threads = 2,
+            .make_parser = [] { return std::make_unique<FailingParser>(); }};
+        ASSERT_EQ(parse_many(two, out, failing), 0u);
+        ASSERT_EQ(out[1].text, "b");
+    }
+
+    // Test 4: Throughput against a sequential loop
+    {
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<MarkdownAST> out(inputs.size());
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            parser->parse(inputs[i], out[i]);
+        }
+        auto mid = std::chrono::high_resolution_clock::now();
+        parse_many(inputs, out);
+        auto end = std::chrono::high_resolution_clock::now();
+        double seq = std::chrono::duration<double, std::milli>(mid - start)
+                         .count();
+        double par = std::chrono::duration<double, std::milli>(end - mid)
+                         .count();
+        std::cout << inputs.size() << " bodies: sequential " << seq
+                  << " ms, parse_many " << par << " ms on " << cores
+                  << " threads (" << seq / par << "x)\n";
+        ASSERT_TRUE(out == expected);
+    }
+
+    return 0;
+}
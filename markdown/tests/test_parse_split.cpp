@@ -0,0 +1,187 @@
+#include "test_helper.hpp"
+#include "markdown/parallel.hpp"
+#include "markdown/parser.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace markdown;
+
+namespace {
+
+// Blocks the random documents are made of, each ending in a newline.
+// Several run past blank lines or reach across the document.
+std::string const kBlocks[] = {
+    "# Heading\n",
+    "Setext title\n============\n",
+    "Plain paragraph with *emphasis* and `code`.\n",
+    "Lazy paragraph\ncontinued on a second line\n",
+    "A [reference link][ref] and a [shortcut] link.\n",
+    "[ref]: https://example.com/ref \"Title\"\n",
+    "[shortcut]: /short\n",
+    "[Multi\nline]: /multi\n",
+    "Uses [multi line] too.\n",
+    "- item one\n- item two\n",
+    "- loose item\n\n- second loose item\n",
+    "1. step\n\n   ```sh\n   make\n\n   make test\n   ```\n",
+    "2) late start\n",
+    "    indented code\n\n    more code\n",
+    "```\nfenced\n\nwith a blank line\n```\n",
+    "~~~~ info\n~~~\n\n# not a heading\n~~~~\n",
+    "```\nunclosed fence\n",
+    "> quoted\n> lines\n\n> second quote\n",
+    "> lazy\nquote\n",
+    "<!-- comment\n\nspanning blank lines -->\n",
+    "<div>\nhtml block\n</div>\n",
+    "<script>\nlet a = 1;\n\nlet b = 2;\n</script>\n",
+    "---\n",
+    "***\n",
+    "Hard  \nbreak\n",
+    "\t tab indented\n",
+    "   indented three\n",
+    "- a\n  ```\n\n```\ncode\n\nafter\n```\n",
+};
+
+std::string random_doc(std::mt19937& rng, int blocks) {
+    std::uniform_int_distribution<size_t> pick(0, std::size(kBlocks) - 1);
+    std::uniform_int_distribution<int> gap(0, 4);
+    std::string doc;
+    for (int i = 0; i < blocks; ++i) {
+        doc += kBlocks[pick(rng)];
+        int g = gap(rng);
+        if (g > 0) doc += "\n";
+        if (g > 3) doc += "  \n";
+    }
+    return doc;
+}
+
+// A long design document without reference definitions.
+std::string long_doc(size_t sections) {
+    std::string doc;
+    for (size_t i = 0; i < sections; ++i) {
+        auto n = std::to_string(i);
+        doc += "## Section " + n + "\n\n";
+        doc += "Paragraph " + n + " with **bold**, *italic* and a "
+               "[link](https://example.com/" + n + ").\nA second line.\n\n";
+        doc += "- point one\n- point two\n  continued\n\n";
+        doc += "```cpp\nint x = " + n + ";\n\nreturn x;\n```\n\n";
+        doc += "> A quote\n\n";
+    }
+    return doc;
+}
+
+ParallelParseOptions small_chunks(unsigned threads) {
+    return {.threads = threads, .min_chunk_bytes = 1};
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: Split points skip fences, HTML blocks, lists and indentation
+    {
+        std::string doc = "Intro\n\n"
+                          "```\na\n\nb\n```\n\n"
+                          "<!--\n\n-->\n\n"
+                          "- item\n\n"
+                          "- item\n\n"
+                          "  more\n\n"
+                          "Outro\n";
+        auto points = split_points(doc);
+        ASSERT_EQ(points.size(), 3u);
+        ASSERT_EQ(points[0], doc.find("```"));
+        ASSERT_EQ(points[1], doc.find("<!--"));
+        ASSERT_EQ(points[2], doc.find("Outro"));
+        ASSERT_TRUE(split_points("a\r\rb\n\nc\n").empty());
+        ASSERT_TRUE(split_points("\xEF\xBB\xBF" "a\n\nb\n").empty());
+    }
+
+    // Test 2: Differential against a whole parse, cut at every point
+    {
+        std::mt19937 rng(12345);
+        for (int round = 0; round < 400; ++round) {
+            auto doc = random_doc(rng, 4 + round % 30);
+            MarkdownAST split;
+            ASSERT_TRUE(parse_parallel(doc, split, small_chunks(1 + round % 4)));
+            auto whole = parser->parse(doc);
+            if (!(split == whole)) {
+                std::cerr << "Mismatch for document:\n" << doc << "\n";
+                return 1;
+            }
+        }
+    }
+
+    // Test 3: References resolve across chunks in both directions
+    {
+        std::string doc = "See [early] and [late].\n\n"
+                          "[early]: /early\n\n";
+        for (int i = 0; i < 50; ++i) doc += "Filler paragraph.\n\n";
+        doc += "Again [early] and [late].\n\n[late]: /late\n";
+        MarkdownAST split;
+        ASSERT_TRUE(parse_parallel(doc, split, small_chunks(4)));
+        ASSERT_TRUE(split == parser->parse(doc));
+        ASSERT_EQ(split.children.front().children[1].url, "/early");
+        ASSERT_EQ(split.children.front().children[3].url, "/late");
+    }
+
+    // Test 4: Plain documents are split, and a misleading cut falls back
+    {
+        std::atomic<int> created{0};
+        ParallelParseOptions options{
+            .threads = 3,
+            .make_parser = [&] {
+                ++created;
+                return make_cmark_parser();
+            },
+            .min_chunk_bytes = 64};
+        auto doc = long_doc(40);
+        MarkdownAST split;
+        ASSERT_TRUE(parse_parallel(doc, split, options));
+        ASSERT_TRUE(split == parser->parse(doc));
+        ASSERT_EQ(created.load(), 3);
+
+        // The fence inside the list item hides the top-level fence that
+        // its closing line opens; the sentinel check catches the bad cut.
+        created = 0;
+        auto tricky = long_doc(2) + "- a\n  ```\n\n```\ncode\n\nz\n```\n\n" +
+                      long_doc(2);
+        ASSERT_TRUE(parse_parallel(tricky, split, options));
+        ASSERT_TRUE(split == parser->parse(tricky));
+        ASSERT_EQ(created.load(), 4);
+    }
+
+    // Test 5: make_parallel_parser() matches the plain parser
+    {
+        auto parallel = make_parallel_parser(small_chunks(2));
+        auto doc = long_doc(5);
+        ASSERT_TRUE(parallel->parse(doc) == parser->parse(doc));
+        ASSERT_TRUE(parallel->parse("") == parser->parse(""));
+    }
+
+    // Test 6: Throughput on a multi-megabyte document
+    {
+        auto doc = long_doc(20000);
+        MarkdownAST whole, split;
+        auto start = std::chrono::high_resolution_clock::now();
+        parser->parse(doc, whole);
+        auto mid = std::chrono::high_resolution_clock::now();
+        parse_parallel(doc, split);
+        auto end = std::chrono::high_resolution_clock::now();
+        double seq = std::chrono::duration<double, std::milli>(mid - start)
+                         .count();
+        double par = std::chrono::duration<double, std::milli>(end - mid)
+                         .count();
+        std::cout << doc.size() / 1024 << " KB: whole parse " << seq
+                  << " ms, parse_parallel " << par << " ms (" << seq / par
+                  << "x)\n";
+        ASSERT_TRUE(split == whole);
+    }
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "test_helper.hpp"
+#include "markdown/dom_builder.hpp"
+#include "markdown/parser.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+size_t g_allocations = 0;
+
+} // namespace
+
+// Every heap allocation of the process goes through here.
+void* operator new(std::size_t size) {
+    ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+// Long-form prose: paragraphs of about 100 words, some with bold, italic
+// and a link, some plain, and a heading every ten.
+std::string document() {
+    std::string const sentence =
+        "The quick brown fox jumps over the lazy dog while the reader "
+        "keeps scrolling down the page. ";
+    std::string doc;
+    for (int i = 0; i < 200; ++i) {
+        auto n = std::to_string(i);
+        if (i % 10 == 0) doc += "## Chapter " + n + "\n\n";
+        for (int s = 0; s < 6; ++s) doc += sentence;
+        if (i % 2 == 0) {
+            doc += "Then **a bold phrase** and *one* more";
+            if (i % 4 == 0) doc += " [link](https://example.com/" + n + ")";
+            doc += ".";
+        }
+        doc += "\n\n";
+    }
+    return doc;
+}
+
+size_t count_words(std::string const& doc) {
+    size_t words = 0;
+    bool in_word = false;
+    for (char c : doc) {
+        bool space = c == ' ' || c == '\n';
+        if (!space && !in_word) ++words;
+        in_word = !space;
+    }
+    return words;
+}
+
+size_t build(DomBuilder& builder, MarkdownAST const& ast,
+             ftxui::Element& element) {
+    size_t before = g_allocations;
+    element = builder.build(ast);
+    return g_allocations - before;
+}
+
+std::string render(ftxui::Element const& element) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(80),
+                                        ftxui::Dimension::Fixed(1600));
+    ftxui::Render(screen, element);
+    return screen.ToString();
+}
+
+} // namespace
+
+int main() {
+    auto doc = document();
+    auto parser = make_cmark_parser();
+    auto ast = parser->parse(doc);
+    size_t words = count_words(doc);
+
+    // Test 1: A cold pooled build allocates an order of magnitude less
+    {
+        DomBuilder plain;
+        plain.set_node_pool(false);
+        ASSERT_TRUE(!plain.node_pool());
+        ftxui::Element plain_element;
+        size_t plain_count = build(plain, ast, plain_element);
+
+        DomBuilder pooled;
+        ASSERT_TRUE(pooled.node_pool());
+        ftxui::Element pooled_element;
+        size_t pooled_count = build(pooled, ast, pooled_element);
+
+        std::cout << "Words:               " << words << "\n";
+        std::cout << "Unpooled build:      " << plain_count
+                  << " allocations\n";
+        std::cout << "Pooled build:        " << pooled_count
+                  << " allocations\n";
+        std::cout << "Ratio:               "
+                  << static_cast<double>(plain_count) / pooled_count << "\n";
+        ASSERT_TRUE(plain_count > words);
+        ASSERT_TRUE(pooled_count * 10 <= plain_count);
+
+        // Same output, links and source map either way.
+        ASSERT_EQ(render(pooled_element), render(plain_element));
+        ASSERT_EQ(pooled.link_targets().size(), plain.link_targets().size());
+        ASSERT_EQ(pooled.block_count(), plain.block_count());
+    }
+
+    // Test 2: A warm rebuild allocates less than a cold one
+    {
+        DomBuilder builder;
+        ftxui::Element element;
+        size_t cold = build(builder, ast, element);
+        size_t warm = build(builder, ast, element);
+        std::cout << "Warm rebuild:        " << warm << " allocations\n";
+        ASSERT_TRUE(warm < cold);
+        ASSERT_EQ(builder.reused_blocks(), builder.block_count());
+    }
+
+    // Test 3: Pooled nodes outlive the build that made them
+    {
+        DomBuilder builder;
+        ftxui::Element first;
+        build(builder, ast, first);
+        auto expected = render(first);
+        first = nullptr;
+        // Every block comes from the memo, made in the first build's pool.
+        ftxui::Element second;
+        build(builder, ast, second);
+        ASSERT_EQ(render(second), expected);
+    }
+
+    // Test 4: Drawing the words of a laid out element allocates nothing
+    {
+        DomBuilder builder;
+        ftxui::Element element;
+        build(builder, ast, element);
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(80),
+                                            ftxui::Dimension::Fixed(1600));
+        ftxui::Render(screen, element);
+        size_t before = g_allocations;
+        ftxui::Render(screen, element);
+        size_t frame = g_allocations - before;
+        std::cout << "Warm frame:          " << frame << " allocations\n";
+        ASSERT_TRUE(frame * 10 < words);
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include "test_helper.hpp"
+#include "markdown/flat_ast.hpp"
+#include "markdown/parser.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace markdown;
+
+// Count C++ heap allocations.  cmark allocates with malloc, so during a
+// parse these are the allocations of the AST conversion.
+static long g_allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++g_allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+// Lower bound on the allocations an AST needs: one per non-empty children
+// vector and one per string too long for the small-string buffer.
+long required_allocations(ASTNode const& root) {
+    long n = 0;
+    auto const sso = std::string().capacity();
+    std::vector<ASTNode const*> stack{&root};
+    while (!stack.empty()) {
+        auto const* node = stack.back();
+        stack.pop_back();
+        if (!node->children.empty()) ++n;
+        for (auto const* s : {&node->text, &node->url, &node->info}) {
+            if (s->size() > sso) ++n;
+        }
+        for (auto const& child : node->children) stack.push_back(&child);
+    }
+    return n;
+}
+
+// Blockquotes nested one level deeper per line, as in the depth demo.
+std::string make_deep_quotes(int max_depth) {
+    std::string doc;
+    for (int depth = 1; depth <= max_depth; ++depth) {
+        std::string prefix(depth, '>');
+        prefix += ' ';
+        doc += prefix + "**Level " + std::to_string(depth) +
+               "** with [a link](https://example.com)\n";
+        doc += prefix + "\n";
+    }
+    return doc;
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: Conversion allocates each children vector once
+    {
+        std::string doc;
+        for (int i = 0; i < 500; ++i) {
+            doc += "## Section " + std::to_string(i) + "\n\n";
+            doc += "Paragraph with **bold**, *italic*, `code` and [link"
+                   + std::to_string(i) + "](https://example.com/"
+                   + std::to_string(i) + ").\n\n";
+            doc += "- item one\n- item two\n\n";
+        }
+        MarkdownAST ast;
+        parser->parse(doc, ast);  // warm up
+
+        long before = g_allocations;
+        auto start = std::chrono::high_resolution_clock::now();
+        parser->parse(doc, ast);
+        auto end = std::chrono::high_resolution_clock::now();
+        long allocations = g_allocations - before;
+        long required = required_allocations(ast);
+        double ms = std::chrono::duration<double, std::milli>(
+            end - start).count();
+
+        std::cout << "Parse + convert: " << ms << " ms, " << allocations
+                  << " allocations (" << required << " required) for "
+                  << doc.size() << " bytes\n";
+        // A few allocations of slack for the line index and walk stack;
+        // growing children vectors one push_back at a time needs hundreds.
+        ASSERT_TRUE(allocations <= required + 64);
+        ASSERT_TRUE(ms < 500.0);
+    }
+
+    // Test 2: 1000 levels of nesting convert without recursion
+    {
+        auto doc = make_deep_quotes(1000);
+        long before = g_allocations;
+        auto start = std::chrono::high_resolution_clock::now();
+        auto ast = parser->parse(doc);
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(
+            end - start).count();
+
+        int depth = 0;
+        for (auto const* node = &ast; !node->children.empty();
+             node = &node->children.back()) {
+            if (node->type == NodeType::BlockQuote) ++depth;
+        }
+        std::cout << "1000-level nesting: " << ms << " ms, "
+                  << g_allocations - before << " allocations, depth "
+                  << depth << "\n";
+        ASSERT_EQ(depth, 1000);
+        ASSERT_TRUE(ms < 5000.0);
+    }
+
+    // Test 3: One parser reused across small and large documents (its
+    // allocation arena is recycled) matches fresh parsers every time
+    {
+        std::string large;
+        for (int i = 0; i < 2000; ++i) {
+            large += "- item **" + std::to_string(i) + "** with `code`\n";
+        }
+        large += "\n```\n" + std::string(100000, 'x') + "\n```\n";
+        std::vector<std::string> docs{"# Small\n\ntext", large, "", "> q",
+                                      large.substr(0, 5000), large};
+
+        auto reused = make_cmark_parser();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int round = 0; round < 5; ++round) {
+            for (auto const& doc : docs) {
+                auto fresh = make_cmark_parser();
+                ASSERT_TRUE(reused->parse(doc) == fresh->parse(doc));
+                FlatAST flat;
+                reused->parse(doc, flat);
+                FlatAST expected;
+                flatten(fresh->parse(doc), expected);
+                ASSERT_TRUE(flat == expected);
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Reused parser, 30 mixed documents: "
+                  << std::chrono::duration<double, std::milli>(
+                         end - start).count()
+                  << " ms (with fresh-parser checks)\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "test_helper.hpp"
+#include "markdown/parser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace markdown;
+
+namespace {
+
+std::string read_file(std::string const& path) {
+    std::ifstream f(path);
+    std::ostringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+} // namespace
+
+int main() {
+    auto cmark = make_cmark_parser();
+    auto fast = make_fast_parser();
+
+    std::string dir = SNIPPETS_DIR;
+    std::vector<std::string> snippets{read_file(dir + "/email1.md"),
+                                      read_file(dir + "/email2.md")};
+    for (auto const& doc : snippets) {
+        ASSERT_TRUE(!doc.empty());
+        MarkdownAST ast;
+        ASSERT_TRUE(detail::parse_fast(doc, ast));
+    }
+
+    // Time: 400 email parses, best of 3 runs
+    auto time = [&](MarkdownParser& parser) {
+        MarkdownAST ast;
+        double best = 0;
+        for (int run = 0; run < 3; ++run) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < 200; ++i) {
+                for (auto const& doc : snippets) parser.parse(doc, ast);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            double ms =
+                std::chrono::duration<double, std::milli>(end - start).count();
+            best = run == 0 ? ms : std::min(best, ms);
+        }
+        return best;
+    };
+    double fast_ms = time(*fast);
+    double cmark_ms = time(*cmark);
+
+    std::cout << "400 email parses: fast " << fast_ms << " ms, cmark "
+              << cmark_ms << " ms (" << cmark_ms / fast_ms << "x)\n";
+
+    // Budget: 1s for 400 parses (generous for CI), and several times
+    // faster than cmark, as documented
+    ASSERT_TRUE(fast_ms < 1000.0);
+    ASSERT_TRUE(fast_ms * 3 < cmark_ms);
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "test_helper.hpp"
+#include "markdown/dom_builder.hpp"
+#include "markdown/incremental.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/viewer.hpp"
+
+#include <algorithm>
+#include <string>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+std::string render(ftxui::Element el, int height) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                        ftxui::Dimension::Fixed(height));
+    ftxui::Render(screen, el);
+    return screen.ToString();
+}
+
+// A chat-style response: headings, paragraphs, lists, code and links.
+std::string make_response(int sections) {
+    std::string doc;
+    for (int i = 0; i < sections; ++i) {
+        auto n = std::to_string(i);
+        doc += "## Step " + n + "\n";
+        doc += "Some *explanation* for step " + n + " with a "
+               "[reference](https://example.com/" + n + ").\n\n";
+        doc += "- first point\n- second point\n  continued\n\n";
+        doc += "```cpp\nint step = " + n + ";\n\nreturn step;\n```\n\n";
+        doc += "> Note " + n + "\nlazy line\n\n";
+    }
+    return doc;
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: Chunked ParseStream matches a one-shot parse
+    {
+        std::string doc = make_response(3);
+        auto stream = parser->open_stream();
+        for (size_t pos = 0; pos < doc.size(); pos += 7) {
+            stream->feed(std::string_view(doc).substr(pos, 7));
+        }
+        MarkdownAST streamed;
+        ASSERT_TRUE(stream->finish(streamed));
+        ASSERT_TRUE(streamed == parser->parse(doc));
+    }
+
+    // Test 2: Token-by-token append matches a full parse at every step
+    {
+        std::string doc = make_response(4);
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        for (size_t pos = 0; pos <= doc.size(); pos += 3) {
+            std::string_view text(doc.data(), pos);
+            rp.append(*parser, text, ast);
+            ASSERT_TRUE(ast == parser->parse(text));
+        }
+        rp.append(*parser, doc, ast);
+        ASSERT_TRUE(ast == parser->parse(doc));
+    }
+
+    // Test 3: Per-token work tracks the open tail, not the document
+    {
+        std::string doc = make_response(200);
+        ASSERT_TRUE(doc.size() > 30000);
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        rp.append(*parser, "", ast);
+        size_t max_reparsed = 0;
+        for (size_t pos = 0; pos <= doc.size(); pos += 5) {
+            rp.append(*parser, std::string_view(doc.data(), pos), ast);
+            ASSERT_TRUE(!rp.last_was_full());
+            max_reparsed = std::max(max_reparsed, rp.last_reparsed_bytes());
+        }
+        ASSERT_TRUE(max_reparsed < 400);
+        ASSERT_TRUE(rp.unchanged_blocks() + 2 >= ast.children.size());
+    }
+
+    // Test 4: A reference definition arriving late relinks earlier text
+    {
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        std::string text = "See [docs] here.\n\nMore text.\n\n";
+        rp.append(*parser, text, ast);
+        for (auto const& child : ast.children[0].children) {
+            ASSERT_TRUE(child.type != NodeType::Link);
+        }
+        text += "[docs]: https://example.com\n";
+        rp.append(*parser, text, ast);
+        ASSERT_TRUE(rp.last_was_full());
+        ASSERT_EQ(ast.children[0].children[1].type, NodeType::Link);
+    }
+
+    // Test 5: An open fence keeps everything after it in the tail
+    {
+        IncrementalReparser rp;
+        MarkdownAST ast;
+        std::string text = "Intro\n\n```\ncode\n\nnot a paragraph\n\n";
+        rp.append(*parser, text, ast);
+        text += "still code\n";
+        rp.append(*parser, text, ast);
+        ASSERT_TRUE(ast == parser->parse(text));
+        ASSERT_EQ(ast.children.size(), 2u);
+        ASSERT_EQ(ast.children[1].type, NodeType::CodeBlock);
+    }
+
+    // Test 6: Rebuilding keeps closed blocks' elements and link boxes
+    {
+        std::string text = "[one](https://one.com)\n\nSecond\n\n";
+        auto ast = parser->parse(text);
+        DomBuilder builder;
+        render(builder.build(ast), 5);
+        auto const* box = &builder.link_targets()[0].boxes[0];
+
+        text += "Third [two](https://two.com)\n";
+        ast = parser->parse(text);
+        auto reused = render(builder.build(ast), 6);
+        ASSERT_EQ(builder.reused_blocks(), 2u);
+        ASSERT_EQ(builder.link_targets().size(), 2u);
+        ASSERT_TRUE(&builder.link_targets()[0].boxes[0] == box);
+        ASSERT_EQ(builder.link_targets()[1].url, "https://two.com");
+        ASSERT_EQ(builder.flat_link_boxes().size(), 2u);
+
+        DomBuilder fresh;
+        ASSERT_EQ(reused, render(fresh.build(ast), 6));
+    }
+
+    // Test 7: Viewer::append_content renders like set_content
+    {
+        std::string doc = make_response(2);
+        Viewer streamed(make_cmark_parser());
+        Viewer whole(make_cmark_parser());
+        auto streamed_comp = streamed.component();
+        auto whole_comp = whole.component();
+        for (size_t pos = 0; pos < doc.size(); pos += 11) {
+            streamed.append_content(std::string_view(doc).substr(pos, 11));
+            whole.set_content(std::string_view(doc).substr(0, pos + 11));
+            ASSERT_EQ(render(streamed_comp->Render(), 40),
+                      render(whole_comp->Render(), 40));
+        }
+    }
+
+    // Test 8: set_content after streaming starts over from the new text
+    {
+        Viewer viewer(make_cmark_parser());
+        auto comp = viewer.component();
+        viewer.append_content("# Old\n\nstreamed ");
+        render(comp->Render(), 5);
+        viewer.set_content("Replaced");
+        viewer.append_content(" and extended");
+        auto out = render(comp->Render(), 5);
+        ASSERT_CONTAINS(out, "Replaced and extended");
+        ASSERT_TRUE(out.find("Old") == std::string::npos);
+    }
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "test_helper.hpp"
+#include "markdown/editor.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/text_buffer.hpp"
+#include "markdown/viewer.hpp"
+
+#include <memory>
+#include <string>
+
+#include <ftxui/component/event.hpp>
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+// Counts the parses the Viewer asks for.
+class CountingParser : public MarkdownParser {
+public:
+    explicit CountingParser(int& count) : _count(count) {}
+    using MarkdownParser::parse;
+    bool parse(std::string_view input, MarkdownAST& out) override {
+        ++_count;
+        return _inner->parse(input, out);
+    }
+
+private:
+    int& _count;
+    std::unique_ptr<MarkdownParser> _inner = make_cmark_parser();
+};
+
+std::string render(ftxui::Component const& comp, int height) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(40),
+                                        ftxui::Dimension::Fixed(height));
+    ftxui::Render(screen, comp->Render());
+    return screen.ToString();
+}
+
+} // namespace
+
+int main() {
+    // Test 1: Copies share text and version; new text gets a new version
+    {
+        TextBuffer empty;
+        ASSERT_TRUE(empty.empty());
+        ASSERT_EQ(empty.version(), 0u);
+
+        TextBuffer a(std::string("hello"));
+        TextBuffer b = a;
+        ASSERT_EQ(b.version(), a.version());
+        ASSERT_TRUE(b.view().data() == a.view().data());
+        TextBuffer c(std::string("hello"));
+        ASSERT_TRUE(c.version() != a.version());
+        ASSERT_TRUE(a.version() != 0u);
+    }
+
+    // Test 2: append never changes text that another copy covers
+    {
+        TextBuffer a(std::string("abc"));
+        TextBuffer snapshot = a;
+        a.append("def");
+        ASSERT_EQ(a.view(), "abcdef");
+        ASSERT_EQ(snapshot.view(), "abc");
+        ASSERT_TRUE(a.version() != snapshot.version());
+
+        // The newest text grows in place; a stale copy appends elsewhere.
+        TextBuffer b = a;
+        auto version = a.version();
+        a.append("g");
+        ASSERT_EQ(a.view(), "abcdefg");
+        ASSERT_TRUE(a.view().data() == b.view().data());
+        ASSERT_TRUE(a.version() != version);
+        b.append("h");
+        ASSERT_EQ(b.view(), "abcdefh");
+        ASSERT_EQ(a.view(), "abcdefg");
+        ASSERT_TRUE(a.version() != b.version());
+        version = a.version();
+        a.append("");
+        ASSERT_EQ(a.version(), version);
+    }
+
+    // Test 3: Buffers know their edit from the text they came from
+    {
+        TextBuffer a(std::string_view("hello world"));
+        TextBuffer b(std::string_view("hello, world"), a);
+        auto edit = b.edit_from(a);
+        ASSERT_TRUE(edit.has_value());
+        ASSERT_EQ(edit->offset, 5u);
+        ASSERT_EQ(edit->removed, 0u);
+        ASSERT_EQ(edit->inserted, 1u);
+        ASSERT_TRUE(!b.extends(a));
+
+        TextBuffer c = b;
+        c.append("!");
+        edit = c.edit_from(b);
+        ASSERT_TRUE(edit.has_value());
+        ASSERT_EQ(edit->offset, b.size());
+        ASSERT_TRUE(c.extends(b));
+        // Unrelated buffers need a comparison.
+        ASSERT_TRUE(!c.edit_from(a).has_value());
+        ASSERT_TRUE(c.extends(TextBuffer(std::string_view("hello,"))));
+    }
+
+    // Test 4: Editor hands out the same buffer until the text changes
+    {
+        Editor editor;
+        editor.set_content("# Doc");
+        auto first = editor.buffer();
+        ASSERT_EQ(first.view(), "# Doc");
+        ASSERT_EQ(editor.buffer().version(), first.version());
+        ASSERT_TRUE(editor.buffer().view().data() == first.view().data());
+        editor.set_content("# Doc 2");
+        ASSERT_TRUE(editor.buffer().version() != first.version());
+        ASSERT_EQ(editor.buffer().view(), "# Doc 2");
+    }
+
+    // Test 5: Typing in the editor produces a new version
+    {
+        Editor editor;
+        editor.set_content("ab");
+        editor.set_cursor_position(2);
+        auto comp = editor.component();
+        render(comp, 3);
+        auto before = editor.buffer().version();
+        comp->OnEvent(ftxui::Event::Return);  // select
+        comp->OnEvent(ftxui::Event::Character('c'));
+        ASSERT_EQ(editor.content(), "abc");
+        ASSERT_TRUE(editor.buffer().version() != before);
+        ASSERT_EQ(editor.buffer().view(), "abc");
+    }
+
+    // Test 6: Viewer skips unchanged buffers without reparsing
+    {
+        int parses = 0;
+        Viewer viewer(std::make_unique<CountingParser>(parses));
+        auto comp = viewer.component();
+        Editor editor;
+        editor.set_content("# Title\n\nBody");
+        for (int frame = 0; frame < 10; ++frame) {
+            viewer.set_content(editor.buffer());
+            ASSERT_CONTAINS(render(comp, 5), "Body");
+        }
+        ASSERT_EQ(parses, 1);
+
+        editor.set_content("# Title\n\nEdited");
+        viewer.set_content(editor.buffer());
+        ASSERT_CONTAINS(render(comp, 5), "Edited");
+        ASSERT_EQ(parses, 2);
+
+        // Text arriving as a string_view is always taken as new.
+        viewer.set_content(std::string_view("# Title\n\nEdited"));
+        render(comp, 5);
+        ASSERT_EQ(parses, 3);
+    }
+
+    // Test 7: Streaming into a viewer leaves the shared source untouched
+    {
+        TextBuffer source(std::string("Start"));
+        Viewer viewer(make_cmark_parser());
+        auto comp = viewer.component();
+        viewer.set_content(source);
+        viewer.append_content(" and more");
+        ASSERT_CONTAINS(render(comp, 3), "Start and more");
+        ASSERT_EQ(source.view(), "Start");
+    }
+
+    return 0;
+}
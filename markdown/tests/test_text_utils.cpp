@@ -113,5 +113,37 @@ int main() {
     // col 2 is inside '世' — should land at byte 4 (past the wide char)
     ASSERT_EQ(visual_col_to_byte("a\xE4\xB8\x96""b", 2), 4u);
 
+    // --- is_ascii ---
+
+    ASSERT_TRUE(is_ascii(""));
+    ASSERT_TRUE(is_ascii("plain text with no high bytes at all, 40+"));
+    // A high byte at every position of each loop (32-byte, 8-byte, tail).
+    for (size_t len : {1u, 7u, 8u, 31u, 32u, 33u, 70u}) {
+        std::string s(len, 'a');
+        ASSERT_TRUE(is_ascii(s));
+        for (size_t i = 0; i < len; ++i) {
+            std::string t = s;
+            t[i] = '\x80';
+            ASSERT_TRUE(!is_ascii(t));
+        }
+    }
+
+    // --- normalize_emoji_width ---
+
+    // VS16 stripped; ZWJ + emoji collapsed; ZWJ before a letter kept.
+    ASSERT_EQ(normalize_emoji_width("ok \xE2\x9C\x85\xEF\xB8\x8F!"),
+              "ok \xE2\x9C\x85!");
+    ASSERT_EQ(normalize_emoji_width(
+                  "\xF0\x9F\x8F\x83\xE2\x80\x8D\xE2\x99\x82\xEF\xB8\x8F run"),
+              "\xF0\x9F\x8F\x83 run");
+    ASSERT_EQ(normalize_emoji_width("c\xE2\x80\x8D" "d"), "c\xE2\x80\x8D" "d");
+    {
+        std::string s = "ascii only";
+        auto const* data = s.data();
+        normalize_emoji_width_in_place(s);
+        ASSERT_EQ(s, "ascii only");
+        ASSERT_TRUE(s.data() == data);
+    }
+
     return 0;
 }
@@ -1,6 +1,7 @@
 #include "test_helper.hpp"
 #include "markdown/parser.hpp"
 #include "markdown/dom_builder.hpp"
+#include "markdown/flat_ast.hpp"
 
 #include <ftxui/screen/screen.hpp>
 #include <ftxui/dom/elements.hpp>
@@ -79,5 +80,23 @@ int main() {
         ASSERT_CONTAINS(output, "Done");
     }
 
+    // Test 7: Literals arrive emoji-normalized from both parsers
+    {
+        std::string doc = "# Run \xF0\x9F\x8F\x83\xE2\x80\x8D\xE2\x99\x82\xEF\xB8\x8F\n\n"
+                          "Check \xE2\x9C\x85\xEF\xB8\x8F and `\xE2\x9C\x85\xEF\xB8\x8F`\n\n"
+                          "```\n\xE2\x9C\x85\xEF\xB8\x8F\n```\n";
+        auto ast = parser->parse(doc);
+        ASSERT_EQ(ast.children[0].children[0].text, "Run \xF0\x9F\x8F\x83");
+        ASSERT_EQ(ast.children[1].children[0].text, "Check \xE2\x9C\x85 and ");
+        ASSERT_EQ(ast.children[1].children[1].text, "\xE2\x9C\x85");
+        ASSERT_EQ(ast.children[2].text, "\xE2\x9C\x85\n");
+        ASSERT_TRUE(make_fast_parser()->parse(doc) == ast);
+
+        FlatAST flat, expected;
+        parser->parse(doc, flat);
+        flatten(ast, expected);
+        ASSERT_TRUE(flat == expected);
+    }
+
     return 0;
 }
@@ -378,5 +378,44 @@ int main() {
         ASSERT_TRUE(approx(viewer.scroll(), 0.5f));
     }
 
+    // Test 20: scroll_to_source places a block by its rendered position,
+    // not by its share of the source lines
+    {
+        Viewer viewer(make_cmark_parser());
+        std::string content = "```\n";
+        for (int i = 0; i < 40; ++i) content += "code " + std::to_string(i) + "\n";
+        content += "```\n\n";
+        for (int i = 0; i < 30; ++i)
+            content += "Para " + std::to_string(i) + "\n\n";
+        viewer.set_content(content);
+        auto comp = viewer.component();
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(60),
+                                            ftxui::Dimension::Fixed(12));
+        ASSERT_TRUE(!viewer.scroll_to_source(0));  // nothing laid out yet
+        ftxui::Render(screen, comp->Render());
+
+        auto target = content.find("Para 20");
+        ASSERT_TRUE(viewer.scroll_to_source(target));
+        screen.Clear();
+        ftxui::Render(screen, comp->Render());
+        auto const& si = viewer.scroll_info();
+        int expected = si.viewport_height / 3;
+        bool found = false;
+        for (int y = 0; y < screen.dimy(); ++y) {
+            std::string row;
+            for (int x = 0; x < 10; ++x) row += screen.PixelAt(x, y).character;
+            if (row.find("Para 20") != std::string::npos) {
+                ASSERT_EQ(y, expected);
+                found = true;
+            }
+        }
+        ASSERT_TRUE(found);
+        ASSERT_EQ(viewer.source_row(target),
+                  viewer.source_row(content.find("Para 19")) + 2);
+
+        ASSERT_TRUE(viewer.scroll_to_source(0));
+        ASSERT_TRUE(approx(viewer.scroll(), 0.0f));
+    }
+
     return 0;
 }
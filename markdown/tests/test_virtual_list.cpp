@@ -0,0 +1,174 @@
+#include "test_helper.hpp"
+#include "markdown/dom_builder.hpp"
+#include "markdown/parser.hpp"
+#include "markdown/scroll_frame.hpp"
+#include "markdown/viewer.hpp"
+#include "markdown/virtual_list.hpp"
+
+#include <memory>
+#include <string>
+
+#include <ftxui/dom/elements.hpp>
+#include <ftxui/screen/screen.hpp>
+
+using namespace markdown;
+
+namespace {
+
+std::string paragraphs(int count) {
+    std::string doc;
+    for (int i = 0; i < count; ++i) {
+        auto n = std::to_string(i);
+        doc += "Paragraph [" + n + "](https://" + n + ".com)\n\n";
+    }
+    return doc;
+}
+
+ftxui::Screen render(ftxui::Element el, float ratio, ScrollInfo* info,
+                     int height) {
+    auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(40),
+                                        ftxui::Dimension::Fixed(height));
+    ftxui::Render(screen, direct_scroll(std::move(el), ratio, info));
+    return screen;
+}
+
+// Characters only: links put escape codes inside ToString()'s lines.
+std::string text_of(ftxui::Screen& screen) {
+    std::string out;
+    for (int y = 0; y < screen.dimy(); ++y) {
+        for (int x = 0; x < screen.dimx(); ++x) {
+            out += screen.PixelAt(x, y).character;
+        }
+        out += '\n';
+    }
+    return out;
+}
+
+} // namespace
+
+int main() {
+    auto parser = make_cmark_parser();
+
+    // Test 1: HeightIndex sums and finds rows
+    {
+        HeightIndex heights;
+        heights.assign({3, 1, 4, 1, 5});
+        ASSERT_EQ(heights.offset(0), 0);
+        ASSERT_EQ(heights.offset(3), 8);
+        ASSERT_EQ(heights.total(), 14);
+        ASSERT_EQ(heights.find(0), 0u);
+        ASSERT_EQ(heights.find(2), 0u);
+        ASSERT_EQ(heights.find(3), 1u);
+        ASSERT_EQ(heights.find(4), 2u);
+        ASSERT_EQ(heights.find(13), 4u);
+        ASSERT_EQ(heights.find(14), 5u);
+        heights.set(2, 1);
+        ASSERT_EQ(heights.offset(3), 5);
+        ASSERT_EQ(heights.find(5), 3u);
+        ASSERT_EQ(heights.total(), 11);
+    }
+
+    // Test 2: Same output as the full tree, from a few built blocks
+    {
+        auto ast = parser->parse("# Title\n\n- one\n- two\n\n"
+                                 "```\ncode\n```\n\n" +
+                                 paragraphs(300));
+        DomBuilder full;
+        ScrollInfo full_info;
+        auto expected = render(full.build(ast), 0.0f, &full_info, 12);
+
+        DomBuilder builder;
+        builder.set_virtual_blocks(true);
+        ScrollInfo info;
+        builder.set_viewport(&info);
+        auto element = builder.build(ast);
+        ASSERT_EQ(builder.built_blocks(), 0u);
+        ASSERT_EQ(builder.link_targets().size(), 300u);
+        auto screen = render(element, 0.0f, &info, 12);
+        ASSERT_EQ(screen.ToString(), expected.ToString());
+        ASSERT_EQ(builder.block_count(), 303u);
+        ASSERT_TRUE(builder.built_blocks() < 20);
+        ASSERT_EQ(info.content_height, full_info.content_height);
+    }
+
+    // Test 3: The end of a long document is reached without building it
+    {
+        auto ast = parser->parse(paragraphs(10000));
+        DomBuilder builder;
+        builder.set_virtual_blocks(true);
+        ScrollInfo info;
+        builder.set_viewport(&info);
+        auto element = builder.build(ast);
+        builder.set_focus(9999);
+        auto screen = render(element, 1.0f, &info, 10);
+        ASSERT_CONTAINS(text_of(screen), "Paragraph 9999");
+        ASSERT_TRUE(builder.built_blocks() < 20);
+        ASSERT_TRUE(builder.flat_link_boxes().size() < 20);
+        ASSERT_EQ(builder.block_at_row(9), 9999);
+
+        // The focus set before the block was built carries over.
+        auto const& box = builder.link_targets()[9999].boxes[0];
+        ASSERT_EQ(box.y_min, 9);
+        ASSERT_TRUE(screen.PixelAt(box.x_min, box.y_min).inverted);
+    }
+
+    // Test 4: Laid out heights replace the estimates
+    {
+        std::string para;
+        for (int i = 0; i < 100; ++i) para += "word ";
+        auto ast = parser->parse(para + "\n\nAfter\n");
+        DomBuilder builder;
+        builder.set_virtual_blocks(true);
+        ScrollInfo info;
+        builder.set_viewport(&info);
+        auto screen = render(builder.build(ast), 0.0f, &info, 30);
+        auto first = builder.block_box(0);
+        auto second = builder.block_box(1);
+        ASSERT_TRUE(first.y_max - first.y_min + 1 > 7);
+        ASSERT_EQ(second.y_min, first.y_max + 2);
+        std::string row;
+        for (int x = 0; x < 5; ++x) {
+            row += screen.PixelAt(x, second.y_min).character;
+        }
+        ASSERT_EQ(row, "After");
+    }
+
+    // Test 5: Viewer scrolls a virtual document to its end
+    {
+        Viewer viewer(make_cmark_parser());
+        viewer.set_virtual_blocks(true);
+        viewer.set_content(paragraphs(10000));
+        auto comp = viewer.component();
+        auto screen = ftxui::Screen::Create(ftxui::Dimension::Fixed(40),
+                                            ftxui::Dimension::Fixed(10));
+        ftxui::Render(screen, comp->Render());
+        ASSERT_CONTAINS(text_of(screen), "Paragraph 0");
+        viewer.set_scroll(1.0f);
+        ftxui::Render(screen, comp->Render());
+        ASSERT_CONTAINS(text_of(screen), "Paragraph 9999");
+    }
+
+    // Test 6: Blocks far from the viewport are released and rebuilt
+    {
+        auto ast = std::make_shared<MarkdownAST const>(
+            parser->parse(paragraphs(3000)));
+        DomBuilder builder;
+        builder.set_virtual_blocks(true);
+        ScrollInfo info;
+        builder.set_viewport(&info);
+        auto element = builder.build(ast);
+        auto top = render(element, 0.0f, &info, 10).ToString();
+        // Each block and its gap take 2 rows.
+        size_t rows = 10 + 2 * (VirtualList::kOverscan + VirtualList::kRetain);
+        size_t retained = rows / 2 + 2;
+        for (float ratio : {0.25f, 0.5f, 0.75f, 1.0f}) {
+            render(element, ratio, &info, 10);
+            ASSERT_TRUE(builder.built_blocks() < retained);
+            ASSERT_TRUE(builder.flat_link_boxes().size() < retained);
+        }
+        ASSERT_EQ(render(element, 0.0f, &info, 10).ToString(), top);
+        ASSERT_EQ(builder.link_targets()[0].boxes[0].y_min, 0);
+    }
+
+    return 0;
+}